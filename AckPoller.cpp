@@ -0,0 +1,102 @@
+/**
+   AckPoller.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "AckPoller.h"
+
+AckPoller::AckPoller(I2cBus &bus, uint8_t device, unsigned long timeout,
+                     uint16_t binWidth) :
+  m_bus(bus),
+  m_device(device),
+  m_timeout(timeout),
+  m_binWidth(binWidth)
+{
+  resetStats();
+}
+
+bool AckPoller::wait()
+{
+  unsigned long start = m_bus.micros();
+  unsigned long elapsed;
+  do {
+    m_bus.beginTransmission(m_device);
+    uint8_t status = m_bus.endTransmission();
+    elapsed = m_bus.micros() - start;
+    if ( 0 == status ) {
+      uint16_t i = elapsed / m_binWidth;
+      if ( i >= ACK_POLLER_BINS ) i = ACK_POLLER_BINS-1;
+      m_bins[i]++;
+      m_completions++;
+      m_totalTime += elapsed;
+      if ( elapsed > m_maxTime ) m_maxTime = elapsed;
+      return true;
+    }
+  } while ( elapsed < m_timeout );
+  m_timeouts++;
+  return false;
+}
+
+void AckPoller::setTimeout(unsigned long us)
+{
+  m_timeout = us;
+}
+
+unsigned long AckPoller::timeout()
+{
+  return m_timeout;
+}
+
+uint16_t AckPoller::bin(uint8_t i)
+{
+  return ( i < ACK_POLLER_BINS ) ? m_bins[i] : 0;
+}
+
+uint16_t AckPoller::binWidth()
+{
+  return m_binWidth;
+}
+
+uint32_t AckPoller::completions()
+{
+  return m_completions;
+}
+
+uint16_t AckPoller::timeouts()
+{
+  return m_timeouts;
+}
+
+unsigned long AckPoller::maxTime()
+{
+  return m_maxTime;
+}
+
+unsigned long AckPoller::averageTime()
+{
+  return m_completions ? m_totalTime / m_completions : 0;
+}
+
+void AckPoller::resetStats()
+{
+  for (uint8_t i=0; i<ACK_POLLER_BINS; i++) {
+    m_bins[i] = 0;
+  }
+  m_completions = 0;
+  m_timeouts = 0;
+  m_maxTime = 0;
+  m_totalTime = 0;
+}
@@ -0,0 +1,121 @@
+/**
+   AckPoller.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef AckPoller_h
+#define AckPoller_h
+
+#include "I2cBus.h"
+
+/** Default maximum time to wait for the end of a write cycle, in microseconds. */
+#define ACK_POLLER_TIMEOUT_US 10000
+
+/** Default width of one bin of the completion time histogram, in microseconds. */
+#define ACK_POLLER_BIN_US 500
+
+/** Number of bins of the completion time histogram. */
+#ifndef ACK_POLLER_BINS
+#define ACK_POLLER_BINS 12
+#endif
+
+/**
+   Detect the end of the write cycle of an I2C EEPROM by acknowledge
+   polling.
+
+   During its internal write cycle, a 24LCxx device does not acknowledge
+   its address. Rather than waiting for the worst case write time (5ms
+   for the 24LC256, usually covered with a delay(6)), the device is polled
+   until it answers, which is often much sooner.
+
+   The time taken by each write cycle is recorded in a histogram, so the
+   real behavior of a part (and the timeout to use) can be measured.
+ */
+class AckPoller
+{
+public:
+  /** Create a poller for a device.
+      @param bus        I2C bus where the device is connected
+      @param device     7 bits address of the device
+      @param timeout    maximum time to wait for the device, in microseconds
+      @param binWidth   width of one bin of the histogram, in microseconds
+  */
+  AckPoller(I2cBus &bus, uint8_t device,
+            unsigned long timeout=ACK_POLLER_TIMEOUT_US,
+            uint16_t binWidth=ACK_POLLER_BIN_US);
+
+  /** Wait for the end of the write cycle started by the last transmission.
+      @return           false if the device did not answer before the timeout
+  */
+  bool wait();
+
+  /** Set the maximum time to wait for the device.
+      @param us         timeout in microseconds
+  */
+  void setTimeout(unsigned long us);
+
+  /** Return the maximum time to wait for the device, in microseconds.
+   */
+  unsigned long timeout();
+
+  /** Return the number of write cycles which completed in the bin.
+
+      Bin i counts the cycles which took between i*binWidth and
+      (i+1)*binWidth microseconds; the last bin also counts the longer
+      ones.
+      @param i          index of the bin
+  */
+  uint16_t bin(uint8_t i);
+
+  /** Return the width of one bin of the histogram, in microseconds.
+   */
+  uint16_t binWidth();
+
+  /** Return the number of write cycles completed.
+   */
+  uint32_t completions();
+
+  /** Return the number of write cycles which did not complete in time.
+   */
+  uint16_t timeouts();
+
+  /** Return the longest completed write cycle, in microseconds.
+   */
+  unsigned long maxTime();
+
+  /** Return the average completed write cycle, in microseconds.
+   */
+  unsigned long averageTime();
+
+  /** Clear the histogram and the statistics.
+   */
+  void resetStats();
+
+protected:
+  I2cBus &m_bus;                /** Bus where the device is connected */
+  uint8_t m_device;             /** Address of the device on the bus */
+  unsigned long m_timeout;
+  uint16_t m_binWidth;
+
+  uint16_t m_bins[ACK_POLLER_BINS];
+  uint32_t m_completions;
+  uint16_t m_timeouts;
+  unsigned long m_maxTime;
+  unsigned long m_totalTime;
+
+};
+
+#endif
@@ -17,6 +17,8 @@
    along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
 */
 #include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #define SERIAL_DEBUG 1
 
@@ -28,59 +30,115 @@
 
 #include "AvrEeprom.h"
 
-void AvrEeprom::write_byte(uint16_t addr, uint8_t data)
-{
-  if ( addr < LAST )
-    eeprom_write_byte((uint8_t *)addr, data);
-}
-
-uint8_t AvrEeprom::read_byte(uint16_t addr)
+#ifdef EEPM0
+/** Program one byte, using the erase only or write only mode when possible.
+    @param addr       address of the byte
+    @param current    value currently stored at addr
+    @param data       value to program
+*/
+static void splitProgram(uint16_t addr, uint8_t current, uint8_t data)
 {
-  return eeprom_read_byte((uint8_t *)addr);
+  uint8_t mode = 0;                             // atomic erase and write
+  if ( 0xFF == data ) mode = _BV(EEPM0);        // erase only
+  else if ( 0xFF == current ) mode = _BV(EEPM1); // write only
+
+  eeprom_busy_wait();
+  EEAR = addr;
+  EEDR = data;
+  EECR = (EECR & _BV(EERIE)) | mode;
+  // EEPE must be set within 4 cycles after EEMPE
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    EECR |= _BV(EEMPE);
+    EECR |= _BV(EEPE);
+  }
 }
-
-void AvrEeprom::write_word(uint16_t addr, uint16_t data)
+#else
+static void splitProgram(uint16_t addr, uint8_t /* current */, uint8_t data)
 {
-  if ( addr < LAST-1 )
-    eeprom_write_word((uint16_t *)addr, data);
+  eeprom_write_byte((uint8_t *)addr, data);
 }
+#endif
 
-uint16_t AvrEeprom::read_word(uint16_t addr)
+#if AVR_EEPROM_ASYNC
+ISR(EE_READY_vect)
 {
-  return eeprom_read_word((uint16_t *)addr);
+  AvrEeprom::instance().onReady();
 }
 
-void AvrEeprom::write_long(uint16_t addr, uint32_t data)
+void AvrEepromPort::program(uint16_t addr, uint8_t current, uint8_t data)
 {
-  if ( addr < LAST-3 ) 
-    eeprom_write_dword((uint32_t *)addr, data);
+  splitProgram(addr, current, data);
 }
+#endif
 
-uint32_t AvrEeprom::read_long(uint16_t addr)
+void AvrEeprom::update_block(uint16_t addr, void* data, size_t len)
 {
-  return eeprom_read_dword((uint32_t *)addr);
+  if ( addr < LAST+1-len ) {
+#if AVR_EEPROM_ASYNC
+    if ( m_async ) {
+      m_writer.queue(addr, (uint8_t *)data, len, true);
+      return;
+    }
+#endif
+    // same as eeprom_update_block, but keeping track of the skipped writes
+    uint8_t *src = (uint8_t *)data;
+    for (size_t i=0; i<len; i++) {
+      if ( eeprom_read_byte((uint8_t *)(addr+i)) != src[i] ) {
+        eeprom_write_byte((uint8_t *)(addr+i), src[i]);
+      }
+      else {
+        m_avoidedPrograms++;
+      }
+    }
+  }
 }
 
-void AvrEeprom::write_block(uint16_t addr, void* data, size_t len)
+void AvrEeprom::fill(uint16_t addr, uint8_t value, size_t len)
 {
-  if ( addr < LAST+1-len )
-    eeprom_write_block(data, (void *)addr, len);
+  if ( addr < LAST+1-len ) {
+#if AVR_EEPROM_ASYNC
+    if ( m_async ) {
+      // the interrupt chooses the programming mode of each byte
+      for (size_t i=0; i<len; i++) {
+        m_writer.queue(addr+i, &value, sizeof(value), true);
+      }
+      return;
+    }
+#endif
+    for (size_t i=0; i<len; i++) {
+      uint8_t current = eeprom_read_byte((uint8_t *)(addr+i));
+      if ( current != value ) {
+        splitProgram(addr+i, current, value);
+      }
+      else {
+        m_avoidedPrograms++;
+      }
+    }
+  }
 }
 
-void AvrEeprom::read_block(uint16_t addr, void* data, size_t len)
+uint32_t AvrEeprom::avoidedPrograms()
 {
-  eeprom_read_block(data, (void *)addr, len);
+#if AVR_EEPROM_ASYNC
+  // the queued writes skipped by the interrupt too
+  return m_avoidedPrograms + m_writer.skipped();
+#else
+  return m_avoidedPrograms;
+#endif
 }
 
-uint16_t AvrEeprom::memSize()
+#if AVR_EEPROM_ASYNC
+void AvrEeprom::setAsync(bool async)
 {
-  return E2END;
+  if ( ! async ) flush();
+  m_async = async;
 }
 
-uint16_t AvrEeprom::pageSize()
+void AvrEeprom::flush()
 {
-  return E2PAGESIZE;
+  m_writer.flush();
 }
+#endif
 
 void AvrEeprom::show(uint16_t start, int len)
 {
@@ -19,13 +19,80 @@
 #ifndef AvrEeprom_h
 #define AvrEeprom_h
 
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
 #include "SafeEeprom.h"
+#include "StaticEeprom.h"
+#include "EepromWriteQueue.h"
+
+/** Set to 1 to build the non blocking writes (setAsync), which take the
+    EE_READY interrupt vector. */
+#ifndef AVR_EEPROM_ASYNC
+#define AVR_EEPROM_ASYNC 0
+#endif
+
+#if AVR_EEPROM_ASYNC
+/**
+   Registers of the AVR EEPROM, as used by the queued writes (see
+   EepromAsyncWriter for the methods).
+ */
+class AvrEepromPort
+{
+public:
+  uint8_t read(uint16_t addr) {
+    return eeprom_read_byte((uint8_t *)addr);
+  }
+
+  void readBlock(uint16_t addr, uint8_t *dst, size_t len) {
+    eeprom_read_block(dst, (void *)addr, len);
+  }
+
+  void program(uint16_t addr, uint8_t current, uint8_t data);
+
+  void waitReady() {
+    eeprom_busy_wait();
+  }
+
+  bool readyEnabled() {
+    return EECR & _BV(EERIE);
+  }
+
+  void enableReady() {
+    EECR |= _BV(EERIE);
+  }
+
+  void disableReady() {
+    EECR &= ~_BV(EERIE);
+  }
+
+  void waitQueue() {
+    // the interrupt frees the entries
+  }
+};
+#endif
 
 /**
    Class to access the permanent storage (EEPROM) of the AVR chip.
    
    This class aggregates static methods for a direct access to the
-   EEPROM. It simply wraps the avr/eeprom.h functionality.
+   EEPROM. It simply wraps the avr/eeprom.h functionality: the accessors
+   are defined in this header, so the templates calling them through
+   StaticEeprom (EnduranceEepromT<AvrEeprom>, EepromRing<T, N, E,
+   AvrEeprom>) inline them.
+
+   The only exception is fill(): on the chips supporting it (EEPM bits),
+   the bytes are programmed with the erase only mode when set to 0xFF, or
+   the write only mode when they were erased, which takes 1.8ms instead
+   of 3.4ms for the atomic erase and write.
+
+   Built with AVR_EEPROM_ASYNC, setAsync(true) makes the writes not wait
+   for the EEPROM anymore: the bytes are queued and programmed in the
+   background by the EEPROM ready interrupt (EE_READY, see
+   EepromAsyncWriter). The reads return the queued values, so the
+   program always sees the content of the writes it issued. The global
+   interrupts must be enabled, otherwise a write blocks forever when the
+   queue is full.
 
    Documentation of each method is provided by the interface SafeEeprom.
  */
@@ -37,32 +104,165 @@ public:
     return ee;
   }
   
-  void write_byte(uint16_t addr, uint8_t data);
-  
-  uint8_t read_byte(uint16_t addr);
-  
-  void write_word(uint16_t addr, uint16_t data);
-  
-  uint16_t read_word(uint16_t addr);
+  void write_byte(uint16_t addr, uint8_t data) {
+    if ( addr <= E2END ) {
+#if AVR_EEPROM_ASYNC
+      if ( m_async ) {
+        m_writer.queue(addr, &data, sizeof(data), false);
+        return;
+      }
+#endif
+      eeprom_write_byte((uint8_t *)addr, data);
+    }
+  }
 
-  void write_long(uint16_t addr, uint32_t data);
-  
-  uint32_t read_long(uint16_t addr);
+  uint8_t read_byte(uint16_t addr) {
+#if AVR_EEPROM_ASYNC
+    if ( m_async ) return m_writer.fetch(addr);
+#endif
+    return eeprom_read_byte((uint8_t *)addr);
+  }
+
+  void write_word(uint16_t addr, uint16_t data) {
+    if ( addr < E2END ) {
+#if AVR_EEPROM_ASYNC
+      if ( m_async ) {
+        m_writer.queue(addr, (uint8_t *)&data, sizeof(data), false);
+        return;
+      }
+#endif
+      eeprom_write_word((uint16_t *)addr, data);
+    }
+  }
+
+  uint16_t read_word(uint16_t addr) {
+#if AVR_EEPROM_ASYNC
+    if ( m_async ) {
+      uint16_t data;
+      m_writer.fetchBlock(addr, (uint8_t *)&data, sizeof(data));
+      return data;
+    }
+#endif
+    return eeprom_read_word((uint16_t *)addr);
+  }
+
+  void write_long(uint16_t addr, uint32_t data) {
+    if ( addr < E2END-2 ) {
+#if AVR_EEPROM_ASYNC
+      if ( m_async ) {
+        m_writer.queue(addr, (uint8_t *)&data, sizeof(data), false);
+        return;
+      }
+#endif
+      eeprom_write_dword((uint32_t *)addr, data);
+    }
+  }
+
+  uint32_t read_long(uint16_t addr) {
+#if AVR_EEPROM_ASYNC
+    if ( m_async ) {
+      uint32_t data;
+      m_writer.fetchBlock(addr, (uint8_t *)&data, sizeof(data));
+      return data;
+    }
+#endif
+    return eeprom_read_dword((uint32_t *)addr);
+  }
+
+  void write_block(uint16_t addr, void* data, size_t len) {
+    if ( addr < E2END+2-len ) {
+#if AVR_EEPROM_ASYNC
+      if ( m_async ) {
+        m_writer.queue(addr, (uint8_t *)data, len, false);
+        return;
+      }
+#endif
+      eeprom_write_block(data, (void *)addr, len);
+    }
+  }
+
+  void read_block(uint16_t addr, void* data, size_t len) {
+#if AVR_EEPROM_ASYNC
+    if ( m_async ) {
+      m_writer.fetchBlock(addr, (uint8_t *)data, len);
+      return;
+    }
+#endif
+    eeprom_read_block(data, (void *)addr, len);
+  }
+
+  void update_byte(uint16_t addr, uint8_t data) {
+    update_block(addr, (void *)&data, sizeof(data));
+  }
+
+  void update_word(uint16_t addr, uint16_t data) {
+    update_block(addr, (void *)&data, sizeof(data));
+  }
+
+  void update_long(uint16_t addr, uint32_t data) {
+    update_block(addr, (void *)&data, sizeof(data));
+  }
 
-  void write_block(uint16_t addr, void* data, size_t len);
+  void update_block(uint16_t addr, void* data, size_t len);
 
-  void read_block(uint16_t addr, void* data, size_t len);
+  void fill(uint16_t addr, uint8_t value, size_t len);
 
-  uint16_t memSize();
+  uint16_t memSize() {
+    return E2END+1;
+  }
 
-  uint16_t pageSize();
+  uint16_t pageSize() {
+    return E2PAGESIZE;
+  }
 
   void show(uint16_t start=0, int len=-1);
 
+  /** Return the number of byte writes (each one a page program) skipped
+      by the update methods because the EEPROM already held the value.
+   */
+  uint32_t avoidedPrograms();
+
+#if AVR_EEPROM_ASYNC
+  /** Select the blocking (default) or non blocking (queued) writes.
+      Switching back to the blocking writes waits for the queue to drain.
+      @param async      true to queue the writes
+   */
+  void setAsync(bool async);
+
+  /** Return the number of byte writes waiting in the queue.
+   */
+  uint8_t pending() {
+    return m_writer.pending();
+  }
+
+  /** Wait until all the queued writes are programmed.
+   */
+  void flush();
+
+  /** Program the next queued byte. Called by the EE_READY interrupt only.
+   */
+  void onReady() {
+    m_writer.onReady();
+  }
+#endif
+
 private:
-  AvrEeprom() {
+#if AVR_EEPROM_ASYNC
+  AvrEeprom() : m_avoidedPrograms(0), m_async(false), m_writer(m_port) {
+    // cannot call externally
+  }
+#else
+  AvrEeprom() : m_avoidedPrograms(0) {
     // cannot call externally
   }
+#endif
+
+  uint32_t m_avoidedPrograms;
+#if AVR_EEPROM_ASYNC
+  bool m_async;                 /** Writes are queued */
+  AvrEepromPort m_port;
+  EepromAsyncWriter<AvrEepromPort> m_writer; /** Bytes waiting for EE_READY */
+#endif
   
   // prohibited...
   AvrEeprom(AvrEeprom const&);
@@ -70,4 +270,10 @@ private:
 
 };
 
+template <>
+struct EepromCapacity<AvrEeprom>
+{
+  static constexpr uint32_t value = E2END+1;
+};
+
 #endif
@@ -0,0 +1,271 @@
+/**
+   CachedEeprom.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "CachedEeprom.h"
+
+#include <string.h>
+
+CachedEeprom::CachedEeprom(SafeEeprom &ee) :
+  m_eeprom(ee),
+  m_clock(0),
+  m_writeBacks(0),
+  m_mergedWrites(0)
+{
+  uint16_t page = m_eeprom.pageSize();
+  m_lineSize = ( page <= CACHED_EEPROM_LINE_SIZE ) ? page : CACHED_EEPROM_LINE_SIZE;
+  for (uint8_t i=0; i<CACHED_EEPROM_LINES; i++) {
+    m_lines[i].valid = false;
+  }
+}
+
+CachedEeprom::~CachedEeprom()
+{
+  flush();
+}
+
+void CachedEeprom::write_byte(uint16_t addr, uint8_t data)
+{
+  store(addr, &data, 1);
+}
+
+uint8_t CachedEeprom::read_byte(uint16_t addr)
+{
+  uint8_t data;
+  load(addr, &data, 1);
+  return data;
+}
+
+void CachedEeprom::write_word(uint16_t addr, uint16_t data)
+{
+  store(addr, (uint8_t *)&data, sizeof(data));
+}
+
+uint16_t CachedEeprom::read_word(uint16_t addr)
+{
+  uint16_t data;
+  load(addr, (uint8_t *)&data, sizeof(data));
+  return data;
+}
+
+void CachedEeprom::write_long(uint16_t addr, uint32_t data)
+{
+  store(addr, (uint8_t *)&data, sizeof(data));
+}
+
+uint32_t CachedEeprom::read_long(uint16_t addr)
+{
+  uint32_t data;
+  load(addr, (uint8_t *)&data, sizeof(data));
+  return data;
+}
+
+void CachedEeprom::write_block(uint16_t addr, void* data, size_t len)
+{
+  store(addr, (uint8_t *)data, len);
+}
+
+void CachedEeprom::read_block(uint16_t addr, void* data, size_t len)
+{
+  load(addr, (uint8_t *)data, len);
+}
+
+void CachedEeprom::update_byte(uint16_t addr, uint8_t data)
+{
+  refresh(addr, &data, 1);
+}
+
+void CachedEeprom::update_word(uint16_t addr, uint16_t data)
+{
+  refresh(addr, (uint8_t *)&data, sizeof(data));
+}
+
+void CachedEeprom::update_long(uint16_t addr, uint32_t data)
+{
+  refresh(addr, (uint8_t *)&data, sizeof(data));
+}
+
+void CachedEeprom::update_block(uint16_t addr, void* data, size_t len)
+{
+  refresh(addr, (uint8_t *)data, len);
+}
+
+void CachedEeprom::fill(uint16_t addr, uint8_t value, size_t len)
+{
+  if ( (uint32_t)addr + len > m_eeprom.memSize() ) return;
+
+  uint8_t data[CACHED_EEPROM_LINE_SIZE];
+  memset(data, value, sizeof(data));
+  while ( len > 0 ) {
+    uint8_t chunk = m_lineSize - addr % m_lineSize;
+    if ( chunk > len ) chunk = len;
+    refresh(addr, data, chunk);
+    addr += chunk;
+    len -= chunk;
+  }
+}
+
+uint16_t CachedEeprom::memSize()
+{
+  return m_eeprom.memSize();
+}
+
+uint16_t CachedEeprom::pageSize()
+{
+  return m_eeprom.pageSize();
+}
+
+void CachedEeprom::show(uint16_t start, int len)
+{
+  flush();
+  m_eeprom.show(start, len);
+}
+
+void CachedEeprom::flush()
+{
+  for (uint8_t i=0; i<CACHED_EEPROM_LINES; i++) {
+    if ( m_lines[i].valid ) writeBack(m_lines[i]);
+  }
+}
+
+uint32_t CachedEeprom::writeBacks()
+{
+  return m_writeBacks;
+}
+
+uint32_t CachedEeprom::mergedWrites()
+{
+  return m_mergedWrites;
+}
+
+void CachedEeprom::store(uint16_t addr, const uint8_t *data, size_t len)
+{
+  // same policy than the devices: out of bound writes are dropped
+  if ( (uint32_t)addr + len > m_eeprom.memSize() ) return;
+
+  while ( len > 0 ) {
+    Line *line = lookup(addr);
+    if ( ! line ) {
+      line = allocate(addr);
+    }
+    else if ( line->dirtyStart < line->dirtyEnd ) {
+      m_mergedWrites++;
+    }
+    uint8_t offset = addr - line->addr;
+    uint8_t chunk = m_lineSize - offset;
+    if ( chunk > len ) chunk = len;
+    memcpy(line->data+offset, data, chunk);
+    if ( line->dirtyStart >= line->dirtyEnd ) {
+      line->dirtyStart = offset;
+      line->dirtyEnd = offset+chunk;
+    }
+    else {
+      if ( offset < line->dirtyStart ) line->dirtyStart = offset;
+      if ( offset+chunk > line->dirtyEnd ) line->dirtyEnd = offset+chunk;
+    }
+    addr += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+}
+
+void CachedEeprom::refresh(uint16_t addr, const uint8_t *data, size_t len)
+{
+  if ( (uint32_t)addr + len > m_eeprom.memSize() ) return;
+
+  while ( len > 0 ) {
+    uint8_t offset = addr % m_lineSize;
+    uint8_t chunk = m_lineSize - offset;
+    if ( chunk > len ) chunk = len;
+    uint8_t current[CACHED_EEPROM_LINE_SIZE];
+    load(addr, current, chunk);
+    // a line already holding the data does not need to be dirtied
+    if ( memcmp(current, data, chunk) != 0 ) {
+      store(addr, data, chunk);
+    }
+    addr += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+}
+
+void CachedEeprom::load(uint16_t addr, uint8_t *data, size_t len)
+{
+  while ( len > 0 ) {
+    uint8_t offset = addr % m_lineSize;
+    uint8_t chunk = m_lineSize - offset;
+    if ( chunk > len ) chunk = len;
+    Line *line = lookup(addr);
+    if ( line ) {
+      memcpy(data, line->data+offset, chunk);
+    }
+    else {
+      m_eeprom.read_block(addr, data, chunk);
+    }
+    addr += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+}
+
+CachedEeprom::Line *CachedEeprom::lookup(uint16_t addr)
+{
+  uint16_t lineAddr = addr - addr % m_lineSize;
+  for (uint8_t i=0; i<CACHED_EEPROM_LINES; i++) {
+    if ( m_lines[i].valid && m_lines[i].addr == lineAddr ) {
+      m_lines[i].lastUse = ++m_clock;
+      return &m_lines[i];
+    }
+  }
+  return NULL;
+}
+
+CachedEeprom::Line *CachedEeprom::allocate(uint16_t addr)
+{
+  Line *victim = &m_lines[0];
+  for (uint8_t i=0; i<CACHED_EEPROM_LINES; i++) {
+    if ( ! m_lines[i].valid ) {
+      victim = &m_lines[i];
+      break;
+    }
+    // unsigned difference keeps the LRU right when the clock wraps
+    if ( (uint16_t)(m_clock - m_lines[i].lastUse) > (uint16_t)(m_clock - victim->lastUse) ) {
+      victim = &m_lines[i];
+    }
+  }
+  if ( victim->valid ) writeBack(*victim);
+
+  // the whole line is read so untouched bytes can be served from RAM
+  victim->addr = addr - addr % m_lineSize;
+  m_eeprom.read_block(victim->addr, victim->data, m_lineSize);
+  victim->dirtyStart = 0;
+  victim->dirtyEnd = 0;
+  victim->valid = true;
+  victim->lastUse = ++m_clock;
+  return victim;
+}
+
+void CachedEeprom::writeBack(Line &line)
+{
+  if ( line.dirtyStart < line.dirtyEnd ) {
+    m_eeprom.update_block(line.addr+line.dirtyStart, line.data+line.dirtyStart,
+                          line.dirtyEnd-line.dirtyStart);
+    m_writeBacks++;
+    line.dirtyStart = 0;
+    line.dirtyEnd = 0;
+  }
+}
@@ -0,0 +1,155 @@
+/**
+   CachedEeprom.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CachedEeprom_h
+#define CachedEeprom_h
+
+#include "SafeEeprom.h"
+
+/** Number of pages kept in RAM by CachedEeprom. */
+#ifndef CACHED_EEPROM_LINES
+#define CACHED_EEPROM_LINES 4
+#endif
+
+/** Largest page size cached as a whole. Devices with bigger pages are
+    cached by chunks of this size. */
+#ifndef CACHED_EEPROM_LINE_SIZE
+#define CACHED_EEPROM_LINE_SIZE 16
+#endif
+
+/**
+   Write-back RAM cache of EEPROM pages in front of another SafeEeprom.
+
+   Every byte written through SafeEeprom costs a page program, so code
+   writing a page byte per byte (like the clear of a ring buffer) burns
+   the same page several times. CachedEeprom keeps a few dirty pages in
+   RAM: all the writes to a cached page are merged, and the page is
+   programmed only once, when it is evicted (least recently used first)
+   or when flush() is called. Only the span of modified bytes is written
+   back, as a single block update (bytes already holding the value are
+   not programmed again).
+
+   @warning The cached data is lost on a power failure, and the pages
+   reach the EEPROM in eviction order, not in the order of the writes.
+   Structures relying on the order of their writes to survive a power
+   loss (like EnduranceEeprom) must flush() after each logical update.
+
+   Documentation of the SafeEeprom methods is provided by the interface.
+ */
+class CachedEeprom : public SafeEeprom
+{
+public:
+  /** Create a cache in front of an EEPROM.
+      @param ee         EEPROM actually storing the data
+   */
+  CachedEeprom(SafeEeprom &ee);
+
+  /** Flush the dirty pages before going away. */
+  ~CachedEeprom();
+
+  void write_byte(uint16_t addr, uint8_t data);
+
+  uint8_t read_byte(uint16_t addr);
+
+  void write_word(uint16_t addr, uint16_t data);
+
+  uint16_t read_word(uint16_t addr);
+
+  void write_long(uint16_t addr, uint32_t data);
+
+  uint32_t read_long(uint16_t addr);
+
+  void write_block(uint16_t addr, void* data, size_t len);
+
+  void read_block(uint16_t addr, void* data, size_t len);
+
+  void update_byte(uint16_t addr, uint8_t data);
+
+  void update_word(uint16_t addr, uint16_t data);
+
+  void update_long(uint16_t addr, uint32_t data);
+
+  void update_block(uint16_t addr, void* data, size_t len);
+
+  void fill(uint16_t addr, uint8_t value, size_t len);
+
+  uint16_t memSize();
+
+  uint16_t pageSize();
+
+  /** Flush the cache and show the content of the underlying EEPROM. */
+  void show(uint16_t start=0, int len=-1);
+
+  /** Write all the dirty pages to the EEPROM.
+   */
+  void flush();
+
+  /** Return the number of block updates issued to the EEPROM.
+   */
+  uint32_t writeBacks();
+
+  /** Return the number of writes absorbed by an already dirty page.
+   */
+  uint32_t mergedWrites();
+
+protected:
+  /** A page kept in RAM. */
+  struct Line {
+    uint16_t addr;              /** Address of the first byte of the line */
+    uint16_t lastUse;           /** Time of last access (for LRU) */
+    uint8_t dirtyStart;         /** First modified byte */
+    uint8_t dirtyEnd;           /** Just after the last modified byte */
+    bool valid;
+    uint8_t data[CACHED_EEPROM_LINE_SIZE];
+  };
+
+  /** Store len bytes in the cache. */
+  void store(uint16_t addr, const uint8_t *data, size_t len);
+
+  /** Store len bytes in the cache, skipping the lines already holding
+      the data. */
+  void refresh(uint16_t addr, const uint8_t *data, size_t len);
+
+  /** Read len bytes, from the cache when present. */
+  void load(uint16_t addr, uint8_t *data, size_t len);
+
+  /** Return the line caching addr, or NULL. */
+  Line *lookup(uint16_t addr);
+
+  /** Return a line for addr, evicting the least recently used one. */
+  Line *allocate(uint16_t addr);
+
+  /** Write back the modified bytes of a line. */
+  void writeBack(Line &line);
+
+  SafeEeprom &m_eeprom;         /** Device storing the data */
+  uint8_t m_lineSize;           /** Size of the cached lines */
+  uint16_t m_clock;             /** Access counter for the LRU */
+  Line m_lines[CACHED_EEPROM_LINES];
+
+  uint32_t m_writeBacks;
+  uint32_t m_mergedWrites;
+
+private:
+  // prohibited...
+  CachedEeprom(CachedEeprom const&);
+  void operator=(CachedEeprom const&);
+
+};
+
+#endif
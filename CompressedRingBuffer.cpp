@@ -0,0 +1,345 @@
+/**
+   CompressedRingBuffer.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "CompressedRingBuffer.h"
+
+#ifdef SERIAL_DEBUG
+#include "HardwareSerial.h"
+#endif
+
+#include <stdlib.h>     // for exit
+#include <string.h>
+
+CompressedRingBuffer::CompressedRingBuffer(SafeEeprom &ee, uint16_t startAddr,
+                                           uint16_t length, size_t dataSize,
+                                           int timePeriod, uint8_t frameSize) :
+  m_eeprom(ee),
+  m_start(startAddr),
+  m_frames(length / frameSize),
+  m_frameSize(frameSize),
+  m_dataSize(dataSize),
+  m_period(timePeriod),
+  m_frame(0),
+  m_seq(0),
+  m_count(0),
+  m_used(0),
+  m_time(0)
+{
+  // Check the sample fits in a frame, and there is enough EEPROM
+  if ( dataSize == 0 || dataSize > COMPRESSED_MAX_SAMPLE
+       || frameSize < sizeof(FrameHeader) + dataSize || m_frames < 2
+       || (uint32_t)startAddr + storageSize() > m_eeprom.memSize() ) {
+    exit(-1);
+  }
+  recover();
+}
+
+void CompressedRingBuffer::recover()
+{
+  // the newest frame is the only one holding samples which is not
+  // followed by the next sequence number: a frame being started (no
+  // samples yet) is ignored
+  FrameHeader header;
+  readHeader(0, header);
+  uint16_t seq = header.seq;
+  uint8_t count = frameCount(header);
+  uint16_t newest = m_frames;
+  for (uint16_t frame=0; frame<m_frames; frame++) {
+    uint16_t next = frame+1 < m_frames ? frame+1 : 0;
+    readHeader(next, header);
+    uint8_t nextCount = frameCount(header);
+    if ( seq != 0xFFFF && count > 0
+         && ( nextCount == 0 || header.seq != nextSeq(seq) ) ) {
+      newest = frame;
+      break;
+    }
+    seq = header.seq;
+    count = nextCount;
+  }
+  if ( newest == m_frames ) {
+    // empty buffer
+    m_frame = 0;
+    m_seq = 0;
+    m_count = 0;
+    return;
+  }
+
+  readHeader(newest, header);
+  m_frame = newest;
+  m_seq = header.seq;
+  m_count = frameCount(header);
+  m_used = decodeFrame(m_frame, m_count-1, m_last) - frameAddr(m_frame);
+  m_time = header.time + (long)(m_count-1)*m_period;
+
+#ifdef SERIAL_DEBUG
+  Serial.print("CompressedRingBuffer: newest frame=");
+  Serial.print(m_frame, DEC);
+  Serial.print(" samples=");
+  Serial.println(m_count, DEC);
+#endif
+}
+
+void CompressedRingBuffer::readHeader(uint16_t frame, FrameHeader &header)
+{
+  m_eeprom.read_block(frameAddr(frame), (void *)&header, sizeof(header));
+}
+
+uint8_t CompressedRingBuffer::frameCount(const FrameHeader &header)
+{
+  // the larger valid slot: the other one may be an interrupted write
+  uint8_t count = 0;
+  for (uint8_t i=0; i<4; i+=2) {
+    if ( header.count[i] == (uint8_t)~header.count[i+1] && header.count[i] > count ) {
+      count = header.count[i];
+    }
+  }
+  return count;
+}
+
+void CompressedRingBuffer::writeCount(uint8_t count)
+{
+  uint8_t slot[2] = { count, (uint8_t)~count };
+  m_eeprom.write_block(frameAddr(m_frame)+2*(count & 1), (void *)slot, sizeof(slot));
+}
+
+bool CompressedRingBuffer::insert(DataSample &data, long time)
+{
+  const uint8_t *sample = (const uint8_t *)data.data();
+  if ( m_count > 0 ) {
+    long delta = time - m_time;
+    if ( delta < 0 ) {
+      // going back in the past: start over
+      clear();
+    }
+    else if ( delta == 0 || delta % m_period != 0 ) {
+      // period not elapsed
+      return false;
+    }
+    else if ( delta == m_period && m_count < 0xFF ) {
+      // next sample: append its delta to the newest frame if it fits
+      uint8_t out[2*COMPRESSED_MAX_SAMPLE];
+      uint8_t len = encode(m_last, sample, out);
+      if ( m_used + len <= m_frameSize ) {
+        m_eeprom.write_block(frameAddr(m_frame)+m_used, (void *)out, len);
+        // the sample exists once the count is written
+        m_count++;
+        writeCount(m_count);
+        m_used += len;
+        memcpy(m_last, sample, m_dataSize);
+        m_time = time;
+        return true;
+      }
+    }
+  }
+  // first sample, full frame, or missed samples
+  startFrame(sample, time);
+  return true;
+}
+
+void CompressedRingBuffer::startFrame(const uint8_t *sample, long time)
+{
+  if ( m_count > 0 ) {
+    m_frame = ( m_frame+1 == m_frames ) ? 0 : m_frame+1;
+    m_seq = nextSeq(m_seq);
+  }
+  // the counts are written first: the frame is empty (and its previous
+  // samples lost) until the count of the first sample is written
+  FrameHeader header;
+  header.count[0] = 0;
+  header.count[1] = 0xFF;
+  header.count[2] = 0xFF;
+  header.count[3] = 0xFF;
+  header.time = time;
+  header.seq = m_seq;
+  header.reserved = 0xFFFF;
+  uint16_t addr = frameAddr(m_frame);
+  m_eeprom.write_block(addr, (void *)&header, sizeof(header));
+  m_eeprom.write_block(addr+sizeof(header), (void *)sample, m_dataSize);
+  writeCount(1);
+  m_count = 1;
+  m_used = sizeof(header) + m_dataSize;
+  memcpy(m_last, sample, m_dataSize);
+  m_time = time;
+}
+
+uint8_t CompressedRingBuffer::encode(const uint8_t *prev, const uint8_t *sample,
+                                     uint8_t *out)
+{
+  uint8_t len = 0;
+  for (uint8_t i=0; i<m_dataSize; i+=2) {
+    uint16_t zigzag;
+    if ( i+1 < m_dataSize ) {
+      int16_t a, b;
+      memcpy(&a, prev+i, sizeof(a));
+      memcpy(&b, sample+i, sizeof(b));
+      int16_t delta = (int16_t)(b - a);
+      zigzag = (uint16_t)((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+    }
+    else {
+      int8_t delta = (int8_t)(sample[i] - prev[i]);
+      zigzag = (uint8_t)((uint8_t)delta << 1) ^ (uint8_t)(delta >> 7);
+    }
+    while ( zigzag >= 0x80 ) {
+      out[len++] = (zigzag & 0x7F) | 0x80;
+      zigzag >>= 7;
+    }
+    out[len++] = zigzag;
+  }
+  return len;
+}
+
+uint16_t CompressedRingBuffer::decode(uint16_t addr, uint8_t *sample)
+{
+  for (uint8_t i=0; i<m_dataSize; i+=2) {
+    uint16_t zigzag = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+    do {
+      b = m_eeprom.read_byte(addr++);
+      zigzag |= (uint16_t)(b & 0x7F) << shift;
+      shift += 7;
+    } while ( (b & 0x80) && shift < 21 );
+    uint16_t delta = (zigzag >> 1) ^ (uint16_t)(-(zigzag & 1));
+    if ( i+1 < m_dataSize ) {
+      int16_t a;
+      memcpy(&a, sample+i, sizeof(a));
+      a = (int16_t)(a + delta);
+      memcpy(sample+i, &a, sizeof(a));
+    }
+    else {
+      sample[i] += (uint8_t)delta;
+    }
+  }
+  return addr;
+}
+
+uint16_t CompressedRingBuffer::decodeFrame(uint16_t frame, uint8_t pos, uint8_t *sample)
+{
+  uint16_t addr = frameAddr(frame) + sizeof(FrameHeader);
+  m_eeprom.read_block(addr, (void *)sample, m_dataSize);
+  addr += m_dataSize;
+  for (uint8_t i=0; i<pos; i++) {
+    addr = decode(addr, sample);
+  }
+  return addr;
+}
+
+long CompressedRingBuffer::read(uint16_t index, DataSample &data)
+{
+  uint8_t *out = (uint8_t *)data.data();
+  long oldest = m_time + m_period;
+  if ( m_count > 0 ) {
+    // skip the newer frames with their header
+    uint16_t frame = m_frame;
+    uint16_t seq = m_seq;
+    for (uint16_t i=0; i<m_frames; i++) {
+      FrameHeader header;
+      readHeader(frame, header);
+      uint8_t count = frameCount(header);
+      if ( header.seq != seq || count == 0 ) break;
+      if ( index < count ) {
+        uint8_t pos = count-1-index;
+        decodeFrame(frame, pos, out);
+        return header.time + (long)pos*m_period;
+      }
+      index -= count;
+      oldest = header.time;
+      frame = ( frame == 0 ) ? m_frames-1 : frame-1;
+      seq = prevSeq(seq);
+    }
+  }
+  memset(out, 0xFF, m_dataSize);
+  return oldest - (long)(index+1)*m_period;
+}
+
+uint16_t CompressedRingBuffer::count()
+{
+  uint16_t samples = 0;
+  if ( m_count == 0 ) return 0;
+  uint16_t frame = m_frame;
+  uint16_t seq = m_seq;
+  for (uint16_t i=0; i<m_frames; i++) {
+    FrameHeader header;
+    readHeader(frame, header);
+    if ( header.seq != seq || frameCount(header) == 0 ) break;
+    samples += frameCount(header);
+    frame = ( frame == 0 ) ? m_frames-1 : frame-1;
+    seq = prevSeq(seq);
+  }
+  return samples;
+}
+
+void CompressedRingBuffer::clear()
+{
+  // erase the headers from the newest one: if the power is lost, the
+  // frames left are still a valid (older) history
+  uint16_t frame = m_frame;
+  for (uint16_t i=0; i<m_frames; i++) {
+    m_eeprom.erase(frameAddr(frame), sizeof(FrameHeader));
+    frame = ( frame == 0 ) ? m_frames-1 : frame-1;
+  }
+  m_frame = 0;
+  m_seq = 0;
+  m_count = 0;
+}
+
+CompressedRingBuffer::Iterator::Iterator(CompressedRingBuffer &buffer) :
+  m_buffer(buffer),
+  m_frame(buffer.m_frame),
+  m_frames(0),
+  m_addr(0),
+  m_left(0),
+  m_time(0)
+{
+  if ( buffer.m_count == 0 ) return;
+  // walk back to the oldest frame
+  uint16_t frame = buffer.m_frame;
+  uint16_t seq = buffer.m_seq;
+  for (uint16_t i=0; i<buffer.m_frames; i++) {
+    FrameHeader header;
+    buffer.readHeader(frame, header);
+    if ( header.seq != seq || frameCount(header) == 0 ) break;
+    m_frame = frame;
+    m_frames++;
+    frame = ( frame == 0 ) ? buffer.m_frames-1 : frame-1;
+    seq = prevSeq(seq);
+  }
+}
+
+bool CompressedRingBuffer::Iterator::next(DataSample &data)
+{
+  if ( m_left == 0 ) {
+    if ( m_frames == 0 ) return false;
+    FrameHeader header;
+    m_buffer.readHeader(m_frame, header);
+    m_left = frameCount(header);
+    m_time = header.time;
+    m_addr = m_buffer.frameAddr(m_frame) + sizeof(header);
+    m_buffer.m_eeprom.read_block(m_addr, (void *)m_sample, m_buffer.m_dataSize);
+    m_addr += m_buffer.m_dataSize;
+    m_frames--;
+    m_frame = ( m_frame+1 == m_buffer.m_frames ) ? 0 : m_frame+1;
+  }
+  else {
+    m_addr = m_buffer.decode(m_addr, m_sample);
+    m_time += m_buffer.m_period;
+  }
+  m_left--;
+  memcpy(data.data(), m_sample, m_buffer.m_dataSize);
+  return true;
+}
@@ -0,0 +1,230 @@
+/**
+   CompressedRingBuffer.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CompressedRingBuffer_h
+#define CompressedRingBuffer_h
+
+#include "SafeEeprom.h"
+#include "DataSample.h"
+
+/** Largest sample (in bytes) stored by a CompressedRingBuffer: the last
+    sample inserted is kept in RAM to compute the next delta. */
+#ifndef COMPRESSED_MAX_SAMPLE
+#define COMPRESSED_MAX_SAMPLE 16
+#endif
+
+/**
+   Timed ring buffer storing the samples as deltas, for slowly varying
+   values.
+
+   This is the compressed counterpart of TimePermRingBuffer: samples are
+   inserted with a time stamp every period, but rather than one slot of
+   dataSize bytes per sample, the storage is split in frames (a page of
+   the device, or a multiple of it, is the best frame size). A frame
+   starts with a header (time stamp, sequence number and number of
+   samples), followed by its first sample in full, and then by the next
+   samples as deltas from the previous one. The sample is seen as a
+   series of int16_t channels (plus an int8_t channel if dataSize is odd);
+   the delta of each channel is zig-zag encoded in a varint: 1 byte for a
+   change within -64..63, 2 bytes within -8192..8191, 3 bytes otherwise.
+
+   A push appends the delta and then writes the new count of the frame
+   header, so a power loss never exposes a partial sample. The count is
+   written with its complement, alternately in two slots: if the write
+   is interrupted, the other slot still holds the previous count. When a
+   frame is full, or when samples were missed (the time elapsed is more
+   than one period), the next frame is started: a downtime only costs the
+   header of a new frame, and the missing samples are not stored.
+
+   read() skips the frames with their header, and only decodes the frame
+   holding the sample. When the buffer is created, the newest frame is
+   found with the sequence numbers of the headers, and decoded to get the
+   last sample back.
+
+   @note The compression depends on the data: a sample changing by more
+   than 8191 on a channel takes more space than in TimePermRingBuffer.
+ */
+class CompressedRingBuffer
+{
+public:
+  /** Create a compressed ring buffer on the EEPROM.
+      @param ee         EEPROM to use
+      @param startAddr  at which EEPROM address the data structure will start
+      @param length     bytes of EEPROM to use (a whole number of frames is used)
+      @param dataSize   size of the each sample (up to COMPRESSED_MAX_SAMPLE)
+      @param timePeriod delay between two samples
+      @param frameSize  bytes of a frame, up to 255
+   */
+  CompressedRingBuffer(SafeEeprom &ee, uint16_t startAddr, uint16_t length,
+                       size_t dataSize, int timePeriod, uint8_t frameSize=64);
+
+  /** Insert a sample if its time stamp is one or several periods after the
+      last one (see TimePermRingBuffer). A time stamp in the past clears
+      the buffer.
+      @return           true if the sample was inserted
+   */
+  bool insert(DataSample &data, long time);
+
+  /** Read a sample.
+      @param index      0 for the newest sample, 1 for the previous one...
+      @param data       sample receiving the data read, 0xFF when the
+                        buffer holds index samples or less
+      @return           time stamp of the sample (extrapolated from the
+                        oldest sample when it is not stored)
+   */
+  long read(uint16_t index, DataSample &data);
+
+  /** Return the number of samples stored. The missing samples are not
+      counted, so the samples are not always one period apart.
+   */
+  uint16_t count();
+
+  /** Return the time stamp of the last sample inserted.
+   */
+  long lastTimeStamp() {
+    return m_time;
+  }
+
+  /** Return the period of this timed ring buffer.
+   */
+  int period() {
+    return m_period;
+  }
+
+  /** Remove all the samples (only the frame headers are erased).
+   */
+  void clear();
+
+  /** Return the number of frames of the buffer.
+   */
+  uint16_t frames() {
+    return m_frames;
+  }
+
+  /** Return the total storage size on the EEPROM.
+   */
+  uint16_t storageSize() {
+    return m_frames*m_frameSize;
+  }
+
+  /** Header of a frame, at its start on the EEPROM */
+  struct FrameHeader {
+    uint8_t count[4];           /** Two slots of the number of samples in
+                                    the frame followed by its complement */
+    int32_t time;               /** Time stamp of the first sample */
+    uint16_t seq;               /** Sequence number, 0xFFFF when erased */
+    uint16_t reserved;          /** Not used, 0xFFFF */
+  };
+
+  /**
+     Sequential access to the samples of the buffer, from the oldest to
+     the newest, decoding each frame once.
+   */
+  class Iterator
+  {
+  public:
+    /** Start an iteration.
+        @param buffer     compressed ring buffer to read
+     */
+    Iterator(CompressedRingBuffer &buffer);
+
+    /** Read the next sample.
+        @param data       sample receiving the data read
+        @return           false when all the samples were visited
+     */
+    bool next(DataSample &data);
+
+    /** Return the time stamp of the sample returned by next().
+     */
+    long time() {
+      return m_time;
+    }
+
+  protected:
+    CompressedRingBuffer &m_buffer;
+    uint16_t m_frame;             /** Frame of the next sample */
+    uint16_t m_frames;            /** Frames still to visit, with m_frame */
+    uint16_t m_addr;              /** Address of the next delta */
+    uint8_t m_left;               /** Samples still to read in m_frame */
+    long m_time;
+    uint8_t m_sample[COMPRESSED_MAX_SAMPLE];
+  };
+
+protected:
+  /** Return the address of a frame. */
+  uint16_t frameAddr(uint16_t frame) {
+    return m_start + frame*m_frameSize;
+  }
+
+  /** Read the header of a frame. */
+  void readHeader(uint16_t frame, FrameHeader &header);
+
+  /** Return the number of samples of a frame (0 if none is valid). */
+  static uint8_t frameCount(const FrameHeader &header);
+
+  /** Write the number of samples of the newest frame. */
+  void writeCount(uint8_t count);
+
+  /** Start a new frame with a sample. */
+  void startFrame(const uint8_t *sample, long time);
+
+  /** Encode the delta from prev to sample in out, return its length. */
+  uint8_t encode(const uint8_t *prev, const uint8_t *sample, uint8_t *out);
+
+  /** Apply the delta at addr to sample, return the address following it. */
+  uint16_t decode(uint16_t addr, uint8_t *sample);
+
+  /** Decode the sample at position pos of a frame, return the address
+      following it. */
+  uint16_t decodeFrame(uint16_t frame, uint8_t pos, uint8_t *sample);
+
+  /** Find the newest frame and the last sample on the EEPROM. */
+  void recover();
+
+  /** Return the sequence number following seq (0xFFFF is skipped). */
+  static uint16_t nextSeq(uint16_t seq) {
+    return ( seq == 0xFFFE ) ? 0 : seq+1;
+  }
+
+  /** Return the sequence number preceding seq. */
+  static uint16_t prevSeq(uint16_t seq) {
+    return ( seq == 0 ) ? 0xFFFE : seq-1;
+  }
+
+  SafeEeprom &m_eeprom;         /** Device storing the ring buffer */
+  uint16_t m_start;             /** Address of the first frame */
+  uint16_t m_frames;            /** Number of frames */
+  uint8_t m_frameSize;          /** Bytes of a frame */
+  uint8_t m_dataSize;           /** Bytes of a sample */
+  int m_period;
+  uint16_t m_frame;             /** Newest frame */
+  uint16_t m_seq;               /** Sequence number of the newest frame */
+  uint8_t m_count;              /** Samples in the newest frame, 0 when
+                                    the buffer is empty */
+  uint8_t m_used;               /** Bytes used in the newest frame */
+  long m_time;                  /** Time stamp of the last sample */
+  uint8_t m_last[COMPRESSED_MAX_SAMPLE]; /** Last sample inserted */
+
+private:
+  // prohibited...
+  CompressedRingBuffer(CompressedRingBuffer const&);
+  void operator=(CompressedRingBuffer const&);
+
+};
+
+#endif
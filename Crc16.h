@@ -0,0 +1,125 @@
+/**
+   Crc16.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef Crc16_h
+#define Crc16_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#else
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#endif
+
+/** Implementations of the CRC16, to select with CRC16_VARIANT. */
+#define CRC16_BITWISE 0
+#define CRC16_NIBBLE  1
+#define CRC16_TABLE   2
+
+/** Implementation used by the library [default=CRC16_BITWISE]. */
+#ifndef CRC16_VARIANT
+#define CRC16_VARIANT CRC16_BITWISE
+#endif
+
+/**
+   CRC16 of the library: polynomial 0xA001 (reflected 0x8005), the one of
+   the avr-libc _crc16_update. The data structures start the CRC with
+   0xFFFF.
+
+   Three implementations compute the same CRC, trading flash for speed:
+   - Crc16Bitwise shifts the 8 bits of each byte (no table). On the AVR,
+     it uses the optimized _crc16_update of avr-libc.
+   - Crc16Nibble looks up a 16 entries table (32 bytes) twice per byte.
+   - Crc16Table looks up a 256 entries table (512 bytes) once per byte.
+
+   The tables are stored in flash (PROGMEM) on the AVR. Crc16 is the
+   implementation selected by CRC16_VARIANT; all of them stay available
+   to compare them (see tests/host/crc16Bench.cpp).
+ */
+struct Crc16Bitwise
+{
+  static uint16_t update(uint16_t crc, uint8_t a) {
+#ifdef __AVR__
+    return _crc16_update(crc, a);
+#else
+    crc ^= a;
+    for (uint8_t i=0; i<8; i++) {
+      if ( crc & 1 ) crc = (crc >> 1) ^ 0xA001; else crc = (crc >> 1);
+    }
+    return crc;
+#endif
+  }
+
+  static uint16_t block(uint16_t crc, const void *data, size_t len) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    while ( len-- ) crc = update(crc, *ptr++);
+    return crc;
+  }
+};
+
+extern const uint16_t crc16NibbleTable[16] PROGMEM;
+
+struct Crc16Nibble
+{
+  static uint16_t update(uint16_t crc, uint8_t a) {
+    crc ^= a;
+    crc = (crc >> 4) ^ pgm_read_word(&crc16NibbleTable[crc & 0x0F]);
+    crc = (crc >> 4) ^ pgm_read_word(&crc16NibbleTable[crc & 0x0F]);
+    return crc;
+  }
+
+  static uint16_t block(uint16_t crc, const void *data, size_t len) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    while ( len-- ) crc = update(crc, *ptr++);
+    return crc;
+  }
+};
+
+extern const uint16_t crc16ByteTable[256] PROGMEM;
+
+struct Crc16Table
+{
+  static uint16_t update(uint16_t crc, uint8_t a) {
+    return (crc >> 8) ^ pgm_read_word(&crc16ByteTable[(crc ^ a) & 0xFF]);
+  }
+
+  static uint16_t block(uint16_t crc, const void *data, size_t len) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    // two bytes per iteration
+    for ( ; len >= 2; len -= 2, ptr += 2 ) {
+      crc = (crc >> 8) ^ pgm_read_word(&crc16ByteTable[(crc ^ ptr[0]) & 0xFF]);
+      crc = (crc >> 8) ^ pgm_read_word(&crc16ByteTable[(crc ^ ptr[1]) & 0xFF]);
+    }
+    if ( len ) crc = update(crc, *ptr);
+    return crc;
+  }
+};
+
+#if CRC16_VARIANT == CRC16_TABLE
+typedef Crc16Table Crc16;
+#elif CRC16_VARIANT == CRC16_NIBBLE
+typedef Crc16Nibble Crc16;
+#else
+typedef Crc16Bitwise Crc16;
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+/**
+   EepromJournal.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "EepromJournal.h"
+
+#include "Crc16.h"
+
+#ifdef SERIAL_DEBUG
+#include "HardwareSerial.h"
+#endif
+
+#include <stdlib.h>     // for exit
+#include <string.h>
+
+/** Flag of the Entry length marking a fill. */
+#define JOURNAL_FILL 0x8000
+
+EepromJournal::EepromJournal(SafeEeprom &ee, uint16_t startAddr, uint16_t capacity) :
+  m_eeprom(ee),
+  m_recordAddr(startAddr),
+  m_entriesAddr(startAddr + sizeof(Record)),
+  m_capacity(capacity),
+  m_open(false),
+  m_overflow(false),
+  m_replayed(false),
+  m_used(0),
+  m_crc(0xFFFF)
+{
+  // Check if there is enough EEPROM
+  if ( (uint32_t)startAddr + storageSize() > m_eeprom.memSize() ) {
+    exit(-1);
+  }
+  recover();
+}
+
+uint16_t EepromJournal::storageSize()
+{
+  return sizeof(Record) + m_capacity;
+}
+
+void EepromJournal::begin()
+{
+  if ( m_open ) return;
+  m_open = true;
+  m_overflow = false;
+  m_used = 0;
+  m_crc = 0xFFFF;
+}
+
+bool EepromJournal::commit()
+{
+  if ( ! m_open ) return true;
+  m_open = false;
+  if ( m_overflow ) return false;
+  if ( m_used == 0 ) return true;
+
+  // the transaction is durable once this record is written...
+  Record record;
+  record.length = m_used;
+  record.crc16 = Crc16::block(m_crc, &m_used, sizeof(m_used));
+  m_eeprom.write_block(m_recordAddr, (void *)&record, sizeof(record));
+
+  // ... and complete once the journal is copied
+  apply(m_used);
+  m_eeprom.erase(m_recordAddr, sizeof(record));
+  m_used = 0;
+  return true;
+}
+
+void EepromJournal::abort()
+{
+  m_open = false;
+  m_used = 0;
+}
+
+void EepromJournal::recover()
+{
+  Record record;
+  m_eeprom.read_block(m_recordAddr, (void *)&record, sizeof(record));
+  if ( 0xFFFF == record.length && 0xFFFF == record.crc16 ) {
+    // no transaction pending
+    return;
+  }
+
+  if ( record.length > 0 && record.length <= m_capacity
+       && record.crc16 == journalCrc(record.length) ) {
+#ifdef SERIAL_DEBUG
+    Serial.print("==== EepromJournal: replay ");
+    Serial.print(record.length, DEC);
+    Serial.println(" bytes");
+#endif
+    apply(record.length);
+    m_replayed = true;
+  }
+#ifdef SERIAL_DEBUG
+  else {
+    Serial.println("==== EepromJournal: torn record -> discard");
+  }
+#endif
+  // replayed, or written partially before the power loss
+  m_eeprom.erase(m_recordAddr, sizeof(record));
+}
+
+uint16_t EepromJournal::journalCrc(uint16_t length)
+{
+  uint8_t chunk[JOURNAL_READ_CHUNK];
+  uint16_t crc = 0xFFFF;
+  for (uint16_t pos=0; pos<length; pos+=JOURNAL_READ_CHUNK) {
+    uint16_t n = ( length-pos < JOURNAL_READ_CHUNK ) ? length-pos : JOURNAL_READ_CHUNK;
+    m_eeprom.read_block(m_entriesAddr+pos, (void *)chunk, n);
+    crc = Crc16::block(crc, chunk, n);
+  }
+  return Crc16::block(crc, &length, sizeof(length));
+}
+
+void EepromJournal::apply(uint16_t length)
+{
+  uint8_t chunk[JOURNAL_READ_CHUNK];
+  uint16_t pos = 0;
+  while ( pos + sizeof(Entry) <= length ) {
+    Entry entry;
+    m_eeprom.read_block(m_entriesAddr+pos, (void *)&entry, sizeof(entry));
+    pos += sizeof(entry);
+    uint16_t len = entry.len & ~JOURNAL_FILL;
+    if ( entry.len & JOURNAL_FILL ) {
+      m_eeprom.fill(entry.addr, m_eeprom.read_byte(m_entriesAddr+pos), len);
+      pos++;
+    }
+    else {
+      // the bytes already copied before a power loss are not programmed again
+      for (uint16_t done=0; done<len; done+=JOURNAL_READ_CHUNK) {
+        uint16_t n = ( len-done < JOURNAL_READ_CHUNK ) ? len-done : JOURNAL_READ_CHUNK;
+        m_eeprom.read_block(m_entriesAddr+pos+done, (void *)chunk, n);
+        m_eeprom.update_block(entry.addr+done, (void *)chunk, n);
+      }
+      pos += len;
+    }
+  }
+}
+
+void EepromJournal::stage(uint16_t addr, const void *data, size_t len, bool isFill)
+{
+  if ( len == 0 || m_overflow ) return;
+  uint16_t payload = isFill ? 1 : len;
+  if ( len >= JOURNAL_FILL
+       || (uint32_t)m_used + sizeof(Entry) + payload > m_capacity ) {
+    // commit() will discard the whole transaction
+    m_overflow = true;
+    return;
+  }
+
+  Entry entry;
+  entry.addr = addr;
+  entry.len = isFill ? (len | JOURNAL_FILL) : len;
+  // the journal of the previous transaction is still there: update only
+  m_eeprom.update_block(m_entriesAddr+m_used, (void *)&entry, sizeof(entry));
+  m_eeprom.update_block(m_entriesAddr+m_used+sizeof(entry), (void *)data, payload);
+  m_crc = Crc16::block(m_crc, &entry, sizeof(entry));
+  m_crc = Crc16::block(m_crc, data, payload);
+  m_used += sizeof(entry) + payload;
+}
+
+void EepromJournal::overlay(uint16_t addr, uint8_t *data, size_t len)
+{
+  // later entries override the earlier ones
+  uint16_t pos = 0;
+  while ( pos < m_used ) {
+    Entry entry;
+    m_eeprom.read_block(m_entriesAddr+pos, (void *)&entry, sizeof(entry));
+    pos += sizeof(entry);
+    uint16_t entryLen = entry.len & ~JOURNAL_FILL;
+    uint32_t from = ( entry.addr > addr ) ? entry.addr : addr;
+    uint32_t to = (uint32_t)entry.addr + entryLen;
+    if ( (uint32_t)addr + len < to ) to = (uint32_t)addr + len;
+    if ( entry.len & JOURNAL_FILL ) {
+      if ( from < to ) {
+        memset(data+(from-addr), m_eeprom.read_byte(m_entriesAddr+pos), to-from);
+      }
+      pos++;
+    }
+    else {
+      if ( from < to ) {
+        m_eeprom.read_block(m_entriesAddr+pos+(from-entry.addr),
+                            (void *)(data+(from-addr)), to-from);
+      }
+      pos += entryLen;
+    }
+  }
+}
+
+void EepromJournal::write_byte(uint16_t addr, uint8_t data)
+{
+  write_block(addr, (void *)&data, sizeof(data));
+}
+
+uint8_t EepromJournal::read_byte(uint16_t addr)
+{
+  uint8_t data;
+  read_block(addr, (void *)&data, sizeof(data));
+  return data;
+}
+
+void EepromJournal::write_word(uint16_t addr, uint16_t data)
+{
+  write_block(addr, (void *)&data, sizeof(data));
+}
+
+uint16_t EepromJournal::read_word(uint16_t addr)
+{
+  uint16_t data;
+  read_block(addr, (void *)&data, sizeof(data));
+  return data;
+}
+
+void EepromJournal::write_long(uint16_t addr, uint32_t data)
+{
+  write_block(addr, (void *)&data, sizeof(data));
+}
+
+uint32_t EepromJournal::read_long(uint16_t addr)
+{
+  uint32_t data;
+  read_block(addr, (void *)&data, sizeof(data));
+  return data;
+}
+
+void EepromJournal::write_block(uint16_t addr, void* data, size_t len)
+{
+  if ( m_open ) stage(addr, data, len, false);
+  else m_eeprom.write_block(addr, data, len);
+}
+
+void EepromJournal::read_block(uint16_t addr, void* data, size_t len)
+{
+  m_eeprom.read_block(addr, data, len);
+  if ( m_open ) overlay(addr, (uint8_t *)data, len);
+}
+
+void EepromJournal::update_byte(uint16_t addr, uint8_t data)
+{
+  update_block(addr, (void *)&data, sizeof(data));
+}
+
+void EepromJournal::update_word(uint16_t addr, uint16_t data)
+{
+  update_block(addr, (void *)&data, sizeof(data));
+}
+
+void EepromJournal::update_long(uint16_t addr, uint32_t data)
+{
+  update_block(addr, (void *)&data, sizeof(data));
+}
+
+void EepromJournal::update_block(uint16_t addr, void* data, size_t len)
+{
+  // the journal is always copied with updates
+  if ( m_open ) stage(addr, data, len, false);
+  else m_eeprom.update_block(addr, data, len);
+}
+
+void EepromJournal::fill(uint16_t addr, uint8_t value, size_t len)
+{
+  if ( m_open ) stage(addr, &value, len, true);
+  else m_eeprom.fill(addr, value, len);
+}
+
+uint16_t EepromJournal::memSize()
+{
+  return m_eeprom.memSize();
+}
+
+uint16_t EepromJournal::pageSize()
+{
+  return m_eeprom.pageSize();
+}
+
+void EepromJournal::show(uint16_t start, int len)
+{
+  m_eeprom.show(start, len);
+}
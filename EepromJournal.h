@@ -0,0 +1,194 @@
+/**
+   EepromJournal.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EepromJournal_h
+#define EepromJournal_h
+
+#include "SafeEeprom.h"
+
+/** Size of the chunks read from the journal during a replay. */
+#ifndef JOURNAL_READ_CHUNK
+#define JOURNAL_READ_CHUNK 16
+#endif
+
+/**
+   Power-fail-safe transactions over several areas of an EEPROM.
+
+   A structure like TimePermRingBuffer updates several independent areas
+   (time stamp, data, index) in sequence: a power loss between two of
+   them leaves the areas inconsistent. EepromJournal is a SafeEeprom
+   placed in front of the device: between begin() and commit(), the
+   writes are not done in place but appended to a journal area. commit()
+   makes the whole transaction durable with a single write of a commit
+   record (length and CRC16 of the journal), then copies the journaled
+   writes to their destination, and finally erases the record.
+
+   When the journal is created, a valid commit record means the power was
+   lost while the transaction was copied: the journal is replayed (the
+   copy is idempotent). Otherwise the pending writes are discarded, and
+   the areas keep their content before the transaction. So the journal
+   must be created before the structures using it:
+
+     EepromJournal journal(ee, 0, 64);
+     TimePermRingBuffer timed(journal, journal.storageSize(), ...);
+     ...
+     journal.begin();
+     timed.insert(sample, time);
+     journal.commit();
+
+   Outside a transaction the writes go directly to the device. Inside a
+   transaction, the reads return the journaled data. The areas written in
+   a transaction must not overlap the journal itself.
+
+   @warning The commit record is written and erased for each transaction,
+   and the journal area rewritten: place the journal on a part of the
+   EEPROM which is not already heavily used.
+
+   Documentation of the SafeEeprom methods is provided by the interface.
+ */
+class EepromJournal : public SafeEeprom
+{
+public:
+  /** Create the journal and recover the last transaction if needed.
+      @param ee         EEPROM actually storing the data
+      @param startAddr  address of the journal on the EEPROM
+      @param capacity   bytes available to journal a transaction
+                        (each write needs 4 bytes plus its data, and each
+                        fill 5 bytes)
+   */
+  EepromJournal(SafeEeprom &ee, uint16_t startAddr, uint16_t capacity);
+
+  /** Start a transaction. Calling it again before commit() continues
+      the same transaction.
+   */
+  void begin();
+
+  /** Make all the writes of the transaction durable at once.
+      @return           false if the transaction did not fit in the journal
+                        (then none of its writes is done, and the
+                        structures written must be reloaded)
+   */
+  bool commit();
+
+  /** Drop the writes of the transaction. The structures written during
+      the transaction must be reloaded.
+   */
+  void abort();
+
+  /** Return true if a transaction is open.
+   */
+  bool pending() {
+    return m_open;
+  }
+
+  /** Return true if a committed transaction was replayed when the
+      journal was created.
+   */
+  bool replayed() {
+    return m_replayed;
+  }
+
+  /** Return the bytes of journal used by the open transaction.
+   */
+  uint16_t used() {
+    return m_used;
+  }
+
+  /** Return the size of the journal on the EEPROM.
+   */
+  uint16_t storageSize();
+
+  void write_byte(uint16_t addr, uint8_t data);
+
+  uint8_t read_byte(uint16_t addr);
+
+  void write_word(uint16_t addr, uint16_t data);
+
+  uint16_t read_word(uint16_t addr);
+
+  void write_long(uint16_t addr, uint32_t data);
+
+  uint32_t read_long(uint16_t addr);
+
+  void write_block(uint16_t addr, void* data, size_t len);
+
+  void read_block(uint16_t addr, void* data, size_t len);
+
+  void update_byte(uint16_t addr, uint8_t data);
+
+  void update_word(uint16_t addr, uint16_t data);
+
+  void update_long(uint16_t addr, uint32_t data);
+
+  void update_block(uint16_t addr, void* data, size_t len);
+
+  void fill(uint16_t addr, uint8_t value, size_t len);
+
+  uint16_t memSize();
+
+  uint16_t pageSize();
+
+  void show(uint16_t start=0, int len=-1);
+
+protected:
+  /** Record making a transaction durable, erased when none is pending. */
+  struct Record {
+    uint16_t length;            /** Bytes of journal to replay */
+    uint16_t crc16;             /** CRC of the journal and the length */
+  };
+
+  /** Header of a write in the journal, followed by the data (or by the
+      value for a fill). */
+  struct Entry {
+    uint16_t addr;              /** Destination of the write */
+    uint16_t len;               /** Bytes written, top bit set for a fill */
+  };
+
+  /** Append a write (or a fill) to the journal. */
+  void stage(uint16_t addr, const void *data, size_t len, bool isFill);
+
+  /** Copy the journaled writes over the data read from addr. */
+  void overlay(uint16_t addr, uint8_t *data, size_t len);
+
+  /** Copy length bytes of journal to the destination of the writes. */
+  void apply(uint16_t length);
+
+  /** Return the CRC of length bytes of journal read from the EEPROM. */
+  uint16_t journalCrc(uint16_t length);
+
+  /** Replay or discard the transaction found on the EEPROM. */
+  void recover();
+
+  SafeEeprom &m_eeprom;         /** Device storing the data */
+  uint16_t m_recordAddr;        /** Address of the commit record */
+  uint16_t m_entriesAddr;       /** Address of the first journal entry */
+  uint16_t m_capacity;          /** Size of the journal entries area */
+  bool m_open;                  /** A transaction is open */
+  bool m_overflow;              /** The transaction did not fit */
+  bool m_replayed;              /** A transaction was replayed at start */
+  uint16_t m_used;              /** Bytes of journal used */
+  uint16_t m_crc;               /** Running CRC of the journal */
+
+private:
+  // prohibited...
+  EepromJournal(EepromJournal const&);
+  void operator=(EepromJournal const&);
+
+};
+
+#endif
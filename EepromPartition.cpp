@@ -0,0 +1,113 @@
+/**
+   EepromPartition.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "EepromPartition.h"
+
+#include "Crc16.h"
+
+#ifdef SERIAL_DEBUG
+#include "HardwareSerial.h"
+#endif
+
+#include <string.h>
+
+/** Marks a partition table. */
+#define EEPROM_PARTITION_MAGIC 0xE9A7
+
+EepromPartition::EepromPartition(SafeEeprom &ee, uint16_t startAddr, uint16_t len) :
+  m_eeprom(ee),
+  m_startAddr(startAddr),
+  m_pageSize(ee.pageSize()),
+  m_ok(true),
+  m_changed(0)
+{
+  uint32_t end = ( len > 0 ) ? (uint32_t)startAddr + len : m_eeprom.memSize();
+  if ( end > m_eeprom.memSize() ) end = m_eeprom.memSize();
+  m_end = end;
+  m_next = alignUp(startAddr + sizeof(Header), m_pageSize);
+  if ( m_next > m_end ) {
+    m_next = m_end;
+    m_ok = false;
+  }
+  memset(&m_header, 0xFF, sizeof(m_header));
+  m_header.magic = EEPROM_PARTITION_MAGIC;
+  m_header.count = 0;
+}
+
+uint16_t EepromPartition::allocate(uint16_t size, uint16_t tag, bool align)
+{
+  uint32_t start = align ? alignUp(m_next, m_pageSize) : m_next;
+  if ( m_header.count >= EEPROM_PARTITION_REGIONS || start + size > m_end ) {
+#ifdef SERIAL_DEBUG
+    Serial.print("EepromPartition: no space for a region of ");
+    Serial.println(size, DEC);
+#endif
+    m_ok = false;
+    return EEPROM_PARTITION_NONE;
+  }
+  Region &region = m_header.regions[m_header.count++];
+  region.start = start;
+  region.size = size;
+  region.tag = tag;
+  m_next = start + size;
+  return start;
+}
+
+uint8_t EepromPartition::mount()
+{
+  m_changed = 0;
+  if ( ! m_ok ) return 0;
+
+  // the table of the previous boot
+  Header stored;
+  m_eeprom.read_block(m_startAddr, (void *)&stored, sizeof(stored));
+  bool valid = ( EEPROM_PARTITION_MAGIC == stored.magic
+                 && stored.count <= EEPROM_PARTITION_REGIONS
+                 && headerCrc(stored) == stored.crc16 );
+
+  uint8_t erased = 0;
+  for (uint8_t i=0; i<m_header.count; i++) {
+    const Region &region = m_header.regions[i];
+    if ( valid && i < stored.count
+         && stored.regions[i].start == region.start
+         && stored.regions[i].size == region.size
+         && stored.regions[i].tag == region.tag ) {
+      continue;
+    }
+    // new region, or holding data of another layout
+    m_eeprom.erase(region.start, region.size);
+    m_changed |= 1 << i;
+    erased++;
+  }
+
+  m_header.crc16 = headerCrc(m_header);
+  if ( ! valid || memcmp(&stored, &m_header, sizeof(m_header)) != 0 ) {
+#ifdef SERIAL_DEBUG
+    Serial.print("EepromPartition: new layout, regions erased = ");
+    Serial.println(erased, DEC);
+#endif
+    // written last: a power loss before erases the regions again
+    m_eeprom.update_block(m_startAddr, (void *)&m_header, sizeof(m_header));
+  }
+  return erased;
+}
+
+uint16_t EepromPartition::headerCrc(const Header &header)
+{
+  return Crc16::block(0xFFFF, &header, sizeof(header) - sizeof(header.crc16));
+}
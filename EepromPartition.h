@@ -0,0 +1,177 @@
+/**
+   EepromPartition.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EepromPartition_h
+#define EepromPartition_h
+
+#include "SafeEeprom.h"
+
+/** Maximum number of regions of an EepromPartition. Changing it moves
+    all the regions. */
+#ifndef EEPROM_PARTITION_REGIONS
+#define EEPROM_PARTITION_REGIONS 8
+#endif
+
+#if EEPROM_PARTITION_REGIONS > 16
+#error "EepromPartition tracks at most 16 regions"
+#endif
+
+/** Address returned when a region cannot be allocated. */
+#define EEPROM_PARTITION_NONE 0xFFFF
+
+/**
+   Allocator of the EEPROM regions used by the data structures, with a
+   partition table stored on the EEPROM.
+
+   Rather than computing the start address of each structure by hand,
+   the application allocates a region for each of them, in the same
+   order at every boot, using the static layoutSize() of the structures:
+
+     EepromPartition partition(ee);
+     uint16_t counter = partition.allocate(EnduranceEeprom::layoutSize(8, 4));
+     uint16_t history = partition.allocate(TimePermRingBuffer::layoutSize(32, 4));
+     partition.mount();
+     EnduranceEeprom count(ee, counter, 8, 4);
+     TimePermRingBuffer timed(ee, history, 32, 4, 60);
+
+   The regions start on a page boundary (so a structure never shares a
+   page with its neighbor), and allocate() reports the lack of space
+   instead of the structure calling exit().
+
+   mount() compares the regions with the table stored at the start of
+   the partition by the previous boot (a single read). The regions which
+   are new, moved, resized or have a new tag are erased, so their
+   structures are initialized again instead of interpreting data written
+   by another layout, and the table is updated. The other regions keep
+   their data. When the table itself is corrupted, all the regions are
+   erased.
+
+   The addresses can also be computed at compile time with firstRegion()
+   and nextRegion() when the page size is known.
+ */
+class EepromPartition
+{
+public:
+  /** Description of a region in the partition table. */
+  struct Region {
+    uint16_t start;             /** Address of the region */
+    uint16_t size;              /** Size of the region */
+    uint16_t tag;               /** Type or version chosen by the application */
+  };
+
+  /** Partition table stored at the start of the partition. */
+  struct Header {
+    uint16_t magic;             /** Identifies a partition table */
+    uint16_t count;             /** Number of regions */
+    Region regions[EEPROM_PARTITION_REGIONS];
+    uint16_t crc16;             /** CRC of the previous fields */
+  };
+
+  /** Create a partition.
+      @param ee         EEPROM storing the data structures
+      @param startAddr  address of the partition [default=0]
+      @param len        size of the partition [default=0 -> up to the
+                        end of the EEPROM]
+   */
+  EepromPartition(SafeEeprom &ee, uint16_t startAddr=0, uint16_t len=0);
+
+  /** Allocate a region after the previous ones.
+      @param size       size of the region (layoutSize() of the structure)
+      @param tag        type or version of the structure: changing it
+                        erases the region at mount() [default=0]
+      @param align      start the region on a page boundary [default=true]
+      @return           address of the region, EEPROM_PARTITION_NONE if
+                        there is not enough space or too many regions
+   */
+  uint16_t allocate(uint16_t size, uint16_t tag=0, bool align=true);
+
+  /** Return false if one of the allocations failed.
+   */
+  bool ok() {
+    return m_ok;
+  }
+
+  /** Compare the regions allocated with the partition table found on the
+      EEPROM, erase the regions which changed and store the new table.
+      Nothing is done if an allocation failed.
+      @return           number of regions erased (0 if the layout did not
+                        change)
+   */
+  uint8_t mount();
+
+  /** Return true if mount() erased a region.
+      @param region     index of the region, in allocation order
+   */
+  bool changed(uint8_t region) {
+    return ( m_changed >> region ) & 1;
+  }
+
+  /** Return the number of regions allocated.
+   */
+  uint8_t regions() {
+    return m_header.count;
+  }
+
+  /** Return the address following the last region.
+   */
+  uint16_t end() {
+    return m_next;
+  }
+
+  /** Return the space left after the last region.
+   */
+  uint16_t available() {
+    return m_end - m_next;
+  }
+
+  /** Round an address up to a page boundary. */
+  static constexpr uint16_t alignUp(uint16_t addr, uint16_t pageSize) {
+    return (addr + pageSize - 1) / pageSize * pageSize;
+  }
+
+  /** Address of the first region of a partition, usable at compile time. */
+  static constexpr uint16_t firstRegion(uint16_t startAddr, uint16_t pageSize) {
+    return alignUp(startAddr + sizeof(Header), pageSize);
+  }
+
+  /** Address of the region following a region, usable at compile time. */
+  static constexpr uint16_t nextRegion(uint16_t addr, uint16_t size, uint16_t pageSize) {
+    return alignUp(addr + size, pageSize);
+  }
+
+protected:
+  /** CRC of a partition table. */
+  static uint16_t headerCrc(const Header &header);
+
+  SafeEeprom &m_eeprom;         /** Device storing the data structures */
+  uint16_t m_startAddr;         /** Address of the partition table */
+  uint16_t m_end;               /** End of the partition */
+  uint16_t m_next;              /** Address of the next region */
+  uint16_t m_pageSize;
+  bool m_ok;                    /** All the allocations succeeded */
+  uint16_t m_changed;           /** Regions erased by mount() */
+  Header m_header;              /** Table of the regions allocated */
+
+private:
+  // prohibited...
+  EepromPartition(EepromPartition const&);
+  void operator=(EepromPartition const&);
+
+};
+
+#endif
@@ -0,0 +1,236 @@
+/**
+   EepromRing.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EepromRing_h
+#define EepromRing_h
+
+#include <stdlib.h>     // for exit
+
+#include "EnduranceEepromT.h"
+#include "EepromRingBuffer.h"
+
+/**
+   Ring buffer of N elements of type T stored on the EEPROM.
+
+   This is the typed counterpart of EepromRingBuffer: the element size,
+   the capacity and the endurance factor of the index are constants, so
+   the storage layout is known at compile time (STORAGE_SIZE) and checked
+   with static_assert against the size of the device when the Backend
+   gives it (see EepromCapacity).
+
+   The ring keeps the index of the last element (rather than its byte
+   offset) in RAM: with a power of two capacity it wraps with a mask,
+   otherwise with a compare, and none of the methods needs a division
+   except the constructor.
+
+   The device accessors are resolved at compile time with a concrete
+   Backend (see StaticEeprom). The EEPROM layout is the one of
+   EepromRingBuffer(ee, startAddr, N, sizeof(T), ENDURANCE), so both
+   classes can read the same buffer.
+
+   Documentation of the methods is provided by EepromRingBuffer.
+ */
+template <class T, uint16_t N, uint16_t ENDURANCE=1, class Backend=SafeEeprom>
+class EepromRing
+{
+public:
+  typedef EepromRingBuffer::Indexes Indexes;
+
+  /** Size of the index data structure on the EEPROM */
+  static constexpr uint16_t INDEX_SIZE =
+    EnduranceEepromBase::layoutSize(ENDURANCE, sizeof(Indexes));
+
+  /** Size of the buffer itself on the EEPROM */
+  static constexpr uint16_t LENGTH = N*sizeof(T);
+
+  /** Total storage size on the EEPROM */
+  static constexpr uint16_t STORAGE_SIZE = INDEX_SIZE + LENGTH;
+
+  static_assert(N > 1, "EepromRing needs at least 2 elements");
+  static_assert((uint32_t)N*sizeof(T) + INDEX_SIZE <= 0xFFFF,
+                "EepromRing does not fit in the 16 bits address space");
+  static_assert(EepromCapacity<Backend>::value == 0 ||
+                (uint32_t)N*sizeof(T) + INDEX_SIZE <= EepromCapacity<Backend>::value,
+                "EepromRing is larger than the EEPROM");
+
+  EepromRing(Backend &ee, uint16_t startAddr);
+
+  void push(const T &data);
+
+  void pushMany(const T *samples, uint16_t count);
+
+  void rotate(uint16_t steps);
+
+  void get(int index, T &data);
+
+  void clear();
+
+  static constexpr uint16_t storageSize() {
+    return STORAGE_SIZE;
+  }
+
+  static constexpr uint16_t bufferSize() {
+    return N;
+  }
+
+  uint16_t currentIndex() {
+    return m_last;
+  }
+
+  uint16_t startAddr() {
+    return m_bufferStart - INDEX_SIZE;
+  }
+
+protected:
+  typedef StaticEeprom<Backend> EE;
+
+  static constexpr bool POWER_OF_TWO = ( N & (N-1) ) == 0;
+
+  /** Return the element index i (below 2N) wrapped in the ring. */
+  static uint16_t wrap(uint16_t i) {
+    if ( POWER_OF_TWO ) return i & (N-1);
+    return ( i >= N ) ? i-N : i;
+  }
+
+  /** Write the index of the last element to the EEPROM. */
+  void saveIndex();
+
+  Backend &m_eeprom;                        /** Device storing the ring buffer */
+  EnduranceEepromT<Backend> m_eepromIndex;
+  uint16_t m_bufferStart;                   /** Start of the the Ring Buffer */
+  uint16_t m_last;                          /** Index of the last element */
+
+};
+
+/** Name of EepromRing with the Backend first. */
+template <class Backend, class T, uint16_t N, uint16_t ENDURANCE=1>
+using RingBufferT = EepromRing<T, N, ENDURANCE, Backend>;
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+EepromRing<T, N, ENDURANCE, Backend>::EepromRing(Backend &ee, uint16_t startAddr)
+  : m_eeprom(ee),
+    m_eepromIndex(ee, startAddr, ENDURANCE, sizeof(Indexes)),
+    m_bufferStart(startAddr + INDEX_SIZE)
+{
+  // Check if there is enough EEPROM
+  if ( startAddr + STORAGE_SIZE > EE::memSize(m_eeprom) ) {
+    exit(-1);
+  }
+
+  Indexes index;
+  m_eepromIndex.readData((void *)&index);
+
+  if ( 0xFFFF == index.last ) {
+    // This buffer never existed before. Let's initialize it
+    clear();
+  }
+  else {
+    m_last = wrap(index.last / sizeof(T));
+  }
+}
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+void EepromRing<T, N, ENDURANCE, Backend>::push(const T &data)
+{
+  m_last = wrap(m_last+1);
+  EE::write_block(m_eeprom, m_bufferStart+m_last*sizeof(T), (void *)&data, sizeof(T));
+  saveIndex();
+}
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+void EepromRing<T, N, ENDURANCE, Backend>::pushMany(const T *samples, uint16_t count)
+{
+  if ( count == 0 ) return;
+  if ( count > N ) {
+    // the oldest samples would be overwritten by the batch itself:
+    // skip them, but keep the position they would have moved to
+    samples += count-N;
+    m_last = wrap(m_last + (count-N) % N);
+    count = N;
+  }
+  uint16_t first = wrap(m_last+1);
+  uint16_t tail = N-first;
+  if ( count <= tail ) {
+    EE::write_block(m_eeprom, m_bufferStart+first*sizeof(T), (void *)samples, count*sizeof(T));
+  }
+  else {
+    EE::write_block(m_eeprom, m_bufferStart+first*sizeof(T), (void *)samples, tail*sizeof(T));
+    EE::write_block(m_eeprom, m_bufferStart, (void *)(samples+tail), (count-tail)*sizeof(T));
+  }
+  m_last = wrap(m_last+count);
+  saveIndex();
+}
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+void EepromRing<T, N, ENDURANCE, Backend>::get(int index, T &data)
+{
+  uint16_t element;
+  if ( POWER_OF_TWO ) {
+    // two's complement: also right for the negative indexes
+    element = (uint16_t)(m_last - (uint16_t)index) & (N-1);
+  }
+  else if ( index < 0 ) {
+    element = wrap(m_last + (uint16_t)(-index) % N);
+  }
+  else {
+    element = wrap(m_last + N - (uint16_t)index % N);
+  }
+  EE::read_block(m_eeprom, m_bufferStart+element*sizeof(T), (void *)&data, sizeof(T));
+}
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+void EepromRing<T, N, ENDURANCE, Backend>::rotate(uint16_t steps)
+{
+  if ( steps < N ) {
+    // erase the skipped elements, in two parts if they wrap around
+    uint16_t first = wrap(m_last+1);
+    uint16_t tail = N-first;
+    if ( steps <= tail ) {
+      EE::fill(m_eeprom, m_bufferStart+first*sizeof(T), 0xFF, steps*sizeof(T));
+    }
+    else {
+      EE::fill(m_eeprom, m_bufferStart+first*sizeof(T), 0xFF, tail*sizeof(T));
+      EE::fill(m_eeprom, m_bufferStart, 0xFF, (steps-tail)*sizeof(T));
+    }
+    m_last = wrap(m_last+steps);
+    saveIndex();
+  }
+  else {
+    clear();
+  }
+}
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+void EepromRing<T, N, ENDURANCE, Backend>::clear()
+{
+  EE::fill(m_eeprom, m_bufferStart, 0xFF, LENGTH);
+  m_last = 0;
+  saveIndex();
+}
+
+template <class T, uint16_t N, uint16_t ENDURANCE, class Backend>
+void EepromRing<T, N, ENDURANCE, Backend>::saveIndex()
+{
+  // byte offset, as stored by EepromRingBuffer
+  Indexes index;
+  index.last = m_last*sizeof(T);
+  index.start = 0xFFFF;
+  m_eepromIndex.writeData((void *)&index);
+}
+
+#endif
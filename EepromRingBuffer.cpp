@@ -20,28 +20,44 @@
 
 #include "SafeEeprom.h"
 
+#include <string.h>     // for memset
+
 #ifdef SERIAL_DEBUG
 #include "HardwareSerial.h"
 #endif
 
 #include <stdlib.h>     // for exit
 
-EepromRingBuffer::EepromRingBuffer(uint16_t startAddr,
+EepromRingBuffer::EepromRingBuffer(SafeEeprom &ee,
+                                   uint16_t startAddr,
                                    uint16_t bufferSize,
                                    size_t dataSize,
-                                   uint16_t indexEndurance)
-  : m_eepromIndex(startAddr, indexEndurance, sizeof(Indexes)),
+                                   uint16_t indexEndurance,
+                                   bool gapMarker)
+  : m_eeprom(ee),
+    m_eepromIndex(ee, startAddr, indexEndurance,
+                  gapMarker ? sizeof(GapIndexes) : sizeof(Indexes)),
     m_bufferLength(bufferSize*dataSize),
-    m_dataSize(dataSize)
+    m_dataSize(dataSize),
+    m_gap(0),
+    m_gapMarker(gapMarker)
 {
   m_bufferStart = startAddr + m_eepromIndex.storageSize();
 
   // Check if there is enough EEPROM
-  if ( startAddr + storageSize() > (E2END+1) ) {
+  if ( startAddr + storageSize() > m_eeprom.memSize() ) {
     exit(-1);
   }
 
-  m_eepromIndex.readData((void *)&m_ramIndex);
+  if ( m_gapMarker ) {
+    GapIndexes index;
+    m_eepromIndex.readData((void *)&index);
+    m_ramIndex = index.index;
+    m_gap = index.gap;
+  }
+  else {
+    m_eepromIndex.readData((void *)&m_ramIndex);
+  }
 
   if ( 0xFFFF == m_ramIndex.last ) {
     // This buffer never existed before. Let's initialize it
@@ -62,8 +78,50 @@ void EepromRingBuffer::push(void *data)
   Serial.print(" -> New byte index = ");
   Serial.println(m_ramIndex.last, DEC);
 #endif
-  SafeEeprom::write_block(m_bufferStart+m_ramIndex.last, data, m_dataSize);
-  m_eepromIndex.writeData((void *)&m_ramIndex);
+  m_eeprom.write_block(m_bufferStart+m_ramIndex.last, data, m_dataSize);
+  if ( m_gap > 0 && m_ramIndex.last == m_ramIndex.start ) {
+    // the oldest skipped element is replaced
+    m_ramIndex.start = (m_ramIndex.start+m_dataSize) % m_bufferLength;
+    m_gap--;
+  }
+  saveIndex();
+}
+
+void EepromRingBuffer::pushMany(const void *samples, uint16_t count)
+{
+  if ( count == 0 ) return;
+  const uint8_t *src = (const uint8_t *)samples;
+  uint16_t size = bufferSize();
+  if ( count > size ) {
+    // the oldest samples would be overwritten by the batch itself:
+    // skip them, but keep the position they would have moved to
+    src += (count-size)*m_dataSize;
+    m_ramIndex.last = (m_ramIndex.last + ((count-size) % size)*m_dataSize) % m_bufferLength;
+    count = size;
+    m_gap = 0;
+  }
+  uint16_t first = (m_ramIndex.last+m_dataSize) % m_bufferLength;
+  uint16_t len = count*m_dataSize;
+  if ( m_gap > 0 ) {
+    // the batch replaces the oldest elements, so the first skipped ones
+    uint16_t from = age(m_ramIndex.start);
+    if ( from < len ) {
+      uint16_t replaced = len-from;
+      if ( replaced > m_gap*m_dataSize ) replaced = m_gap*m_dataSize;
+      m_ramIndex.start = (m_ramIndex.start+replaced) % m_bufferLength;
+      m_gap -= replaced/m_dataSize;
+    }
+  }
+  uint16_t tail = m_bufferLength-first;
+  if ( len <= tail ) {
+    m_eeprom.write_block(m_bufferStart+first, (void *)src, len);
+  }
+  else {
+    m_eeprom.write_block(m_bufferStart+first, (void *)src, tail);
+    m_eeprom.write_block(m_bufferStart, (void *)(src+tail), len-tail);
+  }
+  m_ramIndex.last = (first+len-m_dataSize) % m_bufferLength;
+  saveIndex();
 }
 
 void EepromRingBuffer::get(int index, void *data)
@@ -72,6 +130,50 @@ void EepromRingBuffer::get(int index, void *data)
   Serial.print("-- get index=");
   Serial.print(index, DEC);
 #endif
+  uint16_t byteIndex = offset(index);
+#ifdef SERIAL_DEBUG
+  Serial.print(" -> byte index=");
+  Serial.print(byteIndex, DEC);
+  Serial.print(" :: ");
+#endif
+  if ( skipped(byteIndex) ) {
+    memset(data, 0xFF, m_dataSize);
+  }
+  else {
+    m_eeprom.read_block(m_bufferStart+byteIndex, data, m_dataSize);
+  }
+}
+
+void EepromRingBuffer::getRange(int from, uint16_t count, void *out)
+{
+  if ( count == 0 ) return;
+  if ( count > bufferSize() ) count = bufferSize();
+  // the oldest element first, then increasing addresses
+  uint16_t first = offset(from);
+  uint16_t len = count*m_dataSize;
+  first = ( first+m_dataSize >= len ) ?
+    first+m_dataSize-len : first+m_dataSize+m_bufferLength-len;
+  uint16_t tail = m_bufferLength-first;
+  uint8_t *dst = (uint8_t *)out;
+  if ( len <= tail ) {
+    m_eeprom.read_block(m_bufferStart+first, dst, len);
+  }
+  else {
+    m_eeprom.read_block(m_bufferStart+first, dst, tail);
+    m_eeprom.read_block(m_bufferStart, dst+tail, len-tail);
+  }
+  if ( m_gap > 0 ) {
+    // replace the stale content of the skipped elements
+    for (uint16_t i=0; i<len; i+=m_dataSize) {
+      if ( skipped(first) ) memset(dst+i, 0xFF, m_dataSize);
+      first += m_dataSize;
+      if ( first >= m_bufferLength ) first = 0;
+    }
+  }
+}
+
+uint16_t EepromRingBuffer::offset(int index)
+{
   // The if statment for positive and negative values of the index
   // seems necessary because the module function did not generate
   // the desired values for negative numbers!
@@ -85,12 +187,76 @@ void EepromRingBuffer::get(int index, void *data)
     index = m_ramIndex.last - index;
     if ( index < 0 ) index += m_bufferLength;
   }
-#ifdef SERIAL_DEBUG
-  Serial.print(" -> byte index=");
-  Serial.print(index, DEC);
-  Serial.print(" :: ");
-#endif
-  SafeEeprom::read_block(m_bufferStart+index, data, m_dataSize);
+  return index;
+}
+
+uint16_t EepromRingBuffer::age(uint16_t offset)
+{
+  uint16_t oldest = (m_ramIndex.last+m_dataSize) % m_bufferLength;
+  return ( offset >= oldest ) ? offset-oldest : offset+m_bufferLength-oldest;
+}
+
+void EepromRingBuffer::erase(uint16_t first, uint16_t len)
+{
+  uint16_t tail = m_bufferLength-first;
+  if ( len <= tail ) {
+    m_eeprom.erase(m_bufferStart+first, len);
+  }
+  else {
+    m_eeprom.erase(m_bufferStart+first, tail);
+    m_eeprom.erase(m_bufferStart, len-tail);
+  }
+}
+
+void EepromRingBuffer::saveIndex()
+{
+  if ( m_gapMarker ) {
+    GapIndexes index;
+    index.index = m_ramIndex;
+    index.gap = m_gap;
+    m_eepromIndex.writeData((void *)&index);
+  }
+  else {
+    m_eepromIndex.writeData((void *)&m_ramIndex);
+  }
+}
+
+EepromRingBuffer::Iterator::Iterator(EepromRingBuffer &ring, bool reverse) :
+  m_ring(ring),
+  m_reverse(reverse),
+  m_size(ring.bufferSize()),
+  m_remaining(m_size),
+  m_index(0)
+{
+  // newest element, or the oldest one just after it
+  m_offset = ring.m_ramIndex.last;
+  if ( ! reverse ) {
+    m_offset += ring.m_dataSize;
+    if ( m_offset >= ring.m_bufferLength ) m_offset = 0;
+  }
+}
+
+bool EepromRingBuffer::Iterator::next(void *data)
+{
+  if ( m_remaining == 0 ) return false;
+  if ( m_ring.skipped(m_offset) ) {
+    memset(data, 0xFF, m_ring.m_dataSize);
+  }
+  else {
+    m_ring.m_eeprom.read_block(m_ring.m_bufferStart+m_offset, data, m_ring.m_dataSize);
+  }
+  m_remaining--;
+  if ( m_reverse ) {
+    m_index = m_size-1-m_remaining;
+    m_offset = ( m_offset == 0 ) ? m_ring.m_bufferLength-m_ring.m_dataSize
+      : m_offset-m_ring.m_dataSize;
+  }
+  else {
+    m_index = m_remaining;
+    m_offset += m_ring.m_dataSize;
+    if ( m_offset >= m_ring.m_bufferLength ) m_offset = 0;
+  }
+  return true;
 }
 
 void EepromRingBuffer::rotate(uint16_t steps)
@@ -101,33 +267,60 @@ void EepromRingBuffer::rotate(uint16_t steps)
   Serial.print(") : Current byte index = ");
   Serial.print(m_ramIndex.last, DEC);
 #endif
-  if ( steps < bufferSize() ) {
-    m_ramIndex.last += m_dataSize;
-    for (uint16_t i=0; i<steps*m_dataSize; i++) {
-      m_ramIndex.last = m_ramIndex.last % m_bufferLength;
-      SafeEeprom::write_byte(m_bufferStart+m_ramIndex.last, 0xFF);
-      m_ramIndex.last++;
+  if ( steps >= bufferSize() ) {
+    clear();
+    return;
+  }
+  uint16_t first = (m_ramIndex.last+m_dataSize) % m_bufferLength;
+  uint16_t len = steps*m_dataSize;
+  if ( ! m_gapMarker ) {
+    // erase the skipped elements
+    erase(first, len);
+  }
+  else if ( len > 0 ) {
+    // record the skipped elements, which are the oldest ones
+    uint16_t from = 0;
+    uint16_t to = 0;
+    if ( m_gap > 0 ) {
+      // part of the previous range not reused by the new one
+      from = age(m_ramIndex.start);
+      to = from + m_gap*m_dataSize;
+      if ( from < len ) from = len;
+    }
+    if ( from < to && to == m_bufferLength ) {
+      // the previous range ends with the last element: extend it
+      m_ramIndex.start = (first+from) % m_bufferLength;
+      m_gap = (to-from+len)/m_dataSize;
+    }
+    else {
+      if ( from < to ) {
+        // only one range is kept: erase the previous one
+        erase((first+from) % m_bufferLength, to-from);
+      }
+      m_ramIndex.start = first;
+      m_gap = steps;
     }
-    m_ramIndex.last -= m_dataSize;
-    m_ramIndex.last = m_ramIndex.last % m_bufferLength;
+  }
+  m_ramIndex.last = (m_ramIndex.last+len) % m_bufferLength;
 #ifdef SERIAL_DEBUG
-    Serial.print(" -> New byte index = ");
-    Serial.println(m_ramIndex.last, DEC);
+  Serial.print(" -> New byte index = ");
+  Serial.println(m_ramIndex.last, DEC);
 #endif
-    m_eepromIndex.writeData((void *)&m_ramIndex);
-  }
-  else {
-    clear();
-  }
+  saveIndex();
 }
 
 void EepromRingBuffer::clear()
 {
-  for (uint16_t i=0; i<m_bufferLength; i++) {
-    SafeEeprom::write_byte(m_bufferStart+i, 0xFF);
-  }
   m_ramIndex.last = 0;
-  m_eepromIndex.writeData((void *)&m_ramIndex);
+  if ( m_gapMarker ) {
+    // all the elements are skipped, from the oldest one
+    m_ramIndex.start = m_dataSize % m_bufferLength;
+    m_gap = bufferSize();
+  }
+  else {
+    m_eeprom.erase(m_bufferStart, m_bufferLength);
+  }
+  saveIndex();
 }
 
 uint16_t EepromRingBuffer::storageSize()
@@ -135,6 +328,11 @@ uint16_t EepromRingBuffer::storageSize()
   return m_eepromIndex.storageSize() + m_bufferLength;
 }
 
+uint16_t EepromRingBuffer::startAddr()
+{
+  return m_bufferStart - m_eepromIndex.storageSize();
+}
+
 uint16_t EepromRingBuffer::bufferSize()
 {
   return m_bufferLength / m_dataSize;
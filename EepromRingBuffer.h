@@ -35,10 +35,13 @@ class EepromRingBuffer
 {
 public:
   /** Create a ring buffer on the EEPROM.
+      @param ee             EEPROM to use
       @param startAddr      at which EEPROM address the data structure will start
       @param bufferSize     desired size of ring buffer
       @param dataSize       size of the each element to store
       @param indexEndurance endurance factor to use for the ring buffer index
+      @param gapMarker      record the elements skipped by rotate() and
+                            clear() in the index instead of erasing them
 
       @note Every new data push in the ring buffer will trigger a EEPROM
       write. By the nature itself of the ring buffer, the write will be
@@ -48,21 +51,42 @@ public:
       loss. The index is updated at each write. Thus if indexEndurance is
       bigger than one, an EnduranceEeprom data structure will be used to
       maintain the index.
+
+      @note In gap marker mode, rotate() and clear() do not write the
+      buffer: the range of skipped elements is kept with the index, and
+      get(), getRange() and the Iterator return 0xFF for them. Only one
+      range is kept: a rotate() while the previous range is still in the
+      buffer (and not just before the new one) erases it as before. The
+      index is larger in this mode, so the mode is part of the layout.
   */
-  EepromRingBuffer(uint16_t startAddr, uint16_t bufferSize, size_t dataSize,
-                   uint16_t indexEndurance=1);
+  EepromRingBuffer(SafeEeprom &ee, uint16_t startAddr, uint16_t bufferSize,
+                   size_t dataSize, uint16_t indexEndurance=1,
+                   bool gapMarker=false);
 
   /** Push a new data sample in the buffer.
       @param data        pointer to the the data to be copied to the EEPROM buffer
   */
   void push(void *data);
 
+  /** Push several data samples in the buffer at once.
+
+      The samples are written with at most two block writes (when they
+      wrap around the end of the buffer), and the index is written once
+      for the whole batch rather than once per sample. If count is larger
+      than the buffer size, only the last bufferSize() samples are kept.
+
+      @param samples     pointer to count contiguous data samples
+      @param count       number of samples to push
+  */
+  void pushMany(const void *samples, uint16_t count);
+
   /** Rotate the ring buffer by *steps* elements.
 
       This methods increment the ring buffer last element by steps, and
       also mark all the skipped elements with 0xFF. After the rotate, the
       ring buffer index point to the element with only 0xFF that rotate
-      created.
+      created. In gap marker mode, the skipped elements are only recorded
+      in the index (see the constructor).
 
       @param steps      number of single element rotation to perform
    */
@@ -88,13 +112,67 @@ public:
    */
   void get(int index, void *data);
 
+  /** Read several consecutive elements of the ring buffer at once.
+
+      The elements index from+count-1 (the oldest) up to index from (the
+      newest) are copied to out in chronological order: out receives
+      get(from+count-1) first and get(from) last. The elements are
+      contiguous on the EEPROM, so they are read with at most two block
+      reads (when they wrap around the end of the buffer).
+
+      @param from       index of the newest element to read (see get)
+      @param count      number of elements to read, up to bufferSize()
+      @param out        pointer to a location for count elements
+   */
+  void getRange(int from, uint16_t count, void *out);
+
+  /**
+     Sequential access to the elements of a ring buffer.
+
+     The iterator visits all the elements of the buffer once, from the
+     oldest to the newest (forward) or from the newest to the oldest
+     (reverse), stepping its EEPROM address without the modulo arithmetic
+     of get().
+   */
+  class Iterator
+  {
+  public:
+    /** Start an iteration.
+        @param ring       ring buffer to read
+        @param reverse    true to start with the newest element
+     */
+    Iterator(EepromRingBuffer &ring, bool reverse=false);
+
+    /** Read the next element.
+        @param data       pointer to a location where to store the data read
+        @return           false when all the elements were visited
+     */
+    bool next(void *data);
+
+    /** Return the index (see get) of the element returned by next().
+     */
+    uint16_t index() {
+      return m_index;
+    }
+
+  protected:
+    EepromRingBuffer &m_ring;
+    bool m_reverse;
+    uint16_t m_offset;            /** Byte offset of the next element */
+    uint16_t m_size;              /** Number of elements of the ring */
+    uint16_t m_remaining;         /** Number of elements still to visit */
+    uint16_t m_index;
+  };
+
   /** Clears completely the ring buffer.
 
       This methods writes 0xFF to all the EEPROM bytes used by the ring
-      buffer. The EEPROM area used to store the endurance indexes are not
-      cleared, but the last element is assigned to the first memory
-      address of the ring buffer (not a significant things from the user
-      point of view).
+      buffer (bytes already cleared are not programmed again). The
+      EEPROM area used to store the endurance indexes are not cleared,
+      but the last element is assigned to the first memory address of
+      the ring buffer (not a significant things from the user point of
+      view). In gap marker mode, the whole buffer is recorded as skipped
+      instead, and only the index is written.
    */
   void clear();
 
@@ -107,6 +185,21 @@ public:
    */
   uint16_t storageSize();
 
+  /** Returns the address of the ring buffer structure on the EEPROM.
+   */
+  uint16_t startAddr();
+
+  /** Returns the storage size of a ring buffer, usable at compile time
+      (see the constructor for the parameters).
+   */
+  static constexpr uint16_t layoutSize(uint16_t bufferSize, size_t dataSize,
+                                       uint16_t indexEndurance=1,
+                                       bool gapMarker=false) {
+    return EnduranceEepromBase::layoutSize(indexEndurance, gapMarker ?
+                                           sizeof(GapIndexes) : sizeof(Indexes))
+      + bufferSize*dataSize;
+  }
+
   /** Returns the size of the buffer in element unit.
 
       @note This method require one division. The trade-off here is that we
@@ -118,13 +211,27 @@ public:
 
   uint16_t currentIndex();
 
+  /** Returns the size of one element in bytes.
+   */
+  uint16_t dataSize() {
+    return m_dataSize;
+  }
+
   /** Structure to maintain the ring buffer indexes */
   struct Indexes {
     uint16_t last;  /** Index of the last element inserted in the ring buffer */
-    uint16_t start; /** Extra index, not used currently. Just pad the 4 bytes. */
+    uint16_t start; /** Extra index: byte offset of the first skipped
+                        element in gap marker mode, otherwise not used */
+  };
+
+  /** Index stored in gap marker mode */
+  struct GapIndexes {
+    Indexes index;
+    uint16_t gap;   /** Number of skipped elements from index.start */
   };
 
 protected:
+  SafeEeprom &m_eeprom;             /** Device storing the ring buffer */
   EnduranceEeprom m_eepromIndex;
   uint16_t m_bufferLength;          /** Store the total length of the buffer:
                                         ring buffer size * data size */
@@ -132,7 +239,30 @@ protected:
 
   Indexes m_ramIndex;
 
+  /** Return the byte offset in the buffer of the element index (see get). */
+  uint16_t offset(int index);
+
+  /** Return true if the element at the byte offset is in the skipped range. */
+  bool skipped(uint16_t offset) {
+    if ( m_gap == 0 ) return false;
+    uint16_t rel = ( offset >= m_ramIndex.start ) ? offset-m_ramIndex.start
+      : offset+m_bufferLength-m_ramIndex.start;
+    return rel < m_gap*m_dataSize;
+  }
+
+  /** Return the byte distance of an offset from the oldest element. */
+  uint16_t age(uint16_t offset);
+
+  /** Erase len bytes of the buffer from the byte offset first, in two
+      parts if they wrap around. */
+  void erase(uint16_t first, uint16_t len);
+
+  /** Write the index (and the skipped range) to the EEPROM. */
+  void saveIndex();
+
   uint16_t m_bufferStart;           /** Start of the the Ring Buffer */
+  uint16_t m_gap;                   /** Number of skipped elements from m_ramIndex.start */
+  bool m_gapMarker;
 
 };
 
@@ -0,0 +1,80 @@
+/**
+   EepromWriteQueue.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "EepromWriteQueue.h"
+
+#define QUEUE_MASK (EEPROM_QUEUE_SIZE-1)
+
+// keep the accesses to the entries on their side of the index updates
+#define COMPILER_BARRIER() asm volatile("" ::: "memory")
+
+EepromWriteQueue::EepromWriteQueue() :
+  m_head(0),
+  m_tail(0)
+{
+}
+
+bool EepromWriteQueue::push(uint16_t addr, uint8_t data)
+{
+  uint8_t tail = m_tail;
+  if ( (uint8_t)(tail - m_head) >= EEPROM_QUEUE_SIZE ) return false;
+  m_entries[tail & QUEUE_MASK].addr = addr;
+  m_entries[tail & QUEUE_MASK].data = data;
+  // publish the entry only once it is complete
+  COMPILER_BARRIER();
+  m_tail = tail+1;
+  return true;
+}
+
+bool EepromWriteQueue::pop(uint16_t &addr, uint8_t &data)
+{
+  uint8_t head = m_head;
+  if ( head == m_tail ) return false;
+  // read the entry only once it is published
+  COMPILER_BARRIER();
+  addr = m_entries[head & QUEUE_MASK].addr;
+  data = m_entries[head & QUEUE_MASK].data;
+  // free the entry only once it is read
+  COMPILER_BARRIER();
+  m_head = head+1;
+  return true;
+}
+
+bool EepromWriteQueue::lookup(uint16_t addr, uint8_t &data)
+{
+  // newest first, so the last value queued wins
+  uint8_t head = m_head;
+  for (uint8_t i=m_tail; i!=head; i--) {
+    const Entry &e = m_entries[(uint8_t)(i-1) & QUEUE_MASK];
+    if ( e.addr == addr ) {
+      data = e.data;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t EepromWriteQueue::pending()
+{
+  return m_tail - m_head;
+}
+
+bool EepromWriteQueue::full()
+{
+  return pending() >= EEPROM_QUEUE_SIZE;
+}
@@ -0,0 +1,261 @@
+/**
+   EepromWriteQueue.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EepromWriteQueue_h
+#define EepromWriteQueue_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of byte writes the queue can hold (power of two, up to 128).
+    A TimePermRingBuffer::insert() queues 16 bytes besides the sample
+    (time stamp and index, each with its endurance status): the default
+    holds an insert of a sample up to 16 bytes without blocking, for 3
+    bytes of RAM per entry on the AVR. */
+#ifndef EEPROM_QUEUE_SIZE
+#define EEPROM_QUEUE_SIZE 32
+#endif
+
+#if ( EEPROM_QUEUE_SIZE & (EEPROM_QUEUE_SIZE-1) ) || EEPROM_QUEUE_SIZE > 128
+#error "EEPROM_QUEUE_SIZE must be a power of two, up to 128"
+#endif
+
+/**
+   Bounded queue of pending EEPROM byte writes.
+
+   The queue has a single producer (the main program queuing the writes)
+   and a single consumer (the EEPROM ready interrupt programming them one
+   by one), so it does not need to disable the interrupts: each side only
+   modifies its own 8 bits index, which is written atomically by the AVR.
+
+   lookup() gives the value most recently queued for an address, so reads
+   can see the writes not yet programmed (read-your-writes consistency).
+ */
+class EepromWriteQueue
+{
+public:
+  EepromWriteQueue();
+
+  /** Queue a byte write (main program side).
+      @param addr       address of the byte
+      @param data       value to program
+      @return           false if the queue is full
+  */
+  bool push(uint16_t addr, uint8_t data);
+
+  /** Remove the oldest byte write (interrupt side).
+      @param addr       receive the address of the byte
+      @param data       receive the value to program
+      @return           false if the queue is empty
+  */
+  bool pop(uint16_t &addr, uint8_t &data);
+
+  /** Find the value most recently queued for an address.
+      @param addr       address of the byte
+      @param data       receive the queued value, if any
+      @return           true if a write to addr is pending
+  */
+  bool lookup(uint16_t addr, uint8_t &data);
+
+  /** Return the number of pending byte writes.
+   */
+  uint8_t pending();
+
+  /** Return true if no more writes can be queued.
+   */
+  bool full();
+
+protected:
+  struct Entry {
+    uint16_t addr;
+    uint8_t data;
+  };
+
+  Entry m_entries[EEPROM_QUEUE_SIZE];
+  volatile uint8_t m_head;      /** Free running index of the next pop */
+  volatile uint8_t m_tail;      /** Free running index of the next push */
+
+};
+
+/**
+   Non blocking writes to an EEPROM programming one byte at a time, and
+   signaling the end of each program with an interrupt.
+
+   The writes are queued in an EepromWriteQueue by the main program, and
+   programmed by onReady(), to be called by the ready interrupt. The
+   queued bytes already holding their value are skipped. The reads look
+   at the queued writes first.
+
+   The device is accessed through the Port, which provides:
+     - uint8_t read(uint16_t addr): read a byte, the device being ready
+     - void readBlock(uint16_t addr, uint8_t *dst, size_t len): same for
+       a block
+     - void program(uint16_t addr, uint8_t current, uint8_t data): start
+       programming a byte currently holding current
+     - void waitReady(): wait for the end of the current program
+     - bool readyEnabled(), void enableReady(), void disableReady():
+       state of the ready interrupt
+     - void waitQueue(): called while the main program waits for the
+       interrupt to free an entry of the queue
+
+   The main program only masks the ready interrupt (never the global
+   interrupts) while it looks at the queue or reads the device.
+ */
+template <class Port>
+class EepromAsyncWriter
+{
+public:
+  EepromAsyncWriter(Port &port) :
+    m_port(port),
+    m_skipped(0) {
+  }
+
+  /** Queue the bytes of a block, waiting while the queue is full.
+      @param update     skip the bytes already holding their value (when
+                        queued, otherwise when programmed)
+   */
+  void queue(uint16_t addr, const uint8_t *src, size_t len, bool update);
+
+  /** Read a byte, looking at the queued writes first.
+   */
+  uint8_t fetch(uint16_t addr);
+
+  /** Read a block, looking at the queued writes first.
+   */
+  void fetchBlock(uint16_t addr, uint8_t *dst, size_t len);
+
+  /** Wait until all the queued writes are programmed.
+   */
+  void flush();
+
+  /** Program the next queued byte. Called by the ready interrupt only.
+   */
+  void onReady();
+
+  /** Return the number of byte writes waiting in the queue.
+   */
+  uint8_t pending() {
+    return m_queue.pending();
+  }
+
+  /** Return the number of queued bytes skipped because the EEPROM
+      already held the value.
+   */
+  uint32_t skipped();
+
+protected:
+  Port &m_port;
+  EepromWriteQueue m_queue;
+  volatile uint32_t m_skipped;  /** Also incremented by the interrupt */
+
+};
+
+template <class Port>
+void EepromAsyncWriter<Port>::queue(uint16_t addr, const uint8_t *src, size_t len,
+                                    bool update)
+{
+  for (size_t i=0; i<len; i++) {
+    if ( update ) {
+      // only the queue is looked at: waiting for the device to read it
+      // would block for a program per byte. The bytes whose device value
+      // is unchanged are skipped by onReady().
+      uint8_t queued;
+      bool enabled = m_port.readyEnabled();
+      m_port.disableReady();
+      bool same = m_queue.lookup(addr+i, queued) && queued == src[i];
+      if ( same ) m_skipped++;
+      if ( enabled ) m_port.enableReady();
+      if ( same ) continue;
+    }
+    while ( ! m_queue.push(addr+i, src[i]) ) {
+      // full: wait for the interrupt to program the oldest byte
+      m_port.waitQueue();
+    }
+    m_port.enableReady();
+  }
+}
+
+template <class Port>
+uint8_t EepromAsyncWriter<Port>::fetch(uint16_t addr)
+{
+  uint8_t data;
+  bool enabled = m_port.readyEnabled();
+  // the interrupt must not pop the queue nor start a program during the
+  // read: mask it, then wait for the byte it may be programming
+  m_port.disableReady();
+  m_port.waitReady();
+  if ( ! m_queue.lookup(addr, data) ) {
+    data = m_port.read(addr);
+  }
+  if ( enabled ) m_port.enableReady();
+  return data;
+}
+
+template <class Port>
+void EepromAsyncWriter<Port>::fetchBlock(uint16_t addr, uint8_t *dst, size_t len)
+{
+  if ( ! m_queue.pending() ) {
+    // with an empty queue, the interrupt does not start any program
+    m_port.waitReady();
+    m_port.readBlock(addr, dst, len);
+    return;
+  }
+  for (size_t i=0; i<len; i++) {
+    dst[i] = fetch(addr+i);
+  }
+}
+
+template <class Port>
+void EepromAsyncWriter<Port>::flush()
+{
+  while ( m_queue.pending() ) {
+    // drained by the interrupt
+    m_port.waitQueue();
+  }
+  m_port.waitReady();
+}
+
+template <class Port>
+void EepromAsyncWriter<Port>::onReady()
+{
+  uint16_t addr;
+  uint8_t data;
+  // skip the queued bytes already holding their value
+  while ( m_queue.pop(addr, data) ) {
+    uint8_t current = m_port.read(addr);
+    if ( current != data ) {
+      m_port.program(addr, current, data);
+      return;
+    }
+    m_skipped++;
+  }
+  // queue empty: stop the interrupt until the next write
+  m_port.disableReady();
+}
+
+template <class Port>
+uint32_t EepromAsyncWriter<Port>::skipped()
+{
+  bool enabled = m_port.readyEnabled();
+  m_port.disableReady();
+  uint32_t count = m_skipped;
+  if ( enabled ) m_port.enableReady();
+  return count;
+}
+
+#endif
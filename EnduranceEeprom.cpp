@@ -18,140 +18,106 @@
 */
 #include "EnduranceEeprom.h"
 
-#include <avr/eeprom.h>
-#include <util/crc16.h>
+template class EnduranceEepromT<SafeEeprom>;
 
-#include "SafeEeprom.h"
-
-#ifdef SERIAL_DEBUG
-#include <HardwareSerial.h>
-#endif
-
-#include <stdlib.h>     // for exit
-
-EnduranceEeprom::EnduranceEeprom(SafeEeprom &eeprom, uint16_t startAddr, uint16_t endurFactor, size_t dataSize) :
-  m_eeprom(eeprom),
-  m_statusAddr(startAddr),
-  m_endurFactor(endurFactor),
-  m_dataSize(dataSize)
+/** Round len up to a multiple of the page size. */
+static uint32_t roundUp(uint32_t len, uint16_t pageSize)
 {
-  if ( m_endurFactor > 1 ) {
-    // Check if there is enough memory from the start address
-    if ( (startAddr+storageSize()) > (1+E2END) ) {
-      exit(-1);
-    }
-#ifdef SERIAL_DEBUG
-    if ( ( dataSize % E2PAGESIZE ) != 0 ) {
-      Serial.println("EnduranceEeprom Warning: dataSize is not a multiple of the page size -> non optimal endurance!");
-    }
-#endif
-    m_dataAddr = m_statusAddr+m_endurFactor*sizeof(Status);
-    bool found = findCurrent();
-    if ( ! found ) {
-      // This area of memory has never been used for this circular buffer
-      m_status.index = 1;
-      for ( uint16_t i=0; i<m_dataSize; i++) {
-        m_eeprom.write_byte(m_dataAddr+i, 0xFF);
-      }
-      m_status.crc16 = memCrc16(m_dataAddr, m_dataSize);
-      m_eeprom.write_block(m_statusAddr, (void *)&m_status, sizeof(Status));
-    }
-    else {
-    }
-  }
-  else {
-    m_dataAddr = m_statusAddr;
-  }
+  return (len + pageSize - 1) / pageSize * pageSize;
 }
 
-void EnduranceEeprom::writeData(void *data)
+/** Return the number of pages covered by len bytes at addr. */
+static uint16_t pagesCovered(uint32_t addr, uint32_t len, uint16_t pageSize)
 {
-  if ( m_endurFactor > 1 ) {  
-    // m_status.index already point to the next element
-    // we wrap it here and keep it value for the 2 writes.
-    uint16_t index = m_status.index % m_endurFactor;
-    
-    // destination of the next data write
-    uint16_t addr = m_dataAddr+index*m_dataSize;
-    
-    // writing first the data
-    m_eeprom.write_block(addr, data, m_dataSize);
-    
-    // crc computation
-    m_status.crc16 = memCrc16(addr, m_dataSize);
-    
-    // we are incrementing our position (status data, not memory pointer)
-    m_status.index++;
-    
-    // writing last the new status: index + crc together
-    m_eeprom.write_block(m_statusAddr+index*sizeof(Status), (void *)&m_status, sizeof(Status));
-  }
-  else {
-    m_eeprom.write_block(m_dataAddr, data, m_dataSize);
-  }
+  return (addr + len - 1) / pageSize - addr / pageSize + 1;
 }
 
-bool EnduranceEeprom::readData(void *data)
+float EnduranceEepromBase::pagesPerWrite(const Layout &layout, uint16_t startAddr,
+                                         uint16_t endurFactor, size_t dataSize,
+                                         uint16_t pageSize)
 {
-  if ( m_endurFactor > 1 ) {  
-    uint16_t addr = m_dataAddr+((m_status.index-1)%m_endurFactor)*m_dataSize;
-    m_eeprom.read_block(addr, data, m_dataSize);
-    uint16_t crc = memCrc16(addr, m_dataSize);
-    if ( crc == m_status.crc16 ) return true; else return false;
-  }
-  else {
-    m_eeprom.read_block(m_dataAddr, data, m_dataSize);
-    return true;
+  uint32_t pages = 0;
+  for (uint16_t slot=0; slot<endurFactor; slot++) {
+    pages += pagesCovered(startAddr + layout.statusOffset + (uint32_t)slot*layout.statusStride,
+                          sizeof(Status), pageSize);
+    pages += pagesCovered(startAddr + layout.dataOffset + (uint32_t)slot*layout.dataStride,
+                          dataSize, pageSize);
   }
+  return (float)pages / endurFactor;
 }
 
-uint16_t EnduranceEeprom::storageSize()
+float EnduranceEepromBase::wearPerWrite(const Layout &layout, uint16_t startAddr,
+                                        uint16_t endurFactor, size_t dataSize,
+                                        uint16_t pageSize)
 {
-  if ( m_endurFactor > 1 ) {  
-    return m_endurFactor*(sizeof(Status)+m_dataSize);
-  }
-  else {
-    return m_dataSize;
+  // the slots are visited by increasing addresses: count the slots
+  // touching the same page in a row
+  uint32_t page = 0xFFFFFFFF;
+  uint16_t count = 0;
+  uint16_t worst = 0;
+  for (uint8_t data=0; data<2; data++) {
+    uint32_t offset = data ? layout.dataOffset : layout.statusOffset;
+    uint16_t stride = data ? layout.dataStride : layout.statusStride;
+    uint32_t len = data ? dataSize : sizeof(Status);
+    for (uint16_t slot=0; slot<endurFactor; slot++) {
+      uint32_t addr = startAddr + offset + (uint32_t)slot*stride;
+      for (uint32_t p=addr/pageSize; p<=(addr+len-1)/pageSize; p++) {
+        if ( p == page ) {
+          count++;
+        }
+        else {
+          page = p;
+          count = 1;
+        }
+        if ( count > worst ) worst = count;
+      }
+    }
   }
+  // each slot is written once every endurFactor writes
+  return (float)worst / endurFactor;
 }
 
-uint16_t EnduranceEeprom::memCrc16(uint16_t addr, size_t len)
+EnduranceEepromBase::Layout EnduranceEepromBase::planLayout(uint16_t startAddr,
+                                                            uint16_t endurFactor,
+                                                            size_t dataSize,
+                                                            uint16_t pageSize,
+                                                            uint16_t maxSize)
 {
-  uint16_t crc = 0xFFFF;
-  for (uint16_t i=0; i<len; i++) {
-    crc = _crc16_update(crc, m_eeprom.read_byte(addr++));
-  }
-  return crc;
-}
+  Layout best = packedLayout(endurFactor, dataSize);
+  if ( endurFactor < 2 || pageSize < 2 ) return best;
+  float bestPages = pagesPerWrite(best, startAddr, endurFactor, dataSize, pageSize);
+  float bestWear = wearPerWrite(best, startAddr, endurFactor, dataSize, pageSize);
+  uint16_t bestSize = layoutSize(best, endurFactor);
 
-bool EnduranceEeprom::findCurrent()
-{
-  bool found = false;
-  uint16_t addr = m_statusAddr;
-  uint16_t next;
-  Status ns;
-  // Iterate trhough the status buffer to find which was the last element
-  while ( addr < m_dataAddr && ! found ) {
-    next = addr + sizeof(Status);
-    if ( next == m_dataAddr ) { 
-      next = m_statusAddr;
-    }
-    m_eeprom.read_block(addr, (void *)&m_status, sizeof(Status));
-    m_eeprom.read_block(next, (void *)&ns, sizeof(Status));
-    if ( (ns.index-m_status.index) > 1 ) {
-      found = true; 
-    }
-    else {
-      addr += sizeof(Status);
+  // status slots packed, packed from a page boundary, or one per page;
+  // data slots packed or aligned on the pages
+  for (uint8_t status=0; status<3; status++) {
+    for (uint8_t data=0; data<2; data++) {
+      Layout layout;
+      uint32_t end;
+      layout.statusOffset = ( status > 0 ) ? roundUp(startAddr, pageSize) - startAddr : 0;
+      layout.statusStride = ( status == 2 ) ? roundUp(sizeof(Status), pageSize) : sizeof(Status);
+      end = layout.statusOffset + (uint32_t)endurFactor*layout.statusStride;
+      if ( data ) end = roundUp(startAddr + end, pageSize) - startAddr;
+      uint32_t stride = data ? roundUp(dataSize, pageSize) : dataSize;
+      uint32_t size = end + (uint32_t)endurFactor*stride;
+      if ( size > maxSize || (uint32_t)startAddr + size > 0xFFFF ) continue;
+      layout.dataOffset = end;
+      layout.dataStride = stride;
+
+      float pages = pagesPerWrite(layout, startAddr, endurFactor, dataSize, pageSize);
+      float wear = wearPerWrite(layout, startAddr, endurFactor, dataSize, pageSize);
+      bool better;
+      if ( pages != bestPages ) better = pages < bestPages;
+      else if ( wear != bestWear ) better = wear < bestWear;
+      else better = size < bestSize;
+      if ( better ) {
+        best = layout;
+        bestPages = pages;
+        bestWear = wear;
+        bestSize = size;
+      }
     }
   }
-  // Check CRC to make sure this value was correctly written 
-  uint16_t crc = memCrc16(m_dataAddr+((m_status.index-1)%m_endurFactor)*m_dataSize, m_dataSize);
-  if ( crc != m_status.crc16 ) {
-#ifdef SERIAL_DEBUG
-    Serial.println("EnduranceEeprom Warning: memory corruption detected!");
-#endif
-    // Not sure yet what to do in case of corrupted data...
-  }
-  return found;
+  return best;
 }
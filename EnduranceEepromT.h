@@ -0,0 +1,555 @@
+/**
+   EnduranceEepromT.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EnduranceEepromT_h
+#define EnduranceEepromT_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>     // for exit
+#include <string.h>     // for memcmp
+
+#include "StaticEeprom.h"
+#include "Crc16.h"
+
+#ifdef SERIAL_DEBUG
+#include <HardwareSerial.h>
+#endif
+
+/** Size of the blocks read back to verify the writes or compute a CRC. */
+#ifndef ENDURANCE_READ_CHUNK
+#define ENDURANCE_READ_CHUNK 16
+#endif
+
+/**
+   Types shared by all the EnduranceEepromT instances.
+ */
+class EnduranceEepromBase
+{
+public:
+
+  /** Strategy to find the current element of the status buffer at boot time.
+
+      The status indexes are written in sequence (each slot holds the
+      index of the previous slot plus one), except at the wrap point
+      where the most recent element is followed by the oldest one.
+
+      LINEAR_SCAN compares every pair of consecutive status, which
+      requires 2 reads per slot up to the wrap point: boot time grows
+      linearly with the endurance factor.
+
+      BINARY_SEARCH uses the sequence to locate the wrap point with a
+      bisection, requiring about log2(endurFactor) reads. Both strategies
+      find the same element as long as the status buffer was written by
+      EnduranceEeprom.
+  */
+  enum Recovery {
+    LINEAR_SCAN,
+    BINARY_SEARCH
+  };
+
+  /** Internal structure for the status buffer.
+      It is made public for others to evaluate the size of the structure.
+  */
+  struct Status {
+    uint16_t index;
+    uint16_t crc16;
+  };
+
+  /** Return the space required by an EnduranceEeprom data structure,
+      usable at compile time.
+      @param endurFactor    Endurance Factor: size of the circular buffer
+      @param dataSize       Size of the element to store
+   */
+  static constexpr uint16_t layoutSize(uint16_t endurFactor, size_t dataSize) {
+    return ( endurFactor > 1 ) ? endurFactor*(sizeof(Status)+dataSize) : dataSize;
+  }
+
+  /** Placement of the status and data slots, relative to the start
+      address of the data structure.
+
+      The packed layout puts all the status slots first, then all the
+      data slots, without any padding (layoutSize()). On devices
+      programming a page at once, padding the slots to the page
+      boundaries avoids the slots straddling two pages (two programs for
+      one write), and giving each status slot its own page spreads the
+      status writes over several pages: see planLayout().
+  */
+  struct Layout {
+    uint16_t statusOffset;      /** First status slot */
+    uint16_t statusStride;      /** Distance between two status slots */
+    uint16_t dataOffset;        /** First data slot */
+    uint16_t dataStride;        /** Distance between two data slots */
+  };
+
+  /** Return the packed layout (the one of layoutSize()). */
+  static constexpr Layout packedLayout(uint16_t endurFactor, size_t dataSize) {
+    return Layout { 0, sizeof(Status), (uint16_t)(endurFactor*sizeof(Status)),
+                    (uint16_t)dataSize };
+  }
+
+  /** Return the space required by a layout. */
+  static constexpr uint16_t layoutSize(const Layout &layout, uint16_t endurFactor) {
+    return layout.dataOffset + endurFactor*layout.dataStride;
+  }
+
+  /** Return the average number of pages programmed by a writeData
+      (status and data) with a layout.
+      @param startAddr      start address of the data structure
+      @param pageSize       size of the EEPROM page
+   */
+  static float pagesPerWrite(const Layout &layout, uint16_t startAddr,
+                             uint16_t endurFactor, size_t dataSize, uint16_t pageSize);
+
+  /** Return the programs endured by the most used page, per writeData. */
+  static float wearPerWrite(const Layout &layout, uint16_t startAddr,
+                            uint16_t endurFactor, size_t dataSize, uint16_t pageSize);
+
+  /** Choose the layout of a data structure for a page size.
+
+      The packed layout and the layouts aligning the data slots, or the
+      status slots, or both on the page boundaries, are compared. The
+      layout chosen programs the fewest pages per writeData, then wears
+      its most used page the least, then takes the least space.
+
+      @param startAddr      start address of the data structure
+      @param endurFactor    Endurance Factor: size of the circular buffer
+      @param dataSize       Size of the element to store
+      @param pageSize       size of the EEPROM page
+      @param maxSize        space available [default=no limit]
+      @return               the best layout fitting in maxSize (the
+                            packed one if none fits)
+   */
+  static Layout planLayout(uint16_t startAddr, uint16_t endurFactor, size_t dataSize,
+                           uint16_t pageSize, uint16_t maxSize=0xFFFF);
+
+};
+
+/**
+   EnduranceEepromT increases the number of data writes you can do in the
+   EEPROM by using a circular buffer to spread the data writes across the
+   memory.
+
+
+   Obviously, storing data to the EEPROM using EnduranceEeprom consume
+   much more data space. This is the trade-off to allow more data writes
+   than the number of cycles the EEPROM can support. Typically the AVR
+   chip will allow 100K writes. This can seems a lot, but imagine you need
+   to store a value every minute to the EEPROM, after 70 days of run-time
+   the EEPROM would be dead.
+
+
+   To keep track of the current address of the data in the circular buffer,
+   a second circular buffer for the status (of the same size than the data
+   buffer) is maintained on EEPROM. For more details on this technique:
+   http://www.atmel.com/dyn/resources/prod_documents/doc2526.pdf
+
+   The AVR implementation of the EEPROM writes always write a full PAGE
+   (usually 4 bytes), even if you perform a single byte write. Because of
+   this, there is no reason to use data space smaller than a PAGE size.
+
+   The implementation of the status buffer uses 4 bytes: 2 for the index
+   and 2 for a CRC16 (see Crc16). The CRC16 is computed from the data in RAM, so a
+   write does not read the data back from the EEPROM, unless the
+   verification is enabled with setVerify().
+
+   The device accessors are called through StaticEeprom<Backend>: with a
+   concrete Backend (for example EnduranceEepromT<AvrEeprom>) they are
+   resolved at compile time, while EnduranceEeprom (the SafeEeprom
+   instance) accepts any device at runtime. Both store the same layout.
+
+   A write is complete once its status is written. At boot time, a
+   current status which does not match the CRC of its data (the power
+   was lost while the status was written) is ignored, and the previous
+   status is used: readData() returns the data of the last complete
+   write.
+ */
+template <class Backend>
+class EnduranceEepromT : public EnduranceEepromBase
+{
+public:
+
+  /** Initialize a Endurance EEPROM data structure.
+
+      @param eeprom         Eeprom to use
+      @param startAddr      Where in the EEPROM the data structure should start
+      @param endurFactor    Endurance Factor: size of the circular buffer
+      @param dataSize       Size of the element to store in the Endurance EEPROM.
+
+      @note If endurFactor is 1, we have a degenerative scenario and the
+      circular buffer algorithm would not work. However, EnduranceEeprom
+      can be initialized with an endurFactor of 1. In this case, the data
+      is simply stored in a single area of memory and no status buffer is
+      used. Of course, this scenario would be more efficiently handled
+      with SafeEeprom, however it allows for other classes using
+      EnduranceEeprom to have a unified interface to the EEPROM with or
+      without endurance, and will not consume more space than the dataSize
+      itself if no endurance is required.
+
+      @param recovery       Strategy used to find the current element at
+                            boot time [default=LINEAR_SCAN]
+   */
+  EnduranceEepromT(Backend &ee, uint16_t startAddr, uint16_t endurFactor, size_t dataSize,
+                   Recovery recovery=LINEAR_SCAN);
+
+  /** Initialize a Endurance EEPROM data structure with a given layout
+      of the slots (see planLayout()). The same layout must be used to
+      read the data structure again.
+   */
+  EnduranceEepromT(Backend &ee, uint16_t startAddr, uint16_t endurFactor, size_t dataSize,
+                   const Layout &layout, Recovery recovery=LINEAR_SCAN);
+
+  /** Return the total space required for this EnduranceEeprom data structure.
+   */
+  uint16_t storageSize();
+
+  /** Return the address of the data structure on the EEPROM.
+   */
+  uint16_t startAddr() {
+    return m_startAddr;
+  }
+
+  /** Write the data to the EEPROM.
+      @return           false if the verification found the data written
+                        differs from data: the status is then not
+                        updated, and readData() still returns the
+                        previous data.
+   */
+  bool writeData(void *data);
+
+  /** Read the data back after each write, before writing the status.
+      @param verify     true to verify the writes [default=false]
+   */
+  void setVerify(bool verify) {
+    m_verify = verify;
+  }
+
+  /** Read the data from the EEPROM.
+   */
+  bool readData(void *data);
+
+protected:
+  typedef StaticEeprom<Backend> EE;
+
+  /** Device to be used */
+  Backend &m_eeprom;
+
+  /** Current status of the circular buffers */
+  Status m_status;
+
+  /** Address of the data structure. */
+  uint16_t m_startAddr;
+
+  /** Address of the beginning of the status circular buffer. */
+  uint16_t m_statusAddr;
+
+  /** Address of the beginning of the data circular buffer. */
+  uint16_t m_dataAddr;
+
+  /** Distance between two status slots. */
+  uint16_t m_statusStride;
+
+  /** Distance between two data slots. */
+  uint16_t m_dataStride;
+
+  /** Endurance factor. */
+  uint16_t m_endurFactor;
+
+  /** Size of the data sample to store. */
+  size_t m_dataSize;
+
+  /** Read back and compare the data writes. */
+  bool m_verify;
+
+  /** Compute the CRC16 of the a data sample stored on the EEPROM. */
+  uint16_t memCrc16(uint16_t addr, size_t len);
+
+  /** Compute the CRC16 of the a data sample in RAM. */
+  static uint16_t ramCrc16(const void *data, size_t len);
+
+  /** Compare the EEPROM content with a block of RAM. */
+  bool verify(uint16_t addr, const void *data, size_t len);
+
+  /** Find the current status buffer at boot time. */
+  bool findCurrent(Recovery recovery);
+
+  /** Find the current status by comparing all the consecutive status,
+      and return its slot. */
+  bool scanCurrent(uint16_t &slot);
+
+  /** Find the current status by bisection of the index sequence, and
+      return its slot. */
+  bool searchCurrent(uint16_t &slot);
+
+  /** Load the status of a slot, return true if it points to this slot
+      and matches the CRC of its data. */
+  bool loadStatus(uint16_t slot);
+
+  /** Return the address of a status slot. */
+  uint16_t statusAddr(uint16_t slot) {
+    return m_statusAddr + slot*m_statusStride;
+  }
+
+  /** Return the address of a data slot. */
+  uint16_t dataAddr(uint16_t slot) {
+    return m_dataAddr + slot*m_dataStride;
+  }
+
+};
+
+template <class Backend>
+EnduranceEepromT<Backend>::EnduranceEepromT(Backend &eeprom, uint16_t startAddr,
+                                            uint16_t endurFactor, size_t dataSize,
+                                            Recovery recovery) :
+  EnduranceEepromT(eeprom, startAddr, endurFactor, dataSize,
+                   packedLayout(endurFactor, dataSize), recovery)
+{
+}
+
+template <class Backend>
+EnduranceEepromT<Backend>::EnduranceEepromT(Backend &eeprom, uint16_t startAddr,
+                                            uint16_t endurFactor, size_t dataSize,
+                                            const Layout &layout, Recovery recovery) :
+  m_eeprom(eeprom),
+  m_startAddr(startAddr),
+  m_statusAddr(startAddr+layout.statusOffset),
+  m_dataAddr(startAddr+layout.dataOffset),
+  m_statusStride(layout.statusStride),
+  m_dataStride(layout.dataStride),
+  m_endurFactor(endurFactor),
+  m_dataSize(dataSize),
+  m_verify(false)
+{
+  if ( m_endurFactor > 1 ) {
+    // Check if there is enough memory from the start address
+    if ( (startAddr+storageSize()) > EE::memSize(m_eeprom) ) {
+      exit(-1);
+    }
+#ifdef SERIAL_DEBUG
+    if ( ( m_dataStride % EE::pageSize(m_eeprom) ) != 0 ) {
+      Serial.println("EnduranceEeprom Warning: dataSize is not a multiple of the page size -> non optimal endurance!");
+    }
+#endif
+    bool found = findCurrent(recovery);
+    if ( ! found ) {
+      // This area of memory has never been used for this circular buffer
+      m_status.index = 1;
+      EE::fill(m_eeprom, m_dataAddr, 0xFF, m_dataSize);
+      m_status.crc16 = memCrc16(m_dataAddr, m_dataSize);
+      EE::write_block(m_eeprom, m_statusAddr, (void *)&m_status, sizeof(Status));
+    }
+  }
+  else {
+    m_statusAddr = m_startAddr;
+    m_dataAddr = m_startAddr;
+  }
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::writeData(void *data)
+{
+  if ( m_endurFactor > 1 ) {
+    // m_status.index already point to the next element
+    // we wrap it here and keep it value for the 2 writes.
+    uint16_t index = m_status.index % m_endurFactor;
+
+    // destination of the next data write
+    uint16_t addr = dataAddr(index);
+
+    // writing first the data (unchanged bytes are not programmed)
+    EE::update_block(m_eeprom, addr, data, m_dataSize);
+    if ( m_verify && ! verify(addr, data, m_dataSize) ) {
+      // keep the previous status: it still points to valid data
+      return false;
+    }
+
+    // crc computation, from the RAM copy of the data
+    m_status.crc16 = ramCrc16(data, m_dataSize);
+
+    // we are incrementing our position (status data, not memory pointer)
+    m_status.index++;
+
+    // writing last the new status: index + crc together
+    EE::update_block(m_eeprom, statusAddr(index), (void *)&m_status, sizeof(Status));
+  }
+  else {
+    EE::update_block(m_eeprom, m_dataAddr, data, m_dataSize);
+    if ( m_verify ) return verify(m_dataAddr, data, m_dataSize);
+  }
+  return true;
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::readData(void *data)
+{
+  if ( m_endurFactor > 1 ) {
+    uint16_t addr = dataAddr((m_status.index-1)%m_endurFactor);
+    EE::read_block(m_eeprom, addr, data, m_dataSize);
+    uint16_t crc = ramCrc16(data, m_dataSize);
+    if ( crc == m_status.crc16 ) return true; else return false;
+  }
+  else {
+    EE::read_block(m_eeprom, m_dataAddr, data, m_dataSize);
+    return true;
+  }
+}
+
+template <class Backend>
+uint16_t EnduranceEepromT<Backend>::storageSize()
+{
+  if ( m_endurFactor > 1 ) {
+    return m_dataAddr - m_startAddr + m_endurFactor*m_dataStride;
+  }
+  return m_dataSize;
+}
+
+template <class Backend>
+uint16_t EnduranceEepromT<Backend>::memCrc16(uint16_t addr, size_t len)
+{
+  uint8_t buffer[ENDURANCE_READ_CHUNK];
+  uint16_t crc = 0xFFFF;
+  while ( len > 0 ) {
+    size_t chunk = ( len < sizeof(buffer) ) ? len : sizeof(buffer);
+    EE::read_block(m_eeprom, addr, (void *)buffer, chunk);
+    crc = Crc16::block(crc, buffer, chunk);
+    addr += chunk;
+    len -= chunk;
+  }
+  return crc;
+}
+
+template <class Backend>
+uint16_t EnduranceEepromT<Backend>::ramCrc16(const void *data, size_t len)
+{
+  return Crc16::block(0xFFFF, data, len);
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::verify(uint16_t addr, const void *data, size_t len)
+{
+  const uint8_t *ptr = (const uint8_t *)data;
+  uint8_t buffer[ENDURANCE_READ_CHUNK];
+  while ( len > 0 ) {
+    size_t chunk = ( len < sizeof(buffer) ) ? len : sizeof(buffer);
+    EE::read_block(m_eeprom, addr, (void *)buffer, chunk);
+    if ( memcmp(buffer, ptr, chunk) != 0 ) return false;
+    addr += chunk;
+    ptr += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::findCurrent(Recovery recovery)
+{
+  bool found;
+  uint16_t slot = 0;
+  if ( BINARY_SEARCH == recovery ) {
+    found = searchCurrent(slot);
+  }
+  else {
+    found = scanCurrent(slot);
+  }
+  if ( ! found ) return false;
+
+  // Check CRC to make sure this value was correctly written
+  if ( ! loadStatus(slot) ) {
+    // The power was lost while the status was written: the previous
+    // status is untouched and points to complete data.
+    uint16_t previous = ( slot > 0 ) ? slot-1 : m_endurFactor-1;
+    if ( ! loadStatus(previous) ) {
+#ifdef SERIAL_DEBUG
+      Serial.println("EnduranceEeprom Warning: memory corruption detected!");
+#endif
+      // no valid data left: start over
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::loadStatus(uint16_t slot)
+{
+  EE::read_block(m_eeprom, statusAddr(slot), (void *)&m_status, sizeof(Status));
+  if ( (uint16_t)(m_status.index-1) % m_endurFactor != slot ) return false;
+  return memCrc16(dataAddr(slot), m_dataSize) == m_status.crc16;
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::scanCurrent(uint16_t &slot)
+{
+  bool found = false;
+  uint16_t current = 0;
+  uint16_t next;
+  Status ns;
+  // Iterate trhough the status buffer to find which was the last element
+  while ( current < m_endurFactor && ! found ) {
+    next = current + 1;
+    if ( next == m_endurFactor ) {
+      next = 0;
+    }
+    EE::read_block(m_eeprom, statusAddr(current), (void *)&m_status, sizeof(Status));
+    EE::read_block(m_eeprom, statusAddr(next), (void *)&ns, sizeof(Status));
+    if ( (uint16_t)(ns.index-m_status.index) > 1 ) {
+      found = true;
+      slot = current;
+    }
+    else {
+      current++;
+    }
+  }
+  return found;
+}
+
+template <class Backend>
+bool EnduranceEepromT<Backend>::searchCurrent(uint16_t &slot)
+{
+  Status first;
+  EE::read_block(m_eeprom, m_statusAddr, (void *)&first, sizeof(Status));
+  if ( 0xFFFF == first.index && 0xFFFF == first.crc16 ) {
+    // The first status is always written at initialization time:
+    // this area of memory has never been used for this circular buffer
+    m_status = first;
+    return false;
+  }
+  // Slots before the wrap point hold first.index+slot, the slots after
+  // it hold older (or never written) indexes: look for the last slot
+  // matching the sequence.
+  uint16_t low = 0;
+  uint16_t high = m_endurFactor-1;
+  m_status = first;
+  while ( low < high ) {
+    uint16_t mid = low + (high-low+1)/2;
+    Status ms;
+    EE::read_block(m_eeprom, statusAddr(mid), (void *)&ms, sizeof(Status));
+    if ( (uint16_t)(ms.index-first.index) == mid ) {
+      low = mid;
+      m_status = ms;
+    }
+    else {
+      high = mid-1;
+    }
+  }
+  // m_status holds the last status matching the sequence: the current one
+  slot = low;
+  return true;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/**
+   I2cBus.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef I2cBus_h
+#define I2cBus_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+   Interface to an I2C bus master.
+
+   The methods follow the Arduino Wire library, so that I2cEeprom can use
+   the Wire library on the board (WireBus) and a simulated device on the
+   host computer (SimI2cBus).
+*/
+class I2cBus
+{
+public:
+  /** Start a transmission to a device.
+      @param address    7 bits address of the device
+  */
+  virtual void beginTransmission(uint8_t address) = 0;
+
+  /** Queue a byte to send in the current transmission.
+      @param data       byte to send
+      @return           1 if the byte was queued, 0 if the buffer is full
+  */
+  virtual size_t write(uint8_t data) = 0;
+
+  /** Send the queued bytes.
+      @param stop       release the bus after the transmission
+      @return           0 on success, 2 if the address was not acknowledged,
+                        3 if a data byte was not acknowledged, 4 on other errors
+  */
+  virtual uint8_t endTransmission(bool stop=true) = 0;
+
+  /** Read bytes from a device.
+      @param address    7 bits address of the device
+      @param quantity   number of bytes to read
+      @return           number of bytes received
+  */
+  virtual uint8_t requestFrom(uint8_t address, uint8_t quantity) = 0;
+
+  /** Return the next byte received, or -1 if none is left.
+   */
+  virtual int read() = 0;
+
+  /** Return the size of the transmit/receive buffer, which limits the
+      number of bytes of one transmission (address bytes included).
+   */
+  virtual uint8_t bufferSize() = 0;
+
+  /** Return the time in microseconds (used for timeouts).
+   */
+  virtual unsigned long micros() = 0;
+
+};
+
+#endif
@@ -0,0 +1,249 @@
+/**
+   I2cEeprom.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "I2cEeprom.h"
+
+#ifdef SERIAL_DEBUG
+#include <HardwareSerial.h>
+#endif
+
+#include <string.h>
+
+I2cEeprom::I2cEeprom(I2cBus &bus, uint8_t device, uint16_t size,
+                     uint16_t pageSize) :
+  m_bus(bus),
+  m_device(device),
+  m_size(size),
+  m_pageSize(pageSize),
+  m_poller(bus, device),
+  m_writeErrors(0)
+{
+}
+
+void I2cEeprom::write_byte(uint16_t addr, uint8_t data)
+{
+  store(addr, &data, 1, false);
+}
+
+uint8_t I2cEeprom::read_byte(uint16_t addr)
+{
+  uint8_t data;
+  read_block(addr, (void *)&data, sizeof(data));
+  return data;
+}
+
+void I2cEeprom::write_word(uint16_t addr, uint16_t data)
+{
+  store(addr, (uint8_t *)&data, sizeof(data), false);
+}
+
+uint16_t I2cEeprom::read_word(uint16_t addr)
+{
+  uint16_t data;
+  read_block(addr, (void *)&data, sizeof(data));
+  return data;
+}
+
+void I2cEeprom::write_long(uint16_t addr, uint32_t data)
+{
+  store(addr, (uint8_t *)&data, sizeof(data), false);
+}
+
+uint32_t I2cEeprom::read_long(uint16_t addr)
+{
+  uint32_t data;
+  read_block(addr, (void *)&data, sizeof(data));
+  return data;
+}
+
+void I2cEeprom::write_block(uint16_t addr, void* data, size_t len)
+{
+  store(addr, (uint8_t *)data, len, false);
+}
+
+void I2cEeprom::read_block(uint16_t addr, void* data, size_t len)
+{
+  uint8_t *dst = (uint8_t *)data;
+
+  // set the device address pointer, then read sequentially
+  m_bus.beginTransmission(m_device);
+  m_bus.write(addr >> 8);
+  m_bus.write(addr & 0xFF);
+  if ( m_bus.endTransmission() != 0 ) {
+    memset(dst, 0xFF, len);
+    return;
+  }
+  while ( len > 0 ) {
+    uint8_t chunk = ( len < m_bus.bufferSize() ) ? len : m_bus.bufferSize();
+    uint8_t received = m_bus.requestFrom(m_device, chunk);
+    for (uint8_t i=0; i<chunk; i++) {
+      int c = ( i < received ) ? m_bus.read() : -1;
+      dst[i] = ( c < 0 ) ? 0xFF : c;
+    }
+    dst += chunk;
+    len -= chunk;
+  }
+}
+
+void I2cEeprom::update_byte(uint16_t addr, uint8_t data)
+{
+  store(addr, &data, 1, true);
+}
+
+void I2cEeprom::update_word(uint16_t addr, uint16_t data)
+{
+  store(addr, (uint8_t *)&data, sizeof(data), true);
+}
+
+void I2cEeprom::update_long(uint16_t addr, uint32_t data)
+{
+  store(addr, (uint8_t *)&data, sizeof(data), true);
+}
+
+void I2cEeprom::update_block(uint16_t addr, void* data, size_t len)
+{
+  store(addr, (uint8_t *)data, len, true);
+}
+
+void I2cEeprom::fill(uint16_t addr, uint8_t value, size_t len)
+{
+  if ( (uint32_t)addr + len > m_size ) return;
+
+  // each chunk of the page buffer is loaded with the value
+  uint8_t data[I2C_EEPROM_MAX_CHUNK];
+  memset(data, value, sizeof(data));
+  while ( len > 0 ) {
+    uint8_t chunk = chunkSize(addr, len);
+    store(addr, data, chunk, true);
+    addr += chunk;
+    len -= chunk;
+  }
+}
+
+uint16_t I2cEeprom::memSize()
+{
+  return m_size;
+}
+
+uint16_t I2cEeprom::pageSize()
+{
+  return m_pageSize;
+}
+
+void I2cEeprom::show(uint16_t start, int len)
+{
+#ifdef SERIAL_DEBUG
+  if ( start >= m_size ) return;
+  uint16_t ptr = start - start % m_pageSize;
+  uint32_t end = ( len < 0 ) ? m_size : start + len;
+  if ( end > m_size ) end = m_size;
+
+  uint8_t data[16];
+  while ( ptr < end ) {
+    read_block(ptr, (void *)data, sizeof(data));
+    Serial.print("bytes [");
+    Serial.print(ptr, DEC);
+    Serial.print("-");
+    Serial.print(ptr+sizeof(data)-1, DEC);
+    Serial.print("] (page=");
+    Serial.print(ptr/m_pageSize, DEC);
+    Serial.print(") : ");
+    for (uint8_t i=0; i<sizeof(data); i++) {
+      Serial.print(data[i], HEX);
+      Serial.print(" ");
+    }
+    Serial.println();
+    ptr += sizeof(data);
+  }
+#else
+  (void)start;
+  (void)len;
+#endif
+}
+
+uint16_t I2cEeprom::timeouts()
+{
+  return m_poller.timeouts();
+}
+
+uint16_t I2cEeprom::writeErrors()
+{
+  return m_writeErrors;
+}
+
+AckPoller &I2cEeprom::poller()
+{
+  return m_poller;
+}
+
+uint8_t I2cEeprom::chunkSize(uint16_t addr, size_t len)
+{
+  size_t chunk = m_pageSize - addr % m_pageSize;
+  if ( (size_t)(m_bus.bufferSize()-2) < chunk ) chunk = m_bus.bufferSize()-2;
+  if ( I2C_EEPROM_MAX_CHUNK < chunk ) chunk = I2C_EEPROM_MAX_CHUNK;
+  if ( len < chunk ) chunk = len;
+  return chunk;
+}
+
+bool I2cEeprom::writeChunk(uint16_t addr, const uint8_t *data, uint8_t len)
+{
+  for (uint8_t attempt=0; ; attempt++) {
+    m_bus.beginTransmission(m_device);
+    m_bus.write(addr >> 8);
+    m_bus.write(addr & 0xFF);
+    for (uint8_t i=0; i<len; i++) {
+      m_bus.write(data[i]);
+    }
+    if ( m_bus.endTransmission() == 0 ) break;
+    // not acknowledged: the device may still be busy, wait for it
+    if ( attempt >= I2C_EEPROM_WRITE_RETRIES || ! m_poller.wait() ) {
+#ifdef SERIAL_DEBUG
+      Serial.print("==== I2cEeprom::writeChunk -> write not acknowledged at ");
+      Serial.println(addr, DEC);
+#endif
+      m_writeErrors++;
+      return false;
+    }
+  }
+  m_poller.wait();
+  return true;
+}
+
+void I2cEeprom::store(uint16_t addr, const uint8_t *data, size_t len, bool update)
+{
+  // same policy than AvrEeprom: out of bound writes are dropped
+  if ( (uint32_t)addr + len > m_size ) return;
+
+  while ( len > 0 ) {
+    uint8_t chunk = chunkSize(addr, len);
+    if ( update ) {
+      // a chunk costs one write cycle: only skip it if fully unchanged
+      uint8_t current[I2C_EEPROM_MAX_CHUNK];
+      read_block(addr, (void *)current, chunk);
+      if ( memcmp(current, data, chunk) != 0 && ! writeChunk(addr, data, chunk) ) {
+        return;
+      }
+    }
+    else if ( ! writeChunk(addr, data, chunk) ) {
+      return;
+    }
+    addr += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+}
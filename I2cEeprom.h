@@ -0,0 +1,144 @@
+/**
+   I2cEeprom.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef I2cEeprom_h
+#define I2cEeprom_h
+
+#include "SafeEeprom.h"
+#include "I2cBus.h"
+#include "AckPoller.h"
+
+/** Maximum number of data bytes sent in one transmission (the 32 bytes
+    of the Wire buffer minus the 2 address bytes). */
+#ifndef I2C_EEPROM_MAX_CHUNK
+#define I2C_EEPROM_MAX_CHUNK 30
+#endif
+
+/** Number of times a chunk not acknowledged by the device is sent again,
+    after waiting for the end of its write cycle. */
+#ifndef I2C_EEPROM_WRITE_RETRIES
+#define I2C_EEPROM_WRITE_RETRIES 1
+#endif
+
+/**
+   Class to access an external I2C EEPROM of the 24LCxx family.
+
+   The device programs up to one page (64 bytes on the 24LC256) in a
+   single write cycle, but a write crossing a page boundary wraps to the
+   start of the page. Writes are thus split at the page boundaries, and
+   also at the size of the bus buffer (the Wire library sends at most 32
+   bytes, including the 2 address bytes). After each chunk, the device is
+   polled until it acknowledges its address again (see AckPoller), rather
+   than waiting for the worst case write cycle time. Reads are sequential
+   and not limited by the pages.
+
+   A chunk not acknowledged by the device (still busy with a write cycle
+   which timed out, or missing) is sent again once the device answers
+   the polling. If it still fails, the rest of the write is dropped and
+   counted by writeErrors(), as the SafeEeprom writes return nothing.
+
+   With its several KB, such a device can keep much longer sample
+   histories than the internal EEPROM of the AVR.
+
+   @note Addresses and sizes are 16 bits: devices up to the 24LC256 (32KB)
+   are fully supported.
+
+   Documentation of the SafeEeprom methods is provided by the interface.
+ */
+class I2cEeprom : public SafeEeprom
+{
+public:
+  /** Create an access to an external EEPROM.
+      @param bus        I2C bus where the device is connected
+      @param device     7 bits address of the device [default=0x50]
+      @param size       size of the device in bytes [default=24LC256]
+      @param pageSize   size of the device page in bytes [default=24LC256]
+  */
+  I2cEeprom(I2cBus &bus, uint8_t device=0x50, uint16_t size=32768,
+            uint16_t pageSize=64);
+
+  void write_byte(uint16_t addr, uint8_t data);
+
+  uint8_t read_byte(uint16_t addr);
+
+  void write_word(uint16_t addr, uint16_t data);
+
+  uint16_t read_word(uint16_t addr);
+
+  void write_long(uint16_t addr, uint32_t data);
+
+  uint32_t read_long(uint16_t addr);
+
+  void write_block(uint16_t addr, void* data, size_t len);
+
+  void read_block(uint16_t addr, void* data, size_t len);
+
+  void update_byte(uint16_t addr, uint8_t data);
+
+  void update_word(uint16_t addr, uint16_t data);
+
+  void update_long(uint16_t addr, uint32_t data);
+
+  void update_block(uint16_t addr, void* data, size_t len);
+
+  void fill(uint16_t addr, uint8_t value, size_t len);
+
+  uint16_t memSize();
+
+  uint16_t pageSize();
+
+  void show(uint16_t start=0, int len=-1);
+
+  /** Return the number of write cycles which did not complete in time.
+   */
+  uint16_t timeouts();
+
+  /** Return the number of writes dropped because the device did not
+      acknowledge them.
+   */
+  uint16_t writeErrors();
+
+  /** Return the poller detecting the end of the write cycles, to set its
+      timeout or read its completion time histogram.
+   */
+  AckPoller &poller();
+
+protected:
+  /** Return how many bytes can be written at addr in one transmission. */
+  uint8_t chunkSize(uint16_t addr, size_t len);
+
+  /** Write a chunk of data within a single page, and wait for the end
+      of the write cycle.
+      @return           false if the device did not acknowledge the chunk
+  */
+  bool writeChunk(uint16_t addr, const uint8_t *data, uint8_t len);
+
+  /** Write len bytes, page per page. If update is true, the chunks
+      already holding the data are not written. */
+  void store(uint16_t addr, const uint8_t *data, size_t len, bool update);
+
+  I2cBus &m_bus;                /** Bus where the device is connected */
+  uint8_t m_device;             /** Address of the device on the bus */
+  uint16_t m_size;              /** Size of the device in bytes */
+  uint16_t m_pageSize;          /** Size of a device page in bytes */
+  AckPoller m_poller;           /** Detects the end of the write cycles */
+  uint16_t m_writeErrors;       /** Writes not acknowledged by the device */
+
+};
+
+#endif
@@ -0,0 +1,188 @@
+/**
+   QuantizedSample.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef QuantizedSample_h
+#define QuantizedSample_h
+
+#include <math.h>       // for NAN
+#include <stdint.h>
+#include <string.h>
+
+#include "DataSample.h"
+
+/**
+   Fixed-point coding of a channel: value = offset + code*scale.
+
+   With BITS bits per code, the codes 0 to 2^BITS-2 represent the values
+   from offset to offset + (2^BITS-2)*scale. The code with all the bits
+   set is the null value, the one read back for the samples skipped by
+   the ring buffers (their bytes are 0xFF).
+ */
+struct QuantizedCodec
+{
+  float scale;                  /** Value of one step of the code */
+  float offset;                 /** Value of the code 0 */
+};
+
+/**
+   DataSample storing CHANNELS values quantized on BITS bits each.
+
+   The codes are packed without padding (little endian bit order), so a
+   sample of three channels takes 3 bytes with 8 bits, 5 bytes with 12
+   bits and 6 bytes with 16 bits, instead of 12 bytes of float. The
+   sample is a regular DataSample: the ring buffers store and read its
+   size() bytes, and a skipped sample reads back as null values (get()
+   returns NAN, valid() false).
+
+   The codecs (scale and offset) are not stored with the data: the same
+   codecs must be given to read the samples back.
+
+     const QuantizedCodec temperature = { 0.05, -40.0 };   // -40 to 164.7 C
+     QuantizedSample<12, 3> sample(temperature);
+     sample.set(0, 21.5);
+     timed.insert(sample, now);
+
+   With BITS=16 each code is a whole uint16_t, so CompressedRingBuffer
+   compresses the channels of the sample.
+ */
+template <uint8_t BITS, uint8_t CHANNELS>
+class QuantizedSample : public DataSample
+{
+public:
+  static_assert(BITS >= 2 && BITS <= 16, "QuantizedSample codes are 2 to 16 bits");
+  static_assert(CHANNELS > 0, "QuantizedSample needs a channel");
+
+  /** Bytes of a sample */
+  static constexpr uint8_t SIZE = ((uint16_t)BITS*CHANNELS + 7) / 8;
+
+  /** Code of the null value */
+  static constexpr uint16_t NULL_CODE = (uint16_t)((1UL << BITS) - 1);
+
+  /** Create a sample whose channels share the same codec (copied, so
+      it can be a temporary). */
+  QuantizedSample(const QuantizedCodec &codec) :
+    DataSample(SIZE),
+    m_codecs(0),
+    m_codec(codec)
+  {
+    clear();
+  }
+
+  /** Create a sample with one codec per channel.
+      @param codecs     CHANNELS codecs, which must outlive the sample
+   */
+  QuantizedSample(const QuantizedCodec *codecs) :
+    DataSample(SIZE),
+    m_codecs(codecs),
+    m_codec()
+  {
+    clear();
+  }
+
+  void *data() {
+    return (void *)m_data;
+  }
+
+  /** Quantize a value: it is rounded to the nearest code, and clamped to
+      the range of the codec. NAN stores the null value. */
+  void set(uint8_t channel, float value) {
+    uint16_t code = NULL_CODE;
+    if ( value == value ) {
+      const QuantizedCodec &c = codec(channel);
+      float steps = (value - c.offset) / c.scale + 0.5f;
+      if ( steps < 0 ) code = 0;
+      else if ( steps >= NULL_CODE-1 ) code = NULL_CODE-1;
+      else code = (uint16_t)steps;
+    }
+    setCode(channel, code);
+  }
+
+  /** Return the value of a channel, NAN for the null value. */
+  float get(uint8_t channel) {
+    uint16_t code = getCode(channel);
+    if ( code == NULL_CODE ) return NAN;
+    const QuantizedCodec &c = codec(channel);
+    return c.offset + code*c.scale;
+  }
+
+  /** Return false if a channel holds the null value. */
+  bool valid(uint8_t channel) {
+    return getCode(channel) != NULL_CODE;
+  }
+
+  /** Set all the channels to the null value. */
+  void clear() {
+    memset(m_data, 0xFF, SIZE);
+  }
+
+  /** Write the code of a channel. */
+  void setCode(uint8_t channel, uint16_t code) {
+    if ( BITS == 8 ) {
+      m_data[channel] = code;
+      return;
+    }
+    if ( BITS == 16 ) {
+      m_data[2*channel] = code;
+      m_data[2*channel+1] = code >> 8;
+      return;
+    }
+    uint16_t bit = (uint16_t)channel*BITS;
+    uint8_t *p = m_data + bit/8;
+    uint8_t shift = bit & 7;
+    uint32_t mask = (uint32_t)NULL_CODE << shift;
+    uint32_t value = (uint32_t)(code & NULL_CODE) << shift;
+    for (uint8_t i=0; i < (shift+BITS+7)/8; i++) {
+      p[i] = ( p[i] & ~(uint8_t)(mask >> 8*i) ) | (uint8_t)(value >> 8*i);
+    }
+  }
+
+  /** Return the code of a channel. */
+  uint16_t getCode(uint8_t channel) {
+    if ( BITS == 8 ) return m_data[channel];
+    if ( BITS == 16 ) return m_data[2*channel] | (uint16_t)m_data[2*channel+1] << 8;
+    uint16_t bit = (uint16_t)channel*BITS;
+    const uint8_t *p = m_data + bit/8;
+    uint8_t shift = bit & 7;
+    uint32_t value = 0;
+    for (uint8_t i=0; i < (shift+BITS+7)/8; i++) {
+      value |= (uint32_t)p[i] << 8*i;
+    }
+    return (value >> shift) & NULL_CODE;
+  }
+
+protected:
+  const QuantizedCodec &codec(uint8_t channel) {
+    return m_codecs ? m_codecs[channel] : m_codec;
+  }
+
+  const QuantizedCodec *m_codecs; /** Codec per channel, 0 if shared */
+  QuantizedCodec m_codec;       /** Codec shared by all the channels */
+  uint8_t m_data[SIZE];         /** Packed codes */
+};
+
+/** Name of the usual code sizes. */
+template <uint8_t CHANNELS>
+using Quantized8 = QuantizedSample<8, CHANNELS>;
+
+template <uint8_t CHANNELS>
+using Quantized12 = QuantizedSample<12, CHANNELS>;
+
+template <uint8_t CHANNELS>
+using Quantized16 = QuantizedSample<16, CHANNELS>;
+
+#endif
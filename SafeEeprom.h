@@ -32,59 +32,108 @@ public:
       @param addr       address to put the byte
       @param data       byte to write
   */
-  virtual void write_byte(uint16_t addr, uint8_t data);
+  virtual void write_byte(uint16_t addr, uint8_t data) = 0;
   
   /** Read a byte from the EEPROM.
       @param addr       address of the byte to read
       @return           byte read
   */
-  virtual uint8_t read_byte(uint16_t addr);
+  virtual uint8_t read_byte(uint16_t addr) = 0;
   
   /** Write a word (unsigned 16 bits int) to the EEPROM.
       @param addr       address to put the word
       @param data       word to write
   */
-  virtual void write_word(uint16_t addr, uint16_t data);
+  virtual void write_word(uint16_t addr, uint16_t data) = 0;
   
   /** Read a word (unsigned 16 bits int) from the EEPROM.
       @param addr       address of the 2 bytes to read
       @return           word read
   */
-  virtual uint16_t read_word(uint16_t addr);
+  virtual uint16_t read_word(uint16_t addr) = 0;
 
   /** Write a long (unsigned 32 bits int) to the EEPROM.
       @param addr       address to put the long
       @param data       long to write
   */
-  virtual void write_long(uint16_t addr, uint32_t data);
+  virtual void write_long(uint16_t addr, uint32_t data) = 0;
   
   /** Read a long (unsigned 32 bits int) from the EEPROM.
       @param addr       address of the 4 bytes to read
       @return           long read
   */
-  virtual uint32_t read_long(uint16_t addr);
+  virtual uint32_t read_long(uint16_t addr) = 0;
 
   /** Write a block of data to the EEPROM.
       @param addr       address to put the data
       @param data       pointer to data to write
       @param len        size of the block of data to write
   */
-  virtual void write_block(uint16_t addr, void* data, size_t len);
+  virtual void write_block(uint16_t addr, void* data, size_t len) = 0;
   
   /** Read a block of data from the EEPROM.
       @param addr       address of the data to read
       @param data       pointer to some RAM storage for the data to read
       @param len        size of the data to read (in bytes)
   */
-  virtual void read_block(uint16_t addr, void* data, size_t len);
+  virtual void read_block(uint16_t addr, void* data, size_t len) = 0;
+
+  /** Update a byte of the EEPROM: the byte is written only if the value
+      stored differs, saving the page program otherwise.
+      @param addr       address to put the byte
+      @param data       byte to write
+  */
+  virtual void update_byte(uint16_t addr, uint8_t data) = 0;
+
+  /** Update a word (unsigned 16 bits int) of the EEPROM.
+      Only the bytes which differ from the EEPROM content are written.
+      @param addr       address to put the word
+      @param data       word to write
+  */
+  virtual void update_word(uint16_t addr, uint16_t data) = 0;
+
+  /** Update a long (unsigned 32 bits int) of the EEPROM.
+      Only the bytes which differ from the EEPROM content are written.
+      @param addr       address to put the long
+      @param data       long to write
+  */
+  virtual void update_long(uint16_t addr, uint32_t data) = 0;
+
+  /** Update a block of data of the EEPROM.
+      Only the bytes which differ from the EEPROM content are written.
+      @param addr       address to put the data
+      @param data       pointer to data to write
+      @param len        size of the block of data to write
+  */
+  virtual void update_block(uint16_t addr, void* data, size_t len) = 0;
+
+  /** Fill an area of the EEPROM with the same byte value.
+
+      The bytes already holding the value are not programmed, and the
+      devices able to do it program the area page per page (or use the
+      faster erase only / write only modes) rather than byte per byte.
+
+      @param addr       address of the first byte to fill
+      @param value      value to write in every byte
+      @param len        number of bytes to fill
+  */
+  virtual void fill(uint16_t addr, uint8_t value, size_t len) = 0;
+
+  /** Erase an area of the EEPROM (all bytes set to 0xFF).
+      @param addr       address of the first byte to erase
+      @param len        number of bytes to erase
+  */
+  void erase(uint16_t addr, size_t len) {
+    fill(addr, 0xFF, len);
+  }
 
   /** Return the EEPROM total size (measured in bytes).
    */
-  virtual uint16_t memSize();
+  virtual uint16_t memSize() = 0;
 
   /** Return the size of one EEPROM page for this board.
    */
-  virtual uint16_t pageSize();
+  virtual uint16_t pageSize() = 0;
 
   /** Print on the serial port the content of the EEPROM.
       
@@ -94,7 +143,7 @@ public:
       @param start  start address [default=0 -> first EEPROM byte]
       @param len    how many bytes to print [default=-1 -> print all]
   */
-  virtual void show(uint16_t start=0, int len=-1);
+  virtual void show(uint16_t start=0, int len=-1) = 0;
 
 };
 
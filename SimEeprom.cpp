@@ -0,0 +1,375 @@
+/**
+   SimEeprom.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "SimEeprom.h"
+
+#include <stdio.h>
+#include <string.h>
+
+SimEeprom::SimEeprom(uint16_t size, uint16_t pageSize, bool pageWrite) :
+  m_size(size),
+  m_pageSize(pageSize),
+  m_pageWrite(pageWrite),
+  m_programTime(SIM_EEPROM_PROGRAM_US),
+  m_splitTime(SIM_EEPROM_SPLIT_US),
+  m_powerCut(false),
+  m_powerBudget(0),
+  m_powerLost(false),
+  m_tear(false),
+  m_tearSeed(1)
+{
+  uint16_t pages = (m_size + m_pageSize - 1) / m_pageSize;
+  m_image = new uint8_t[m_size];
+  m_cycles = new uint32_t[pages];
+  memset(m_image, 0xFF, m_size);
+  memset(m_cycles, 0, pages*sizeof(uint32_t));
+  resetStats();
+}
+
+SimEeprom::~SimEeprom()
+{
+  delete[] m_image;
+  delete[] m_cycles;
+}
+
+void SimEeprom::write_byte(uint16_t addr, uint8_t data)
+{
+  program(addr, &data, 1);
+}
+
+uint8_t SimEeprom::read_byte(uint16_t addr)
+{
+  uint8_t data;
+  fetch(addr, &data, 1);
+  return data;
+}
+
+void SimEeprom::write_word(uint16_t addr, uint16_t data)
+{
+  program(addr, (uint8_t *)&data, sizeof(data));
+}
+
+uint16_t SimEeprom::read_word(uint16_t addr)
+{
+  uint16_t data;
+  fetch(addr, (uint8_t *)&data, sizeof(data));
+  return data;
+}
+
+void SimEeprom::write_long(uint16_t addr, uint32_t data)
+{
+  program(addr, (uint8_t *)&data, sizeof(data));
+}
+
+uint32_t SimEeprom::read_long(uint16_t addr)
+{
+  uint32_t data;
+  fetch(addr, (uint8_t *)&data, sizeof(data));
+  return data;
+}
+
+void SimEeprom::write_block(uint16_t addr, void* data, size_t len)
+{
+  program(addr, (uint8_t *)data, len);
+}
+
+void SimEeprom::read_block(uint16_t addr, void* data, size_t len)
+{
+  fetch(addr, (uint8_t *)data, len);
+}
+
+void SimEeprom::update_byte(uint16_t addr, uint8_t data)
+{
+  refresh(addr, &data, 1);
+}
+
+void SimEeprom::update_word(uint16_t addr, uint16_t data)
+{
+  refresh(addr, (uint8_t *)&data, sizeof(data));
+}
+
+void SimEeprom::update_long(uint16_t addr, uint32_t data)
+{
+  refresh(addr, (uint8_t *)&data, sizeof(data));
+}
+
+void SimEeprom::update_block(uint16_t addr, void* data, size_t len)
+{
+  refresh(addr, (uint8_t *)data, len);
+}
+
+void SimEeprom::fill(uint16_t addr, uint8_t value, size_t len)
+{
+  if ( len == 0 || (uint32_t)addr + len > m_size ) return;
+
+  if ( m_pageWrite ) {
+    // the page buffer is loaded with the value, one program per page
+    uint8_t *data = new uint8_t[len];
+    memset(data, value, len);
+    refresh(addr, data, len);
+    delete[] data;
+    return;
+  }
+
+  for (size_t i=0; i<len; i++) {
+    uint8_t current = m_image[addr+i];
+    if ( current == value ) {
+      m_avoidedPrograms++;
+      continue;
+    }
+    if ( ! powered(addr+i, value) ) return;
+    m_image[addr+i] = value;
+    m_cycles[(addr+i) / m_pageSize]++;
+    m_programs++;
+    if ( 0xFF == value || 0xFF == current ) {
+      m_deviceTime += m_splitTime;
+    }
+    else {
+      m_deviceTime += m_programTime;
+    }
+    m_bytesWritten++;
+  }
+}
+
+uint16_t SimEeprom::memSize()
+{
+  return m_size;
+}
+
+uint16_t SimEeprom::pageSize()
+{
+  return m_pageSize;
+}
+
+void SimEeprom::show(uint16_t start, int len)
+{
+  if ( start >= m_size ) return;
+
+  // print complete pages, like AvrEeprom does
+  uint16_t ptr = start - start % m_pageSize;
+  uint32_t end;
+  if ( len < 0 ) {
+    end = m_size;
+  }
+  else {
+    end = start + len;
+    if ( end % m_pageSize ) end += m_pageSize - end % m_pageSize;
+    if ( end > m_size ) end = m_size;
+  }
+
+  while ( ptr < end ) {
+    printf("bytes [%u-%u] (page=%u, cycles=%u) : ",
+           ptr, ptr+m_pageSize-1, ptr/m_pageSize, m_cycles[ptr/m_pageSize]);
+    for (uint16_t i=0; i<m_pageSize && ptr<end; i++) {
+      printf("%X ", m_image[ptr++]);
+    }
+    printf("\n");
+  }
+}
+
+bool SimEeprom::load(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if ( ! file ) return false;
+  size_t read = fread(m_image, 1, m_size, file);
+  bool ok = ! ferror(file);
+  fclose(file);
+  // a short file: the rest of the image is erased
+  memset(m_image+read, 0xFF, m_size-read);
+  return ok;
+}
+
+bool SimEeprom::save(const char *path)
+{
+  FILE *file = fopen(path, "wb");
+  if ( ! file ) return false;
+  size_t written = fwrite(m_image, 1, m_size, file);
+  fclose(file);
+  return written == m_size;
+}
+
+void SimEeprom::setProgramTime(uint32_t us, uint32_t splitUs)
+{
+  m_programTime = us;
+  m_splitTime = splitUs;
+}
+
+uint32_t SimEeprom::pageCycles(uint16_t page)
+{
+  if ( page*m_pageSize >= m_size ) return 0;
+  return m_cycles[page];
+}
+
+uint32_t SimEeprom::maxPageCycles()
+{
+  uint32_t max = 0;
+  for (uint16_t p=0; p*m_pageSize<m_size; p++) {
+    if ( m_cycles[p] > max ) max = m_cycles[p];
+  }
+  return max;
+}
+
+uint32_t SimEeprom::pagePrograms()
+{
+  return m_programs;
+}
+
+uint32_t SimEeprom::avoidedPrograms()
+{
+  return m_avoidedPrograms;
+}
+
+uint32_t SimEeprom::bytesWritten()
+{
+  return m_bytesWritten;
+}
+
+uint32_t SimEeprom::bytesRead()
+{
+  return m_bytesRead;
+}
+
+uint32_t SimEeprom::readOps()
+{
+  return m_readOps;
+}
+
+uint64_t SimEeprom::deviceTime()
+{
+  return m_deviceTime;
+}
+
+void SimEeprom::resetStats()
+{
+  m_programs = 0;
+  m_avoidedPrograms = 0;
+  m_bytesWritten = 0;
+  m_bytesRead = 0;
+  m_readOps = 0;
+  m_deviceTime = 0;
+}
+
+void SimEeprom::setPowerCut(uint32_t bytes, bool tear)
+{
+  m_powerCut = true;
+  m_tear = tear;
+  m_powerBudget = bytes;
+  m_powerLost = false;
+}
+
+bool SimEeprom::powerLost()
+{
+  return m_powerLost;
+}
+
+void SimEeprom::restorePower()
+{
+  m_powerCut = false;
+  m_powerLost = false;
+}
+
+bool SimEeprom::powered(uint16_t addr, uint8_t value)
+{
+  if ( ! m_powerCut ) return true;
+  if ( m_powerBudget == 0 ) {
+    if ( m_tear && ! m_powerLost ) {
+      // the cell was erased, and only some bits of the value written
+      m_tearSeed = m_tearSeed * 1103515245 + 12345;
+      m_image[addr] = value | (uint8_t)(m_tearSeed >> 16);
+    }
+    m_powerLost = true;
+    return false;
+  }
+  m_powerBudget--;
+  return true;
+}
+
+void SimEeprom::program(uint16_t addr, const uint8_t *data, size_t len)
+{
+  // same policy than AvrEeprom: out of bound writes are dropped
+  if ( len == 0 || (uint32_t)addr + len > m_size ) return;
+
+  uint16_t lastPage = m_size;   // no page programmed yet
+  for (size_t i=0; i<len; i++) {
+    uint16_t page = (addr+i) / m_pageSize;
+    if ( ! powered(addr+i, data[i]) ) {
+      // the rest of the block (and of the page) is not programmed
+      len = i;
+      break;
+    }
+    m_image[addr+i] = data[i];
+    // a page buffer absorbs all the bytes falling in the same page,
+    // otherwise each byte is an independent erase/write cycle
+    if ( ! m_pageWrite || page != lastPage ) {
+      m_cycles[page]++;
+      m_programs++;
+      m_deviceTime += m_programTime;
+      lastPage = page;
+    }
+  }
+  m_bytesWritten += len;
+}
+
+void SimEeprom::refresh(uint16_t addr, const uint8_t *data, size_t len)
+{
+  if ( len == 0 || (uint32_t)addr + len > m_size ) return;
+
+  size_t i = 0;
+  while ( i < len ) {
+    // bytes [i, end) fall in the same page
+    size_t end = ((addr+i) / m_pageSize + 1) * m_pageSize - addr;
+    if ( end > len ) end = len;
+    if ( m_pageWrite ) {
+      // the page is programmed once, with the span of modified bytes
+      size_t first = end;
+      size_t last = i;
+      for (size_t k=i; k<end; k++) {
+        if ( m_image[addr+k] != data[k] ) {
+          if ( first == end ) first = k;
+          last = k+1;
+        }
+      }
+      if ( first < end ) {
+        program(addr+first, data+first, last-first);
+      }
+      else {
+        m_avoidedPrograms++;
+      }
+    }
+    else {
+      for (size_t k=i; k<end; k++) {
+        if ( m_image[addr+k] != data[k] ) {
+          program(addr+k, data+k, 1);
+        }
+        else {
+          m_avoidedPrograms++;
+        }
+      }
+    }
+    i = end;
+  }
+}
+
+void SimEeprom::fetch(uint16_t addr, uint8_t *data, size_t len)
+{
+  for (size_t i=0; i<len; i++) {
+    data[i] = ( addr+i < m_size ) ? m_image[addr+i] : 0xFF;
+  }
+  m_bytesRead += len;
+  m_readOps++;
+}
@@ -0,0 +1,220 @@
+/**
+   SimEeprom.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SimEeprom_h
+#define SimEeprom_h
+
+#include "SafeEeprom.h"
+
+/** Default time to program (erase + write) one EEPROM page, in microseconds. */
+#define SIM_EEPROM_PROGRAM_US 3300
+
+/** Default time of an erase only or write only program, in microseconds. */
+#define SIM_EEPROM_SPLIT_US 1800
+
+/**
+   Simulated EEPROM running on the host computer (Linux).
+
+   SimEeprom backs the EEPROM address space with a RAM image, that can be
+   loaded from or saved to a file, and mimics the way the AVR EEPROM is
+   programmed: every byte written burns a full page (E2PAGESIZE, usually 4
+   bytes) and takes about 3.3ms. The simulated device time and the number
+   of erase/write cycles of each page are recorded, so every class built
+   on SafeEeprom can be benchmarked (throughput and wear) without flashing
+   a board.
+
+   External devices with a page buffer (like the 24LCxx) program all the
+   bytes of a page in a single cycle: they are modeled with the pageWrite
+   flag. In that case a block write costs one program per page it covers.
+   Otherwise, fill() models the AVR split programming modes: a byte erased
+   to 0xFF, or written while erased, only costs an erase only or write only
+   program (about 1.8ms).
+
+   Documentation of the SafeEeprom methods is provided by the interface.
+ */
+class SimEeprom : public SafeEeprom
+{
+public:
+  /** Create a simulated EEPROM, initially erased (all bytes at 0xFF).
+      @param size       total size of the EEPROM in bytes
+      @param pageSize   size of one EEPROM page in bytes
+      @param pageWrite  if true, a block write programs each page only
+                        once, otherwise each byte costs a page program
+  */
+  SimEeprom(uint16_t size=1024, uint16_t pageSize=4, bool pageWrite=false);
+
+  ~SimEeprom();
+
+  void write_byte(uint16_t addr, uint8_t data);
+
+  uint8_t read_byte(uint16_t addr);
+
+  void write_word(uint16_t addr, uint16_t data);
+
+  uint16_t read_word(uint16_t addr);
+
+  void write_long(uint16_t addr, uint32_t data);
+
+  uint32_t read_long(uint16_t addr);
+
+  void write_block(uint16_t addr, void* data, size_t len);
+
+  void read_block(uint16_t addr, void* data, size_t len);
+
+  void update_byte(uint16_t addr, uint8_t data);
+
+  void update_word(uint16_t addr, uint16_t data);
+
+  void update_long(uint16_t addr, uint32_t data);
+
+  void update_block(uint16_t addr, void* data, size_t len);
+
+  void fill(uint16_t addr, uint8_t value, size_t len);
+
+  uint16_t memSize();
+
+  uint16_t pageSize();
+
+  void show(uint16_t start=0, int len=-1);
+
+  /** Load the EEPROM image from a file.
+      The wear counters and statistics are not modified.
+      @param path       file to read (missing bytes are left erased)
+      @return           false if the file could not be opened or read
+  */
+  bool load(const char *path);
+
+  /** Save the EEPROM image to a file.
+      @param path       file to write
+      @return           true if the complete image was written
+  */
+  bool save(const char *path);
+
+  /** Set the time required to program one page.
+      @param us         programming time in microseconds
+      @param splitUs    erase only / write only time in microseconds
+  */
+  void setProgramTime(uint32_t us, uint32_t splitUs=SIM_EEPROM_SPLIT_US);
+
+  /** Return the number of erase/write cycles endured by one page.
+      @param page       page number (address / pageSize)
+  */
+  uint32_t pageCycles(uint16_t page);
+
+  /** Return the number of erase/write cycles of the most worn page.
+   */
+  uint32_t maxPageCycles();
+
+  /** Return the total number of page programs since the last resetStats().
+   */
+  uint32_t pagePrograms();
+
+  /** Return the number of page programs skipped by the update methods
+      since the last resetStats(), because the EEPROM already held the data.
+   */
+  uint32_t avoidedPrograms();
+
+  /** Return the number of bytes written since the last resetStats().
+   */
+  uint32_t bytesWritten();
+
+  /** Return the number of bytes read since the last resetStats().
+   */
+  uint32_t bytesRead();
+
+  /** Return the number of read operations (calls to read_*) since the
+      last resetStats().
+   */
+  uint32_t readOps();
+
+  /** Return the simulated device time spent programming pages since the
+      last resetStats(), in microseconds.
+   */
+  uint64_t deviceTime();
+
+  /** Reset the statistics (but not the per page wear counters).
+   */
+  void resetStats();
+
+  /** Simulate a power loss after a number of bytes programmed.
+
+      Once the given number of bytes are programmed, the following
+      writes are lost, like if the power was cut in the middle of the
+      operation (possibly in the middle of a block or a page).
+
+      A torn write also leaves the byte programmed at the time of the
+      power loss partially programmed: some of its bits are still
+      erased (set to 1).
+
+      @param bytes      bytes still programmed before the power loss
+      @param tear       true to leave the next byte partially programmed
+  */
+  void setPowerCut(uint32_t bytes, bool tear=false);
+
+  /** Return true if a write was lost since setPowerCut().
+   */
+  bool powerLost();
+
+  /** Restore the power: all the following writes are programmed.
+   */
+  void restorePower();
+
+protected:
+  /** Write len bytes, charging the page programs they require. */
+  void program(uint16_t addr, const uint8_t *data, size_t len);
+
+  /** Write only the bytes which differ, charging the page programs
+      they require. */
+  void refresh(uint16_t addr, const uint8_t *data, size_t len);
+
+  /** Consume one byte of the power budget, return false if the power
+      is lost (value is the byte which was going to be programmed at
+      addr). */
+  bool powered(uint16_t addr, uint8_t value);
+
+  /** Copy len bytes from the image, and account for the read. */
+  void fetch(uint16_t addr, uint8_t *data, size_t len);
+
+  uint8_t *m_image;             /** Content of the EEPROM */
+  uint32_t *m_cycles;           /** Erase/write cycles per page */
+  uint16_t m_size;              /** Size of the EEPROM in bytes */
+  uint16_t m_pageSize;          /** Size of one page in bytes */
+  bool m_pageWrite;             /** Program whole pages at once */
+  uint32_t m_programTime;       /** Time to program one page (us) */
+  uint32_t m_splitTime;         /** Time of an erase or write only (us) */
+  bool m_powerCut;              /** A power loss is scheduled */
+  uint32_t m_powerBudget;       /** Bytes programmed before the power loss */
+  bool m_powerLost;             /** Writes were lost */
+  bool m_tear;                  /** The power loss tears a byte */
+  uint32_t m_tearSeed;          /** Generator of the torn bits */
+
+  uint32_t m_programs;
+  uint32_t m_avoidedPrograms;
+  uint32_t m_bytesWritten;
+  uint32_t m_bytesRead;
+  uint32_t m_readOps;
+  uint64_t m_deviceTime;
+
+private:
+  // prohibited...
+  SimEeprom(SimEeprom const&);
+  void operator=(SimEeprom const&);
+
+};
+
+#endif
@@ -0,0 +1,169 @@
+/**
+   SimI2cBus.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "SimI2cBus.h"
+
+#include <string.h>
+
+SimI2cBus::SimI2cBus(uint8_t device, uint16_t size, uint16_t pageSize,
+                     uint8_t bufferSize) :
+  m_device(device),
+  m_size(size),
+  m_pageSize(pageSize),
+  m_bufferSize(bufferSize),
+  m_pointer(0),
+  m_clock(0),
+  m_busyUntil(0),
+  m_writeCycle(SIM_I2C_WRITE_CYCLE_US),
+  m_writeJitter(0),
+  m_byteTime(SIM_I2C_BYTE_US),
+  m_seed(1),
+  m_txAddress(0),
+  m_txLength(0),
+  m_rxLength(0),
+  m_rxIndex(0),
+  m_programs(0),
+  m_nacks(0)
+{
+  uint16_t pages = (m_size + m_pageSize - 1) / m_pageSize;
+  m_memory = new uint8_t[m_size];
+  m_cycles = new uint32_t[pages];
+  m_txBuffer = new uint8_t[m_bufferSize];
+  m_rxBuffer = new uint8_t[m_bufferSize];
+  memset(m_memory, 0xFF, m_size);
+  memset(m_cycles, 0, pages*sizeof(uint32_t));
+}
+
+SimI2cBus::~SimI2cBus()
+{
+  delete[] m_memory;
+  delete[] m_cycles;
+  delete[] m_txBuffer;
+  delete[] m_rxBuffer;
+}
+
+void SimI2cBus::beginTransmission(uint8_t address)
+{
+  m_txAddress = address;
+  m_txLength = 0;
+}
+
+size_t SimI2cBus::write(uint8_t data)
+{
+  if ( m_txLength >= m_bufferSize ) return 0;
+  m_txBuffer[m_txLength++] = data;
+  return 1;
+}
+
+uint8_t SimI2cBus::endTransmission(bool /* stop */)
+{
+  // address byte, then the queued bytes
+  m_clock += m_byteTime;
+  if ( m_txAddress != m_device || m_clock < m_busyUntil ) {
+    m_nacks++;
+    return 2;
+  }
+  m_clock += m_txLength * m_byteTime;
+  if ( m_txLength < 2 ) {
+    // ACK polling (or incomplete address): nothing else happens
+    return 0;
+  }
+
+  m_pointer = ((m_txBuffer[0] << 8) | m_txBuffer[1]) % m_size;
+  if ( m_txLength > 2 ) {
+    // page write: the address rolls over within the page
+    uint16_t page = m_pointer / m_pageSize;
+    uint16_t base = page * m_pageSize;
+    uint16_t offset = m_pointer - base;
+    for (uint8_t i=2; i<m_txLength; i++) {
+      m_memory[base+offset] = m_txBuffer[i];
+      offset = (offset+1) % m_pageSize;
+    }
+    m_pointer = base+offset;
+    m_cycles[page]++;
+    m_programs++;
+    m_busyUntil = m_clock + m_writeCycle;
+    if ( m_writeJitter ) {
+      m_seed = m_seed * 1103515245ul + 12345;
+      m_busyUntil += (m_seed >> 8) % (m_writeJitter+1);
+    }
+  }
+  return 0;
+}
+
+uint8_t SimI2cBus::requestFrom(uint8_t address, uint8_t quantity)
+{
+  m_rxLength = 0;
+  m_rxIndex = 0;
+  m_clock += m_byteTime;
+  if ( address != m_device || m_clock < m_busyUntil ) {
+    m_nacks++;
+    return 0;
+  }
+  if ( quantity > m_bufferSize ) quantity = m_bufferSize;
+  for (uint8_t i=0; i<quantity; i++) {
+    m_rxBuffer[i] = m_memory[m_pointer];
+    m_pointer = (m_pointer+1) % m_size;
+  }
+  m_clock += quantity * m_byteTime;
+  m_rxLength = quantity;
+  return quantity;
+}
+
+int SimI2cBus::read()
+{
+  if ( m_rxIndex >= m_rxLength ) return -1;
+  return m_rxBuffer[m_rxIndex++];
+}
+
+uint8_t SimI2cBus::bufferSize()
+{
+  return m_bufferSize;
+}
+
+unsigned long SimI2cBus::micros()
+{
+  return m_clock;
+}
+
+void SimI2cBus::setWriteCycle(uint32_t us, uint32_t jitterUs)
+{
+  m_writeCycle = us;
+  m_writeJitter = jitterUs;
+}
+
+uint8_t SimI2cBus::peek(uint16_t addr)
+{
+  return ( addr < m_size ) ? m_memory[addr] : 0xFF;
+}
+
+uint32_t SimI2cBus::pagePrograms()
+{
+  return m_programs;
+}
+
+uint32_t SimI2cBus::pageCycles(uint16_t page)
+{
+  if ( page*m_pageSize >= m_size ) return 0;
+  return m_cycles[page];
+}
+
+uint32_t SimI2cBus::nacks()
+{
+  return m_nacks;
+}
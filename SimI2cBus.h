@@ -0,0 +1,138 @@
+/**
+   SimI2cBus.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SimI2cBus_h
+#define SimI2cBus_h
+
+#include "I2cBus.h"
+
+/** Default time to transfer one byte (and its ACK) at 100kHz, in microseconds. */
+#define SIM_I2C_BYTE_US 90
+
+/** Default internal write cycle of the simulated device, in microseconds. */
+#define SIM_I2C_WRITE_CYCLE_US 3000
+
+/**
+   Simulated I2C bus, with a single 24LCxx EEPROM attached, running on the
+   host computer (Linux).
+
+   The device behaves like the 24LC256:
+   - a transmission starts with the 2 bytes of the memory address, followed
+     by the data bytes to write
+   - the data bytes are written in the page buffer: when the end of the
+     page is reached, the address wraps to the start of the same page
+     (overwriting the first bytes written)
+   - after a write, the device does not acknowledge its address during
+     its internal write cycle
+   - reads are sequential from the current address, across the pages
+
+   The bus time is simulated: every byte transferred advances the clock
+   returned by micros(), so the write cycles complete while the master
+   polls the device.
+
+   Documentation of the I2cBus methods is provided by the interface.
+ */
+class SimI2cBus : public I2cBus
+{
+public:
+  /** Create a bus with an erased 24LCxx device.
+      @param device     7 bits address of the device
+      @param size       size of the device in bytes
+      @param pageSize   size of the device page buffer
+      @param bufferSize size of the master transmit/receive buffer
+  */
+  SimI2cBus(uint8_t device=0x50, uint16_t size=32768, uint16_t pageSize=64,
+            uint8_t bufferSize=32);
+
+  ~SimI2cBus();
+
+  void beginTransmission(uint8_t address);
+
+  size_t write(uint8_t data);
+
+  uint8_t endTransmission(bool stop=true);
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+
+  int read();
+
+  uint8_t bufferSize();
+
+  unsigned long micros();
+
+  /** Set the duration of the device internal write cycle.
+
+      Real parts complete most of their write cycles well before the
+      worst case given by the datasheet: with a jitter, each write cycle
+      lasts a pseudo random time between us and us+jitterUs.
+
+      @param us         (shortest) write cycle in microseconds
+      @param jitterUs   variation of the write cycle in microseconds
+  */
+  void setWriteCycle(uint32_t us, uint32_t jitterUs=0);
+
+  /** Return a byte of the device memory, without using the bus.
+   */
+  uint8_t peek(uint16_t addr);
+
+  /** Return the number of page programs (write cycles) of the device.
+   */
+  uint32_t pagePrograms();
+
+  /** Return the number of write cycles endured by one page.
+   */
+  uint32_t pageCycles(uint16_t page);
+
+  /** Return the number of transmissions not acknowledged by the device.
+   */
+  uint32_t nacks();
+
+protected:
+  uint8_t m_device;             /** Address of the simulated device */
+  uint16_t m_size;              /** Size of the device memory */
+  uint16_t m_pageSize;          /** Size of the device page */
+  uint8_t m_bufferSize;         /** Size of the master buffers */
+  uint8_t *m_memory;            /** Content of the device */
+  uint32_t *m_cycles;           /** Write cycles per page */
+
+  uint16_t m_pointer;           /** Current address of the device */
+  unsigned long m_clock;        /** Simulated time (us) */
+  unsigned long m_busyUntil;    /** End of the current write cycle */
+  uint32_t m_writeCycle;
+  uint32_t m_writeJitter;
+  uint32_t m_byteTime;
+  uint32_t m_seed;              /** State of the write cycle jitter */
+
+  uint8_t m_txAddress;
+  uint8_t m_txLength;
+  uint8_t *m_txBuffer;
+  uint8_t m_rxLength;
+  uint8_t m_rxIndex;
+  uint8_t *m_rxBuffer;
+
+  uint32_t m_programs;
+  uint32_t m_nacks;
+
+private:
+  // prohibited...
+  SimI2cBus(SimI2cBus const&);
+  void operator=(SimI2cBus const&);
+
+};
+
+#endif
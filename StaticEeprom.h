@@ -0,0 +1,111 @@
+/**
+   StaticEeprom.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef StaticEeprom_h
+#define StaticEeprom_h
+
+#include "SafeEeprom.h"
+
+/**
+   Size in bytes of the Backend devices known at compile time, so the
+   storage layouts can be checked with static_assert. The value is 0 when
+   the size is only known at runtime (memSize()).
+ */
+template <class Backend>
+struct EepromCapacity
+{
+  static constexpr uint32_t value = 0;
+};
+
+/**
+   Access to the methods of a SafeEeprom backend resolved at compile time.
+
+   The templates of the library (EnduranceEepromT, EepromRing) call the
+   device through this class. With a concrete backend (AvrEeprom,
+   SimEeprom...) the calls are qualified with the class name: they do not
+   go through the virtual table, and the compiler can inline the
+   accessors defined in the header of the backend.
+
+   The specialization for SafeEeprom keeps the virtual calls, so the same
+   templates also work with a device chosen at runtime.
+ */
+template <class Backend>
+struct StaticEeprom
+{
+  static uint8_t read_byte(Backend &ee, uint16_t addr) {
+    return ee.Backend::read_byte(addr);
+  }
+
+  static void write_block(Backend &ee, uint16_t addr, void *data, size_t len) {
+    ee.Backend::write_block(addr, data, len);
+  }
+
+  static void read_block(Backend &ee, uint16_t addr, void *data, size_t len) {
+    ee.Backend::read_block(addr, data, len);
+  }
+
+  static void update_block(Backend &ee, uint16_t addr, void *data, size_t len) {
+    ee.Backend::update_block(addr, data, len);
+  }
+
+  static void fill(Backend &ee, uint16_t addr, uint8_t value, size_t len) {
+    ee.Backend::fill(addr, value, len);
+  }
+
+  static uint16_t memSize(Backend &ee) {
+    return ee.Backend::memSize();
+  }
+
+  static uint16_t pageSize(Backend &ee) {
+    return ee.Backend::pageSize();
+  }
+};
+
+template <>
+struct StaticEeprom<SafeEeprom>
+{
+  static uint8_t read_byte(SafeEeprom &ee, uint16_t addr) {
+    return ee.read_byte(addr);
+  }
+
+  static void write_block(SafeEeprom &ee, uint16_t addr, void *data, size_t len) {
+    ee.write_block(addr, data, len);
+  }
+
+  static void read_block(SafeEeprom &ee, uint16_t addr, void *data, size_t len) {
+    ee.read_block(addr, data, len);
+  }
+
+  static void update_block(SafeEeprom &ee, uint16_t addr, void *data, size_t len) {
+    ee.update_block(addr, data, len);
+  }
+
+  static void fill(SafeEeprom &ee, uint16_t addr, uint8_t value, size_t len) {
+    ee.fill(addr, value, len);
+  }
+
+  static uint16_t memSize(SafeEeprom &ee) {
+    return ee.memSize();
+  }
+
+  static uint16_t pageSize(SafeEeprom &ee) {
+    return ee.pageSize();
+  }
+};
+
+#endif
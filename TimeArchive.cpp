@@ -0,0 +1,201 @@
+/**
+   TimeArchive.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "TimeArchive.h"
+
+#ifdef SERIAL_DEBUG
+#include "HardwareSerial.h"
+#endif
+
+#include <stdlib.h>     // for exit
+#include <string.h>
+
+ConsolidatedSample::ConsolidatedSample(uint8_t channels, uint8_t functions) :
+  DataSample(recordSize(channels, functions)),
+  m_channels(channels),
+  m_functions(functions)
+{
+  // Check the values fit in the record
+  if ( channels > ARCHIVE_CHANNELS ) {
+    exit(-1);
+  }
+  memset(m_codes, 0xFF, sizeof(m_codes));
+}
+
+int8_t ConsolidatedSample::slot(uint8_t function, uint8_t channel)
+{
+  if ( 0 == (m_functions & function) || channel >= m_channels ) {
+    return -1;
+  }
+  // blocks of the functions kept before this one
+  uint8_t block = 0;
+  for (uint8_t f=ARCHIVE_MIN; f<function; f<<=1) {
+    if ( m_functions & f ) block++;
+  }
+  return block*m_channels + channel;
+}
+
+int16_t ConsolidatedSample::value(uint8_t function, uint8_t channel)
+{
+  int8_t i = slot(function, channel);
+  if ( i < 0 ) return CONSOLIDATED_NULL;
+  return (int16_t)(m_codes[i] ^ 0x8000);
+}
+
+void ConsolidatedSample::set(uint8_t function, uint8_t channel, int16_t value)
+{
+  int8_t i = slot(function, channel);
+  if ( i < 0 ) return;
+  if ( value == CONSOLIDATED_NULL ) value--;
+  m_codes[i] = (uint16_t)value ^ 0x8000;
+}
+
+TimeArchive::TimeArchive(TimePermRingBuffer &primary, uint8_t channels) :
+  m_primary(primary),
+  m_channels(channels),
+  m_levels(0)
+{
+  // Check the samples of the primary buffer are made of the channels
+  if ( channels == 0 || channels > ARCHIVE_CHANNELS
+       || primary.dataSize() != channels*sizeof(int16_t) ) {
+    exit(-1);
+  }
+}
+
+bool TimeArchive::addLevel(TimePermRingBuffer &ring, uint16_t steps, uint8_t functions)
+{
+  functions &= ARCHIVE_MIN | ARCHIVE_MAX | ARCHIVE_AVG;
+  if ( m_levels >= ARCHIVE_LEVELS || steps < 2 || functions == 0
+       || ring.dataSize() != ConsolidatedSample::recordSize(m_channels, functions)
+       || (long)ring.period() != (long)steps*m_primary.period() ) {
+    return false;
+  }
+  Level &level = m_level[m_levels++];
+  level.ring = &ring;
+  level.period = ring.period();
+  level.functions = functions;
+  level.count = 0;
+  return true;
+}
+
+bool TimeArchive::insert(DataSample &data, long time)
+{
+  long before = m_primary.lastTimeStamp();
+  if ( ! m_primary.insert(data, time) ) {
+    return false;
+  }
+  if ( time == before ) {
+    // same period: the primary buffer did not insert the sample
+    return true;
+  }
+
+  int16_t values[ARCHIVE_CHANNELS];
+  memcpy(values, data.data(), m_channels*sizeof(int16_t));
+
+  for (uint8_t l=0; l<m_levels; l++) {
+    Level &level = m_level[l];
+    // start of the period of the level (also for negative times)
+    long start = time - ((time % level.period) + level.period) % level.period;
+    if ( level.count > 0 && time < before ) {
+      // back in the past: the primary buffer restarted
+      level.count = 0;
+    }
+    if ( level.count > 0 && start != level.start ) {
+      // the last samples of the previous period were missed
+      flush(level);
+    }
+    if ( level.count == 0 ) {
+      level.start = start;
+      for (uint8_t c=0; c<m_channels; c++) {
+        level.min[c] = values[c];
+        level.max[c] = values[c];
+        level.sum[c] = 0;
+      }
+    }
+    for (uint8_t c=0; c<m_channels; c++) {
+      if ( values[c] < level.min[c] ) level.min[c] = values[c];
+      if ( values[c] > level.max[c] ) level.max[c] = values[c];
+      level.sum[c] += values[c];
+    }
+    level.count++;
+    if ( time + m_primary.period() >= start + level.period ) {
+      // last sample of the period
+      flush(level);
+    }
+  }
+  return true;
+}
+
+void TimeArchive::flush(Level &level)
+{
+  ConsolidatedSample record(m_channels, level.functions);
+  for (uint8_t c=0; c<m_channels; c++) {
+    // average rounded to the nearest
+    int32_t half = level.count/2;
+    int32_t sum = level.sum[c];
+    record.set(ARCHIVE_MIN, c, level.min[c]);
+    record.set(ARCHIVE_MAX, c, level.max[c]);
+    record.set(ARCHIVE_AVG, c, ( sum >= 0 ? sum + half : sum - half ) / level.count);
+  }
+
+  TimePermRingBuffer &ring = *level.ring;
+  long delta = level.start - ring.lastTimeStamp();
+  if ( delta > 0 && delta <= ring.timeSpan() && delta % level.period != 0 ) {
+    // the records of the ring (if any) are not aligned on its period
+    ring.setTimeStamp(level.start - level.period);
+  }
+
+#ifdef SERIAL_DEBUG
+  Serial.print("==== TimeArchive::flush -> period=");
+  Serial.print(level.period, DEC);
+  Serial.print(" start=");
+  Serial.print(level.start, DEC);
+  Serial.print(" samples=");
+  Serial.println(level.count, DEC);
+#endif
+
+  ring.insert(record, level.start);
+  level.count = 0;
+}
+
+uint16_t TimeArchive::storageSize()
+{
+  uint16_t size = m_primary.storageSize();
+  for (uint8_t l=0; l<m_levels; l++) {
+    size += m_level[l].ring->storageSize();
+  }
+  return size;
+}
+
+float TimeArchive::insertsPerSample()
+{
+  float inserts = 1;
+  for (uint8_t l=0; l<m_levels; l++) {
+    inserts += (float)m_primary.period() / m_level[l].period;
+  }
+  return inserts;
+}
+
+float TimeArchive::bytesPerSample()
+{
+  float bytes = m_primary.dataSize();
+  for (uint8_t l=0; l<m_levels; l++) {
+    bytes += (float)m_level[l].ring->dataSize() * m_primary.period() / m_level[l].period;
+  }
+  return bytes;
+}
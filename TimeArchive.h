@@ -0,0 +1,221 @@
+/**
+   TimeArchive.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TimeArchive_h
+#define TimeArchive_h
+
+#include <stdint.h>
+
+#include "TimePermRingBuffer.h"
+
+/** Largest number of consolidated levels of a TimeArchive. */
+#ifndef ARCHIVE_LEVELS
+#define ARCHIVE_LEVELS 3
+#endif
+
+/** Largest number of channels of the samples of a TimeArchive. */
+#ifndef ARCHIVE_CHANNELS
+#define ARCHIVE_CHANNELS 4
+#endif
+
+/** Consolidation functions of a level (to combine with |). */
+#define ARCHIVE_MIN 0x01
+#define ARCHIVE_MAX 0x02
+#define ARCHIVE_AVG 0x04
+
+/** Value of a record missing from a level (erased EEPROM), never used
+    by the records written: the larger values are clamped below it. */
+#define CONSOLIDATED_NULL INT16_MAX
+
+/**
+   Record of a consolidated level: for each function of the level (in
+   the order min, max, avg), one int16_t value per channel.
+
+   The values are stored with their sign bit inverted, so the erased
+   EEPROM (0xFFFF) reads as CONSOLIDATED_NULL rather than as -1.
+ */
+class ConsolidatedSample : public DataSample
+{
+public:
+  /** Create a record (missing until its values are set).
+      @param channels   number of channels, up to ARCHIVE_CHANNELS
+      @param functions  ARCHIVE_MIN, ARCHIVE_MAX and/or ARCHIVE_AVG
+   */
+  ConsolidatedSample(uint8_t channels, uint8_t functions);
+
+  /** Return the size of a record. */
+  static constexpr uint8_t recordSize(uint8_t channels, uint8_t functions) {
+    return 2*channels*( (functions & ARCHIVE_MIN ? 1 : 0)
+                        + (functions & ARCHIVE_MAX ? 1 : 0)
+                        + (functions & ARCHIVE_AVG ? 1 : 0) );
+  }
+
+  void *data() {
+    return (void *)m_codes;
+  }
+
+  /** Return true if the record was written (not skipped by its level).
+   */
+  bool valid() {
+    return m_codes[0] != 0xFFFF;
+  }
+
+  /** Return the value of a function for a channel.
+      @return           CONSOLIDATED_NULL for a missing record, or if the
+                        level does not keep the function
+   */
+  int16_t value(uint8_t function, uint8_t channel);
+
+  int16_t min(uint8_t channel) {
+    return value(ARCHIVE_MIN, channel);
+  }
+
+  int16_t max(uint8_t channel) {
+    return value(ARCHIVE_MAX, channel);
+  }
+
+  int16_t avg(uint8_t channel) {
+    return value(ARCHIVE_AVG, channel);
+  }
+
+  /** Set the value of a function for a channel, clamped below
+      CONSOLIDATED_NULL. Nothing is done if the function is not kept.
+   */
+  void set(uint8_t function, uint8_t channel, int16_t value);
+
+protected:
+  /** Return the index of the value of a function for a channel, -1 if
+      the function is not kept. */
+  int8_t slot(uint8_t function, uint8_t channel);
+
+  uint8_t m_channels;
+  uint8_t m_functions;
+  uint16_t m_codes[3*ARCHIVE_CHANNELS];  /** Values, sign bit inverted */
+};
+
+/**
+   Multi-resolution time series (round robin archive).
+
+   A primary TimePermRingBuffer keeps the samples at full resolution for
+   a short time span, and consolidated levels keep the minimum, maximum
+   and/or average of the samples over longer periods for longer spans:
+
+     TimePermRingBuffer minutes(ee, 0, 60, 4, 60);             // 1 hour
+     TimePermRingBuffer tenMinutes(ee, minutes.storageSize(), 36,
+         ConsolidatedSample::recordSize(2, ARCHIVE_MIN|ARCHIVE_MAX|ARCHIVE_AVG),
+         600);                                                 // 6 hours
+     TimeArchive archive(minutes, 2);
+     archive.addLevel(tenMinutes, 10, ARCHIVE_MIN|ARCHIVE_MAX|ARCHIVE_AVG);
+     ...
+     archive.insert(sample, now);
+
+   The samples are seen as int16_t channels (like QuantizedSample<16, N>
+   codes, or CompressedRingBuffer samples). Each level accumulates the
+   samples inserted in the primary buffer in RAM (minimum, maximum and sum
+   per channel), and inserts its record in its own ring buffer when its
+   period is complete: the consolidation never reads the EEPROM. The
+   record of a period is stamped with the start of the period, the
+   periods are aligned on multiples of the level period.
+
+   When samples are missed, the record of the period holds the samples
+   inserted. The accumulators are only kept in RAM (45 bytes per level on
+   an AVR): after a restart, the record of a current period is computed
+   with the samples inserted after the restart, and a period left
+   incomplete by the previous run has no record (null values).
+ */
+class TimeArchive
+{
+public:
+  /** Create an archive.
+      @param primary    timed ring buffer receiving the samples
+      @param channels   number of int16_t channels of a sample
+   */
+  TimeArchive(TimePermRingBuffer &primary, uint8_t channels);
+
+  /** Add a consolidated level.
+      @param ring       timed ring buffer receiving the records, whose
+                        period is steps periods of the primary buffer, and
+                        data size ConsolidatedSample::recordSize()
+      @param steps      primary periods consolidated by a record
+      @param functions  ARCHIVE_MIN, ARCHIVE_MAX and/or ARCHIVE_AVG
+      @return           false if the level does not match, or if there
+                        are already ARCHIVE_LEVELS levels
+   */
+  bool addLevel(TimePermRingBuffer &ring, uint16_t steps, uint8_t functions);
+
+  /** Insert a sample in the primary buffer, and consolidate it.
+      @return           true if the primary buffer inserted the sample
+   */
+  bool insert(DataSample &data, long time);
+
+  /** Return the number of levels.
+   */
+  uint8_t levels() {
+    return m_levels;
+  }
+
+  /** Return the ring buffer of a level, 0 for the primary buffer.
+   */
+  TimePermRingBuffer &ring(uint8_t level) {
+    return level == 0 ? m_primary : *m_level[level-1].ring;
+  }
+
+  /** Return the EEPROM used by the primary buffer and all the levels.
+   */
+  uint16_t storageSize();
+
+  /** Return the ring buffer inserts per sample inserted, 1 for the
+      primary buffer plus 1/steps for each level.
+   */
+  float insertsPerSample();
+
+  /** Return the bytes of records written per sample inserted (the
+      sample, and the fraction of a record of each level), without the
+      indexes and time stamps of the ring buffers.
+   */
+  float bytesPerSample();
+
+protected:
+  /** Consolidation state of a level */
+  struct Level {
+    TimePermRingBuffer *ring;
+    long period;                /** Period of the records */
+    uint8_t functions;
+    uint16_t count;             /** Samples accumulated */
+    long start;                 /** Start of the period accumulated */
+    int16_t min[ARCHIVE_CHANNELS];
+    int16_t max[ARCHIVE_CHANNELS];
+    int32_t sum[ARCHIVE_CHANNELS];
+  };
+
+  /** Insert the record of the samples accumulated by a level. */
+  void flush(Level &level);
+
+  TimePermRingBuffer &m_primary;
+  uint8_t m_channels;
+  uint8_t m_levels;
+  Level m_level[ARCHIVE_LEVELS];
+
+private:
+  // prohibited...
+  TimeArchive(TimeArchive const&);
+  void operator=(TimeArchive const&);
+
+};
+
+#endif
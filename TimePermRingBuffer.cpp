@@ -6,19 +6,24 @@
 #include <HardwareSerial.h>
 #endif
 
-TimePermRingBuffer::TimePermRingBuffer(uint16_t startAddr, uint16_t bufferSize,
-                                       size_t dataSize, int timePeriod,
-                                       uint16_t endurFactor) :
-  EepromRingBuffer(startAddr, bufferSize, dataSize, endurFactor),
+TimePermRingBuffer::TimePermRingBuffer(SafeEeprom &ee, uint16_t startAddr,
+                                       uint16_t bufferSize, size_t dataSize,
+                                       int timePeriod, uint16_t endurFactor,
+                                       bool gapMarker) :
+  EepromRingBuffer(ee, startAddr, bufferSize, dataSize, endurFactor, gapMarker),
   m_period(timePeriod),
-  m_lastTimeStamp(startAddr+storageSize(), endurFactor, sizeof(long))
+  m_lastTimeStamp(ee, startAddr+EepromRingBuffer::storageSize(),
+                  endurFactor, sizeof(long))
 {
-  // long time;
-  // m_lastTimeStamp.readData((void *)&time);
-  // if ( 0xFFFFFFFFl == time ) {
-  //   time = INT32_MIN;
-  //   m_lastTimeStamp.writeData((void *)&time);
-  // }
+  // the only read of the time stamp: the RAM copy is kept up to date
+  if ( ! m_lastTimeStamp.readData((void *)&m_time) || -1 == m_time ) {
+    // never written (erased EEPROM) or corrupted: restart the buffer
+#ifdef SERIAL_DEBUG
+    Serial.println("------ no valid time stamp -> clear");
+#endif
+    clear();
+    saveTimeStamp(TIMEPERM_NO_TIME);
+  }
 }
 
 int TimePermRingBuffer::period()
@@ -32,14 +37,26 @@ long TimePermRingBuffer::timeSpan()
 }
 
 void TimePermRingBuffer::setTimeStamp(long ts)
+{
+  saveTimeStamp(ts);
+}
+
+void TimePermRingBuffer::saveTimeStamp(long ts)
 {
   m_lastTimeStamp.writeData((void *)&ts);
+  m_time = ts;
 }
 
 bool TimePermRingBuffer::insert(DataSample &data, long current_time)
 {
   long last_time, delta, steps;
-  m_lastTimeStamp.readData((void*)&last_time);
+  last_time = m_time;
+  if ( TIMEPERM_NO_TIME == last_time ) {
+    // first sample of the buffer
+    saveTimeStamp(current_time);
+    push(data.data());
+    return true;
+  }
   delta = current_time - last_time;
 
 #ifdef SERIAL_DEBUG
@@ -60,7 +77,7 @@ bool TimePermRingBuffer::insert(DataSample &data, long current_time)
     Serial.println("------ back to the past -> clear");
 #endif
     clear();
-    m_lastTimeStamp.writeData((void*)&current_time);
+    saveTimeStamp(current_time);
     push(data.data());
     return true;
   }
@@ -71,7 +88,7 @@ bool TimePermRingBuffer::insert(DataSample &data, long current_time)
     Serial.println("------ elapsed time greater than buffer time span -> clear");
 #endif
     clear();
-    m_lastTimeStamp.writeData((void*)&current_time);
+    saveTimeStamp(current_time);
     push(data.data());
   }
   else {
@@ -87,7 +104,7 @@ bool TimePermRingBuffer::insert(DataSample &data, long current_time)
 #endif
           rotate(steps-1);
         }
-        m_lastTimeStamp.writeData((void*)&current_time);
+        saveTimeStamp(current_time);
         push(data.data());
       }      
     }
@@ -104,10 +121,7 @@ bool TimePermRingBuffer::insert(DataSample &data, long current_time)
 long TimePermRingBuffer::read(int index, DataSample &data)
 {
   get(index, (void*)data.data());
-  long time;
-  m_lastTimeStamp.readData((void*)&time);
-  time -= ( index % bufferSize() ) * m_period;
-  return time;
+  return m_time - ( index % bufferSize() ) * m_period;
 }
 
 uint16_t TimePermRingBuffer::storageSize()
@@ -117,7 +131,12 @@ uint16_t TimePermRingBuffer::storageSize()
 
 long TimePermRingBuffer::lastTimeStamp()
 {
-  long time;
-  m_lastTimeStamp.readData((void *)&time);
-  return time;
+  return m_time;
+}
+
+TimePermRingBuffer::Iterator::Iterator(TimePermRingBuffer &buffer, bool reverse) :
+  EepromRingBuffer::Iterator(buffer, reverse),
+  m_lastTime(buffer.lastTimeStamp()),
+  m_period(buffer.period())
+{
 }
@@ -4,6 +4,11 @@
 #include "EepromRingBuffer.h"
 #include "DataSample.h"
 
+#include <limits.h>
+
+/** Last time stamp of a timed ring buffer holding no sample */
+#define TIMEPERM_NO_TIME LONG_MIN
+
 /**
    TimePermRingBuffer is a ring buffer, augmented with concept of
    timestamped elements, implemented with EEPROM.
@@ -23,20 +28,34 @@
    the elapsed time is larger than the deined period, the buffer is
    rotated (null values are inserted for the missing elements)
    accordingly.
+
+   The last time stamp is read from the EEPROM once, by the constructor:
+   insert(), read() and lastTimeStamp() use a copy kept in RAM, so an
+   insert rejected because the period did not elapse costs no EEPROM
+   access. When the time stamp read is not valid (erased EEPROM, or CRC
+   mismatch), the buffer is cleared and its time stamp set to
+   TIMEPERM_NO_TIME: the next insert starts the buffer again.
+
+   With gapMarker, the missing elements are not written: the range of
+   skipped elements is recorded with the index of the ring buffer (see
+   EepromRingBuffer), so catching up after a long downtime costs the
+   same few EEPROM writes as a regular insert. The reads return 0xFF for
+   the missing elements in both modes.
  */
 class TimePermRingBuffer : public EepromRingBuffer
 {
 public:
-  TimePermRingBuffer(uint16_t startAddr, uint16_t bufferSize,
+  TimePermRingBuffer(SafeEeprom &ee, uint16_t startAddr, uint16_t bufferSize,
                      size_t dataSize, int timePeriod,
-                     uint16_t endurFactor=8);
+                     uint16_t endurFactor=8, bool gapMarker=false);
 
   bool insert(DataSample &data, long time);
 
   long read(int index, DataSample &data);
 
   /** Return the time stamp of the last element push in the buffer. 
-      @return timestamp in arbitrary units
+      @return timestamp in arbitrary units, TIMEPERM_NO_TIME if the
+              buffer holds no sample
    */
   long lastTimeStamp();
 
@@ -59,9 +78,55 @@ public:
 
   uint16_t storageSize();
 
+  /** Return the storage size of a timed ring buffer, usable at compile
+      time (see the constructor for the parameters).
+   */
+  static constexpr uint16_t layoutSize(uint16_t bufferSize, size_t dataSize,
+                                       uint16_t endurFactor=8,
+                                       bool gapMarker=false) {
+    return EepromRingBuffer::layoutSize(bufferSize, dataSize, endurFactor, gapMarker)
+      + EnduranceEepromBase::layoutSize(endurFactor, sizeof(long));
+  }
+
+  /**
+     Sequential access to the samples of the buffer, with their time
+     stamps.
+   */
+  class Iterator : public EepromRingBuffer::Iterator
+  {
+  public:
+    /** Start an iteration.
+        @param buffer     timed ring buffer to read
+        @param reverse    true to start with the newest sample
+     */
+    Iterator(TimePermRingBuffer &buffer, bool reverse=false);
+
+    /** Read the next sample.
+        @param data       sample receiving the data read
+        @return           false when all the samples were visited
+     */
+    bool next(DataSample &data) {
+      return EepromRingBuffer::Iterator::next(data.data());
+    }
+
+    /** Return the time stamp of the sample returned by next().
+     */
+    long time() {
+      return m_lastTime - (long)m_index*m_period;
+    }
+
+  protected:
+    long m_lastTime;              /** Time stamp of the newest sample */
+    int m_period;
+  };
+
 protected:
+  /** Write the last time stamp to the EEPROM and to its RAM copy. */
+  void saveTimeStamp(long ts);
+
   int m_period;
   EnduranceEeprom m_lastTimeStamp;
+  long m_time;                  /** RAM copy of the last time stamp */
 
 };
 
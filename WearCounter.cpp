@@ -0,0 +1,175 @@
+/**
+   WearCounter.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "WearCounter.h"
+
+/** Size of the blocks read to compare the updates. */
+#define WEAR_READ_CHUNK 16
+
+WearCounter::WearCounter(SafeEeprom &ee, uint32_t *counters, uint16_t pages,
+                         uint16_t startAddr, bool pageWrite) :
+  m_eeprom(ee),
+  m_counters(counters),
+  m_pages(pages),
+  m_pageSize(ee.pageSize()),
+  m_pageWrite(pageWrite)
+{
+  m_firstPage = startAddr / m_pageSize;
+  reset();
+}
+
+void WearCounter::write_byte(uint16_t addr, uint8_t data)
+{
+  count(addr, &data, sizeof(data), 1, false);
+  m_eeprom.write_byte(addr, data);
+}
+
+uint8_t WearCounter::read_byte(uint16_t addr)
+{
+  return m_eeprom.read_byte(addr);
+}
+
+void WearCounter::write_word(uint16_t addr, uint16_t data)
+{
+  count(addr, (uint8_t *)&data, sizeof(data), 1, false);
+  m_eeprom.write_word(addr, data);
+}
+
+uint16_t WearCounter::read_word(uint16_t addr)
+{
+  return m_eeprom.read_word(addr);
+}
+
+void WearCounter::write_long(uint16_t addr, uint32_t data)
+{
+  count(addr, (uint8_t *)&data, sizeof(data), 1, false);
+  m_eeprom.write_long(addr, data);
+}
+
+uint32_t WearCounter::read_long(uint16_t addr)
+{
+  return m_eeprom.read_long(addr);
+}
+
+void WearCounter::write_block(uint16_t addr, void* data, size_t len)
+{
+  count(addr, (uint8_t *)data, len, 1, false);
+  m_eeprom.write_block(addr, data, len);
+}
+
+void WearCounter::read_block(uint16_t addr, void* data, size_t len)
+{
+  m_eeprom.read_block(addr, data, len);
+}
+
+void WearCounter::update_byte(uint16_t addr, uint8_t data)
+{
+  count(addr, &data, sizeof(data), 1, true);
+  m_eeprom.update_byte(addr, data);
+}
+
+void WearCounter::update_word(uint16_t addr, uint16_t data)
+{
+  count(addr, (uint8_t *)&data, sizeof(data), 1, true);
+  m_eeprom.update_word(addr, data);
+}
+
+void WearCounter::update_long(uint16_t addr, uint32_t data)
+{
+  count(addr, (uint8_t *)&data, sizeof(data), 1, true);
+  m_eeprom.update_long(addr, data);
+}
+
+void WearCounter::update_block(uint16_t addr, void* data, size_t len)
+{
+  count(addr, (uint8_t *)data, len, 1, true);
+  m_eeprom.update_block(addr, data, len);
+}
+
+void WearCounter::fill(uint16_t addr, uint8_t value, size_t len)
+{
+  count(addr, &value, len, 0, true);
+  m_eeprom.fill(addr, value, len);
+}
+
+uint16_t WearCounter::memSize()
+{
+  return m_eeprom.memSize();
+}
+
+uint16_t WearCounter::pageSize()
+{
+  return m_pageSize;
+}
+
+void WearCounter::show(uint16_t start, int len)
+{
+  m_eeprom.show(start, len);
+}
+
+uint32_t WearCounter::pageCycles(uint16_t page)
+{
+  if ( page < m_firstPage || page - m_firstPage >= m_pages ) return 0;
+  return m_counters[page - m_firstPage];
+}
+
+uint32_t WearCounter::maxPageCycles()
+{
+  uint32_t max = 0;
+  for (uint16_t i=0; i<m_pages; i++) {
+    if ( m_counters[i] > max ) max = m_counters[i];
+  }
+  return max;
+}
+
+void WearCounter::reset()
+{
+  for (uint16_t i=0; i<m_pages; i++) {
+    m_counters[i] = 0;
+  }
+}
+
+void WearCounter::count(uint16_t addr, const uint8_t *data, size_t len,
+                        uint8_t stride, bool update)
+{
+  // out of bound writes are dropped by the devices
+  if ( len == 0 || (uint32_t)addr + len > m_eeprom.memSize() ) return;
+
+  uint8_t current[WEAR_READ_CHUNK];
+  uint16_t lastPage = 0xFFFF;   // no page programmed yet
+  for (size_t i=0; i<len; i++) {
+    if ( update ) {
+      if ( i % WEAR_READ_CHUNK == 0 ) {
+        size_t chunk = ( len-i < WEAR_READ_CHUNK ) ? len-i : WEAR_READ_CHUNK;
+        m_eeprom.read_block(addr+i, (void *)current, chunk);
+      }
+      if ( current[i % WEAR_READ_CHUNK] == *data ) {
+        data += stride;
+        continue;
+      }
+    }
+    data += stride;
+    uint16_t page = (addr+i) / m_pageSize;
+    if ( page < m_firstPage || page - m_firstPage >= m_pages ) continue;
+    // a page buffer absorbs all the bytes falling in the same page
+    if ( ! m_pageWrite || page != lastPage ) {
+      m_counters[page - m_firstPage]++;
+      lastPage = page;
+    }
+  }
+}
@@ -0,0 +1,172 @@
+/**
+   WearCounter.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WearCounter_h
+#define WearCounter_h
+
+#include "SafeEeprom.h"
+
+/** Erase/write cycles a page of EEPROM endures (AVR datasheet). */
+#ifndef EEPROM_ENDURANCE
+#define EEPROM_ENDURANCE 100000
+#endif
+
+/**
+   Counter of the erase/write cycles of the EEPROM pages, placed in front
+   of another SafeEeprom.
+
+   SimEeprom counts the cycles of every page on the host computer.
+   WearCounter does the same on the board, for the range of pages given
+   to the constructor (one counter of RAM per page): the writes count
+   every byte programmed, the updates and fills only the bytes which
+   change (the current content is read before). As with SimEeprom, a
+   device with pageWrite programs a page once per call, otherwise each
+   byte programmed is one cycle of its page.
+
+   The counters start at 0 when the WearCounter is created: they measure
+   the wear of the writes done since, typically to estimate the lifetime
+   of the structures with projectWear().
+
+   Documentation of the SafeEeprom methods is provided by the interface.
+ */
+class WearCounter : public SafeEeprom
+{
+public:
+  /** Count the cycles of a range of pages.
+      @param ee         EEPROM actually storing the data
+      @param counters   one counter per page watched
+      @param pages      number of pages watched
+      @param startAddr  address in the first page watched [default=0]
+      @param pageWrite  true if the device programs a page at once
+   */
+  WearCounter(SafeEeprom &ee, uint32_t *counters, uint16_t pages,
+              uint16_t startAddr=0, bool pageWrite=false);
+
+  void write_byte(uint16_t addr, uint8_t data);
+
+  uint8_t read_byte(uint16_t addr);
+
+  void write_word(uint16_t addr, uint16_t data);
+
+  uint16_t read_word(uint16_t addr);
+
+  void write_long(uint16_t addr, uint32_t data);
+
+  uint32_t read_long(uint16_t addr);
+
+  void write_block(uint16_t addr, void* data, size_t len);
+
+  void read_block(uint16_t addr, void* data, size_t len);
+
+  void update_byte(uint16_t addr, uint8_t data);
+
+  void update_word(uint16_t addr, uint16_t data);
+
+  void update_long(uint16_t addr, uint32_t data);
+
+  void update_block(uint16_t addr, void* data, size_t len);
+
+  void fill(uint16_t addr, uint8_t value, size_t len);
+
+  uint16_t memSize();
+
+  uint16_t pageSize();
+
+  void show(uint16_t start=0, int len=-1);
+
+  /** Return the cycles counted for a page (0 if it is not watched).
+      @param page       page number (address / pageSize)
+   */
+  uint32_t pageCycles(uint16_t page);
+
+  /** Return the cycles of the most worn page watched.
+   */
+  uint32_t maxPageCycles();
+
+  /** Restart all the counters from 0.
+   */
+  void reset();
+
+protected:
+  /** Count the cycles of the pages programmed by a write of len bytes
+      (stride 0 repeats the same byte, for a fill). Only the bytes which
+      differ from the EEPROM are counted for an update. */
+  void count(uint16_t addr, const uint8_t *data, size_t len, uint8_t stride, bool update);
+
+  SafeEeprom &m_eeprom;         /** Device storing the data */
+  uint32_t *m_counters;         /** Cycles per page watched */
+  uint16_t m_firstPage;         /** First page watched */
+  uint16_t m_pages;             /** Number of pages watched */
+  uint16_t m_pageSize;
+  bool m_pageWrite;             /** A page is programmed once per write */
+
+private:
+  // prohibited...
+  WearCounter(WearCounter const&);
+  void operator=(WearCounter const&);
+
+};
+
+/** Lifetime projection of a data structure. */
+struct WearProjection {
+  uint16_t page;                /** Most worn page of the structure */
+  uint32_t cycles;              /** Cycles of this page */
+  float cyclesPerWrite;         /** Cycles of this page per logical write */
+  float days;                   /** Lifetime (negative if no cycle counted) */
+};
+
+/**
+   Project the lifetime of a data structure (EnduranceEeprom,
+   EepromRingBuffer, TimePermRingBuffer...) from the cycles counted by a
+   Meter (WearCounter or SimEeprom) during a number of logical writes
+   (writeData, push, insert...).
+
+   The lifetime is the number of days a new EEPROM takes to wear out the
+   most used page of the structure, at the given write rate. The pages
+   shared with other structures also count the wear of the neighbors.
+
+   @param meter         cycles counter
+   @param structure     structure providing startAddr() and storageSize()
+   @param writes        logical writes done during the measure
+   @param writesPerDay  expected write rate of the application
+   @param endurance     cycles a page endures [default=EEPROM_ENDURANCE]
+ */
+template <class Meter, class Structure>
+WearProjection projectWear(Meter &meter, Structure &structure, uint32_t writes,
+                           float writesPerDay, uint32_t endurance=EEPROM_ENDURANCE)
+{
+  WearProjection projection = { 0, 0, 0.0f, -1.0f };
+  uint16_t pageSize = meter.pageSize();
+  uint16_t first = structure.startAddr() / pageSize;
+  uint16_t last = (structure.startAddr() + structure.storageSize() - 1) / pageSize;
+  projection.page = first;
+  for (uint16_t page=first; page<=last; page++) {
+    uint32_t cycles = meter.pageCycles(page);
+    if ( cycles > projection.cycles ) {
+      projection.cycles = cycles;
+      projection.page = page;
+    }
+  }
+  if ( writes > 0 && projection.cycles > 0 ) {
+    projection.cyclesPerWrite = (float)projection.cycles / writes;
+    projection.days = endurance / (projection.cyclesPerWrite * writesPerDay);
+  }
+  return projection;
+}
+
+#endif
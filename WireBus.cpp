@@ -0,0 +1,57 @@
+/**
+   WireBus.cpp is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "WireBus.h"
+
+void WireBus::beginTransmission(uint8_t address)
+{
+  Wire.beginTransmission(address);
+}
+
+size_t WireBus::write(uint8_t data)
+{
+  return Wire.write(data);
+}
+
+uint8_t WireBus::endTransmission(bool stop)
+{
+  return Wire.endTransmission(stop);
+}
+
+uint8_t WireBus::requestFrom(uint8_t address, uint8_t quantity)
+{
+  return Wire.requestFrom(address, quantity);
+}
+
+int WireBus::read()
+{
+  return Wire.read();
+}
+
+uint8_t WireBus::bufferSize()
+{
+  return BUFFER_LENGTH;
+}
+
+unsigned long WireBus::micros()
+{
+  return ::micros();
+}
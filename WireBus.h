@@ -0,0 +1,64 @@
+/**
+   WireBus.h is part of EepromUtils.
+
+   Copyright (c) 2011 Lorenzo Flueckiger
+
+   EepromUtils is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   EepromUtils is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with EepromUtils. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WireBus_h
+#define WireBus_h
+
+#include "I2cBus.h"
+
+/**
+   I2C bus of the Arduino board, accessed with the Wire library.
+
+   The Wire library must be initialized (Wire.begin()) before use.
+
+   Documentation of each method is provided by the interface I2cBus.
+ */
+class WireBus : public I2cBus
+{
+public:
+  static WireBus &instance() {
+    static WireBus bus;
+    return bus;
+  }
+
+  void beginTransmission(uint8_t address);
+
+  size_t write(uint8_t data);
+
+  uint8_t endTransmission(bool stop=true);
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+
+  int read();
+
+  uint8_t bufferSize();
+
+  unsigned long micros();
+
+private:
+  WireBus() {
+    // cannot call externally
+  }
+
+  // prohibited...
+  WireBus(WireBus const&);
+  void operator=(WireBus const&);
+
+};
+
+#endif
@@ -1,4 +1,4 @@
-#include "SafeEeprom.h"
+#include "AvrEeprom.h"
 
 #include "Arduino.h"
 
@@ -6,8 +6,9 @@ int main(void)
 {
   init();
 
-  for (uint16_t i=0; i<SafeEeprom::memSize(); i++) {
-    SafeEeprom::write_byte(i, 0xFF);
+  AvrEeprom &ee = AvrEeprom::instance();
+  for (uint16_t i=0; i<ee.memSize(); i++) {
+    ee.write_byte(i, 0xFF);
   }
 
   return 0;
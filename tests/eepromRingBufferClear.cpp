@@ -11,6 +11,7 @@
 #include "eepromRingBufferTest.h"
 
 #include "EnduranceEeprom.h"
+#include "AvrEeprom.h"
 
 int main(void)
 {
@@ -21,7 +22,7 @@ int main(void)
     + BUFFER_SZ * DATA_SZ;
 
   for (uint16_t i=START_ADDR; i<START_ADDR+size; i++) {
-    SafeEeprom::write_byte(i, 0xFF);
+    AvrEeprom::instance().write_byte(i, 0xFF);
   }
   
   return 0;
@@ -8,7 +8,7 @@
 
 #include <Arduino.h>
 
-EepromRingBuffer ring(START_ADDR, BUFFER_SZ, DATA_SZ, ENDURANCE);
+EepromRingBuffer ring(AvrEeprom::instance(), START_ADDR, BUFFER_SZ, DATA_SZ, ENDURANCE);
 int number;
 
 uint16_t index(int i)
@@ -47,7 +47,7 @@ void setup()
   Serial.println(ring.bufferSize(), DEC);
 #ifndef NDEBUG
   Serial.println("==== Initial Eeprom State ====");
-  SafeEeprom::show(START_ADDR, ring.storageSize());  
+  AvrEeprom::instance().show(START_ADDR, ring.storageSize());  
 #endif
 }
 
@@ -65,7 +65,7 @@ void loop()
   }
 
 #ifndef NDEBUG
-  SafeEeprom::show(START_ADDR, ring.storageSize());
+  AvrEeprom::instance().show(START_ADDR, ring.storageSize());
 #endif
 
   Serial.print("---- ring buffer index=");
@@ -4,6 +4,6 @@
 #define DATA_SZ 2
 
 #include "EepromRingBuffer.h"
-#include "SafeEeprom.h"
+#include "AvrEeprom.h"
 
 
@@ -25,14 +25,14 @@
    since the overhead is negligible compared to the burning time itself.
 
   */
-#include "SafeEeprom.h"
+#include "AvrEeprom.h"
 
 #include <avr/eeprom.h>
 #include <HardwareSerial.h>
 #include <Arduino.h>
 
 const unsigned int size = sizeof(long);
-const unsigned int length = (SafeEeprom::memSize()+1)/size;
+const unsigned int length = (E2END+1)/size;
 
 void printElapsed(unsigned int start, unsigned long stop,
                   unsigned long ops, const char *str)
@@ -65,7 +65,7 @@ int main(void)
 
   start=millis();
   for (unsigned int i=0; i<length; i++) {
-    SafeEeprom::write_long(i*4, value);
+    AvrEeprom::instance().write_long(i*4, value);
   }
   stop=millis();
   printElapsed(start, stop, length, " safe writes: ");
@@ -85,7 +85,7 @@ int main(void)
   start=millis();
   for (int k=0; k<10; k++) {
     for (unsigned int i=0; i<length; i++) {
-      value = SafeEeprom::read_long(i*4);
+      value = AvrEeprom::instance().read_long(i*4);
       tmp = value % 10;
     }
   }
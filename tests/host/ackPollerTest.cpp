@@ -0,0 +1,104 @@
+/**
+   Host test of AckPoller against the simulated 24LC256 of SimI2cBus:
+   completion time histogram, timeout, and write latency of a long
+   sample dump compared to the fixed delay(6) of 24LC256_Eeprom.c.
+*/
+
+#include "hostTest.h"
+
+#include "SimI2cBus.h"
+#include "AckPoller.h"
+#include "I2cEeprom.h"
+
+#define FIXED_DELAY_US 6000
+
+void startWrite(SimI2cBus &bus, uint16_t addr)
+{
+  bus.beginTransmission(0x50);
+  bus.write(addr >> 8);
+  bus.write(addr & 0xFF);
+  bus.write(0x42);
+  bus.endTransmission();
+}
+
+void testHistogram()
+{
+  SimI2cBus bus;
+  bus.setWriteCycle(1500, 3000);
+  AckPoller poller(bus, 0x50, 10000, 500);
+
+  for (uint16_t i=0; i<200; i++) {
+    startWrite(bus, i*64);
+    CHECK(poller.wait());
+  }
+  CHECK_EQUAL(200, poller.completions());
+  CHECK_EQUAL(0, poller.timeouts());
+  CHECK(poller.maxTime() <= 4500+2*SIM_I2C_BYTE_US);
+  CHECK(poller.averageTime() >= 1500);
+
+  // nothing completes before the shortest write cycle
+  uint32_t total = 0;
+  printf("write cycle histogram (bin = %u us):\n", poller.binWidth());
+  for (uint8_t i=0; i<ACK_POLLER_BINS; i++) {
+    if ( i < 3 ) CHECK_EQUAL(0, poller.bin(i));
+    total += poller.bin(i);
+    printf("  [%5u-%5u[ : %u\n", i*poller.binWidth(), (i+1)*poller.binWidth(), poller.bin(i));
+  }
+  CHECK_EQUAL(200, total);
+  printf("average %lu us, max %lu us\n", poller.averageTime(), poller.maxTime());
+
+  poller.resetStats();
+  CHECK_EQUAL(0, poller.completions());
+  CHECK_EQUAL(0, poller.maxTime());
+}
+
+void testTimeout()
+{
+  SimI2cBus bus;
+  bus.setWriteCycle(5000);
+  AckPoller poller(bus, 0x50);
+  CHECK_EQUAL(ACK_POLLER_TIMEOUT_US, poller.timeout());
+
+  poller.setTimeout(2000);
+  startWrite(bus, 0);
+  unsigned long start = bus.micros();
+  CHECK(! poller.wait());
+  CHECK(bus.micros() - start >= 2000);
+  CHECK(bus.micros() - start < 2500);
+  CHECK_EQUAL(1, poller.timeouts());
+  CHECK_EQUAL(0, poller.completions());
+
+  poller.setTimeout(10000);
+  CHECK(poller.wait());
+  CHECK_EQUAL(1, poller.completions());
+}
+
+void testDumpLatency()
+{
+  SimI2cBus bus;
+  bus.setWriteCycle(1500, 3000);
+  I2cEeprom ee(bus);
+
+  uint8_t samples[4096];
+  for (uint16_t i=0; i<sizeof(samples); i++) samples[i] = i;
+
+  unsigned long start = bus.micros();
+  ee.write_block(0, (void *)samples, sizeof(samples));
+  unsigned long polled = bus.micros() - start;
+
+  // same transfers, but waiting a fixed delay after each chunk
+  uint32_t chunks = ee.poller().completions();
+  unsigned long fixed = polled - ee.poller().averageTime()*chunks + FIXED_DELAY_US*chunks;
+  printf("4KB dump: %u chunks, %lu us with ACK polling, ~%lu us with delay(6)\n",
+         chunks, polled, fixed);
+  CHECK_EQUAL(0, ee.timeouts());
+  CHECK(polled < fixed);
+}
+
+int main(void)
+{
+  testHistogram();
+  testTimeout();
+  testDumpLatency();
+  return hostTestReport("ackPollerTest");
+}
@@ -0,0 +1,124 @@
+/**
+   Host test of CachedEeprom: the content seen through the cache must
+   always match a plain RAM model, and the page programs needed by the
+   ring buffer operations are reported with and without the cache.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "CachedEeprom.h"
+#include "EepromRingBuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZE 512
+
+void testConsistency(bool pageWrite)
+{
+  SimEeprom ee(SIZE, 4, pageWrite);
+  uint8_t model[SIZE];
+  memset(model, 0xFF, SIZE);
+  srand(42);
+  {
+    CachedEeprom cache(ee);
+    for (int op=0; op<20000; op++) {
+      uint16_t addr = rand() % (SIZE-8);
+      uint8_t block[8];
+      switch ( rand() % 5 ) {
+      case 0:
+        cache.write_byte(addr, rand());
+        model[addr] = cache.read_byte(addr);
+        break;
+      case 1: {
+        uint32_t v = rand();
+        cache.write_long(addr, v);
+        memcpy(model+addr, &v, sizeof(v));
+        break;
+      }
+      case 2: {
+        uint8_t len = 1 + rand() % 8;
+        for (uint8_t i=0; i<len; i++) block[i] = rand();
+        cache.write_block(addr, block, len);
+        memcpy(model+addr, block, len);
+        break;
+      }
+      case 3:
+        cache.read_block(addr, block, 8);
+        CHECK(memcmp(block, model+addr, 8) == 0);
+        break;
+      default:
+        CHECK_EQUAL(*(uint16_t *)(model+addr), cache.read_word(addr));
+        if ( rand() % 50 == 0 ) cache.flush();
+      }
+    }
+  }
+  // the destructor flushed everything
+  uint8_t image[SIZE];
+  ee.read_block(0, image, SIZE);
+  CHECK(memcmp(image, model, SIZE) == 0);
+}
+
+void testMerge()
+{
+  SimEeprom ee(64, 4, true);
+  CachedEeprom cache(ee);
+  for (uint16_t i=0; i<16; i++) cache.write_byte(i, i);
+  CHECK_EQUAL(0, ee.pagePrograms());
+  CHECK_EQUAL(12, cache.mergedWrites());
+  cache.flush();
+  CHECK_EQUAL(4, ee.pagePrograms());
+  CHECK_EQUAL(4, cache.writeBacks());
+  // clean pages are not written again
+  cache.flush();
+  CHECK_EQUAL(4, ee.pagePrograms());
+  CHECK_EQUAL(5, cache.read_byte(5));
+}
+
+void report(const char *name, bool pageWrite)
+{
+  SimEeprom direct(1024, 4, pageWrite);
+  SimEeprom cached(1024, 4, pageWrite);
+  CachedEeprom cache(cached);
+  EepromRingBuffer directRing(direct, 0, 128, 4, 4);
+  EepromRingBuffer cachedRing(cache, 0, 128, 4, 4);
+  for (uint32_t i=0; i<128; i++) {
+    directRing.push((void *)&i);
+    cachedRing.push((void *)&i);
+  }
+  cache.flush();
+  direct.resetStats();
+  cached.resetStats();
+
+  directRing.clear();
+  cachedRing.clear();
+  cache.flush();
+  printf("%-10s clear       : %6u page programs direct, %6u cached\n",
+         name, direct.pagePrograms(), cached.pagePrograms());
+  CHECK(cached.pagePrograms() <= direct.pagePrograms());
+
+  for (uint32_t i=0; i<128; i++) {
+    directRing.push((void *)&i);
+    cachedRing.push((void *)&i);
+  }
+  cache.flush();
+  direct.resetStats();
+  cached.resetStats();
+  directRing.rotate(50);
+  cachedRing.rotate(50);
+  cache.flush();
+  printf("%-10s rotate(50)  : %6u page programs direct, %6u cached\n",
+         name, direct.pagePrograms(), cached.pagePrograms());
+  CHECK(cached.pagePrograms() <= direct.pagePrograms());
+}
+
+int main(void)
+{
+  testConsistency(false);
+  testConsistency(true);
+  testMerge();
+  report("byte write", false);
+  report("page write", true);
+  return hostTestReport("cachedEepromTest");
+}
@@ -0,0 +1,203 @@
+/**
+   Check CompressedRingBuffer against a reference history of slowly
+   varying sensor values, and compare it with TimePermRingBuffer on the
+   same EEPROM size: number of samples held, bytes written and time per
+   insert (encode), time and EEPROM reads per read() and per sample of an
+   Iterator (decode).
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimEeprom.h"
+#include "CompressedRingBuffer.h"
+#include "TimePermRingBuffer.h"
+
+#define BUDGET 1000
+#define PERIOD 60
+#define SAMPLES 20000
+
+/** Sample of up to 3 channels: temperature, humidity, pressure. */
+class SensorSample : public DataSample
+{
+public:
+  SensorSample(uint8_t channels) : DataSample(channels*sizeof(int16_t)) {
+    memset(m_values, 0, sizeof(m_values));
+  }
+  void *data() { return (void *)m_values; }
+  int16_t m_values[3];
+};
+
+/** Slowly varying values, with a larger jump from time to time. */
+static void sense(SensorSample &sample, int n)
+{
+  static const int16_t base[3] = { 2150, 4500, 10130 };
+  for (int c=0; c<sample.size()/2; c++) {
+    if ( n == 0 ) sample.m_values[c] = base[c];
+    int step = ( rand() % 50 == 0 ) ? rand() % 2001 - 1000 : rand() % 7 - 3;
+    sample.m_values[c] += step;
+  }
+}
+
+/** History inserted, to check the buffer. */
+struct History {
+  long time[SAMPLES];
+  int16_t values[SAMPLES][3];
+  int n;
+};
+
+static bool same(SensorSample &sample, const int16_t *values)
+{
+  return memcmp(sample.m_values, values, sample.size()) == 0;
+}
+
+/** Check read() and the Iterator against the newest samples of history. */
+static void check(CompressedRingBuffer &ring, History &h, uint8_t channels)
+{
+  SensorSample sample(channels);
+  uint16_t count = ring.count();
+  CHECK(count > 0);
+  CHECK(count <= h.n);
+  CHECK_EQUAL(h.time[h.n-1], ring.lastTimeStamp());
+  int errors = 0;
+  for (uint16_t i=0; i<count && errors<5; i++) {
+    long t = ring.read(i, sample);
+    if ( t != h.time[h.n-1-i] || ! same(sample, h.values[h.n-1-i]) ) {
+      printf("read(%u): time %ld for %ld\n", i, t, h.time[h.n-1-i]);
+      errors++;
+    }
+  }
+  CHECK_EQUAL(0, errors);
+  // past the oldest sample: null sample, time extrapolated
+  long t = ring.read(count+2, sample);
+  CHECK_EQUAL(h.time[h.n-count] - 3*PERIOD, t);
+  CHECK_EQUAL(-1, sample.m_values[0]);
+
+  CompressedRingBuffer::Iterator it(ring);
+  int i = h.n-count;
+  while ( it.next(sample) ) {
+    if ( i >= h.n || it.time() != h.time[i] || ! same(sample, h.values[i]) ) {
+      CHECK(false);
+      break;
+    }
+    i++;
+  }
+  CHECK_EQUAL(h.n, i);
+}
+
+void testHistory(uint8_t channels, uint8_t frameSize)
+{
+  static History h;
+  SimEeprom ee(1024);
+  SensorSample sample(channels);
+  h.n = 0;
+  srand(channels*frameSize);
+  {
+    CompressedRingBuffer ring(ee, 16, BUDGET, sample.size(), PERIOD, frameSize);
+    CHECK_EQUAL(0, ring.count());
+    long t = 5000;
+    for (int n=0; n<3000; n++) {
+      sense(sample, n);
+      // missed samples, late and early inserts
+      int r = rand() % 100;
+      t += ( r == 0 ) ? 7*PERIOD : ( r == 1 ) ? 500*PERIOD : PERIOD;
+      if ( r == 2 ) CHECK(! ring.insert(sample, t - PERIOD/2));
+      CHECK(ring.insert(sample, t));
+      h.time[h.n] = t;
+      memcpy(h.values[h.n], sample.m_values, sample.size());
+      h.n++;
+      if ( n % 500 == 499 ) check(ring, h, channels);
+    }
+  }
+
+  // the newest frame and the last sample are recovered from the EEPROM
+  CompressedRingBuffer ring(ee, 16, BUDGET, sample.size(), PERIOD, frameSize);
+  check(ring, h, channels);
+  for (int n=0; n<100; n++) {
+    sense(sample, 1);
+    CHECK(ring.insert(sample, h.time[h.n-1] + PERIOD));
+    h.time[h.n] = h.time[h.n-1] + PERIOD;
+    memcpy(h.values[h.n], sample.m_values, sample.size());
+    h.n++;
+  }
+  check(ring, h, channels);
+
+  // back in the past: the buffer restarts
+  CHECK(ring.insert(sample, 10));
+  CHECK_EQUAL(1, ring.count());
+  CHECK_EQUAL(10, ring.lastTimeStamp());
+}
+
+void bench(uint8_t channels, uint8_t frameSize)
+{
+  SensorSample sample(channels);
+  uint16_t size = sample.size();
+
+  // largest TimePermRingBuffer in the budget
+  uint16_t fixedSize = BUDGET/size;
+  while ( TimePermRingBuffer::layoutSize(fixedSize, size) > BUDGET ) fixedSize--;
+  SimEeprom eeFixed(1024);
+  TimePermRingBuffer fixed(eeFixed, 16, fixedSize, size, PERIOD);
+  SimEeprom eeCompressed(1024);
+  CompressedRingBuffer compressed(eeCompressed, 16, BUDGET, size, PERIOD, frameSize);
+
+  double fixedNs = 0, compressedNs = 0;
+  eeFixed.resetStats();
+  eeCompressed.resetStats();
+  srand(7);
+  long t = 0;
+  for (int n=0; n<SAMPLES; n++) {
+    sense(sample, n);
+    t += PERIOD;
+    double start = now();
+    fixed.insert(sample, t);
+    double middle = now();
+    compressed.insert(sample, t);
+    compressedNs += now() - middle;
+    fixedNs += middle - start;
+  }
+  uint16_t held = compressed.count();
+  CHECK(held > fixedSize);
+  double fixedBytes = (double)eeFixed.bytesWritten()/SAMPLES;
+  double compressedBytes = (double)eeCompressed.bytesWritten()/SAMPLES;
+
+  // decode: random reads, and a whole dump
+  const int reads = 2000;
+  eeCompressed.resetStats();
+  double start = now();
+  for (int n=0; n<reads; n++) compressed.read(rand() % held, sample);
+  double readNs = (now()-start)/reads;
+  uint32_t readOps = eeCompressed.readOps()/reads;
+  eeCompressed.resetStats();
+  start = now();
+  CompressedRingBuffer::Iterator it(compressed);
+  int visited = 0;
+  while ( it.next(sample) ) visited++;
+  CHECK_EQUAL(held, visited);
+  double iterNs = (now()-start)/visited;
+  double iterBytes = (double)eeCompressed.bytesRead()/visited;
+
+  printf("%u channel(s), frame %3u: %4u samples (%5.1f h) vs %4u fixed (%5.1f h) x%.2f\n",
+         channels, frameSize, held, held*PERIOD/3600.0,
+         fixedSize, fixedSize*PERIOD/3600.0, (double)held/fixedSize);
+  printf("  insert %5.0f ns, %4.2f bytes written (fixed %5.0f ns, %4.2f bytes)\n",
+         compressedNs/SAMPLES, compressedBytes, fixedNs/SAMPLES, fixedBytes);
+  printf("  read() %6.0f ns, %3u read ops; Iterator %4.0f ns, %4.2f bytes read per sample\n",
+         readNs, readOps, iterNs, iterBytes);
+}
+
+int main(void)
+{
+  testHistory(1, 64);
+  testHistory(3, 64);
+  testHistory(1, 32);
+  testHistory(3, 128);
+  bench(1, 32);
+  bench(1, 64);
+  bench(1, 128);
+  bench(3, 64);
+  bench(3, 128);
+  return hostTestReport("compressedRingBench");
+}
@@ -0,0 +1,493 @@
+/**
+   Crash consistency of the persistent structures.
+
+   For each structure, a random workload is run once on a reference
+   SimEeprom to record the state after every operation. The workload is
+   then replayed on a fresh device with the power cut after every
+   possible number of bytes programmed (in the middle of the blocks and of
+   the pages, on byte and page programming devices, with and without a
+   torn byte). The structures are then re-constructed on the device, and
+   their state must be:
+
+   - EnduranceEeprom (packed or planned layout): the data of the last or
+     of the interrupted write
+   - ring buffers: the index of the last or of the interrupted operation,
+     and the elements not overwritten by the operation are intact
+   - TimePermRingBuffer in EepromJournal transactions: exactly the state
+     before or after the interrupted insert
+   - CompressedRingBuffer: the newest samples and time stamp before or
+     after the interrupted insert
+
+   The recovered structures must also keep working: a few more operations
+   are run, and the state must be the same once re-constructed again.
+   The time spent to recover (reads from the device) is reported.
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimEeprom.h"
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+#include "EepromRing.h"
+#include "EepromJournal.h"
+#include "TimePermRingBuffer.h"
+#include "CompressedRingBuffer.h"
+
+#define EE_SIZE 512
+#define EE_PAGE 8
+#define OPS 30
+#define MAX_VALUES 24
+
+/** One operation of a workload, generated before the runs. */
+struct Op {
+  uint8_t type;
+  uint16_t arg;
+  long value;
+};
+
+/** What is visible of a structure. */
+struct State {
+  int count;
+  long values[MAX_VALUES];
+
+  bool operator==(const State &o) const {
+    return count == o.count && memcmp(values, o.values, count*sizeof(long)) == 0;
+  }
+};
+
+/**
+   A structure under test: created on a device (which runs its recovery),
+   it runs operations and exposes its state.
+ */
+class Subject
+{
+public:
+  virtual ~Subject() {}
+
+  /** Generate a random operation. */
+  virtual Op generate(int i) = 0;
+
+  /** Run an operation. */
+  virtual void run(const Op &op) = 0;
+
+  /** Read the visible state. */
+  virtual void capture(State &state) = 0;
+
+  /** Return true if the state found after a power loss during op is
+      acceptable, given the states before and after op. */
+  virtual bool consistent(const Op & /* op */, const State &before,
+                          const State &after, const State &found) {
+    return found == before || found == after;
+  }
+};
+
+/** Create a Subject on a device. */
+typedef Subject *(*Factory)(SafeEeprom &ee);
+
+class EnduranceSubject : public Subject
+{
+public:
+  EnduranceSubject(SafeEeprom &ee, EnduranceEeprom::Recovery recovery) :
+    m_endurance(ee, 16, 5, 6, recovery) {}
+
+  EnduranceSubject(SafeEeprom &ee, const EnduranceEeprom::Layout &layout) :
+    m_endurance(ee, 16, 5, 6, layout, EnduranceEeprom::BINARY_SEARCH) {}
+
+  Op generate(int /* i */) {
+    Op op = { 0, 0, (long)rand() };
+    return op;
+  }
+
+  void run(const Op &op) {
+    uint8_t data[6];
+    for (int i=0; i<6; i++) data[i] = op.value >> (4*i);
+    m_endurance.writeData((void *)data);
+  }
+
+  void capture(State &state) {
+    uint8_t data[6];
+    state.count = 7;
+    state.values[6] = m_endurance.readData((void *)data);
+    for (int i=0; i<6; i++) state.values[i] = data[i];
+  }
+
+  EnduranceEeprom m_endurance;
+};
+
+Subject *linearEndurance(SafeEeprom &ee)
+{
+  return new EnduranceSubject(ee, EnduranceEeprom::LINEAR_SCAN);
+}
+
+Subject *binaryEndurance(SafeEeprom &ee)
+{
+  return new EnduranceSubject(ee, EnduranceEeprom::BINARY_SEARCH);
+}
+
+Subject *alignedEndurance(SafeEeprom &ee)
+{
+  return new EnduranceSubject(ee, EnduranceEeprom::planLayout(16, 5, 6, EE_PAGE));
+}
+
+/** Operations of the ring buffers. */
+enum RingOp { PUSH, PUSH_MANY, ROTATE, CLEAR };
+
+/** Ring buffer operations, and the elements they may overwrite. */
+class RingSubject : public Subject
+{
+public:
+  Op generate(int i) {
+    int r = rand() % 20;
+    Op op;
+    op.value = i*100;
+    if ( r < 11 ) {
+      op.type = PUSH;
+      op.arg = 1;
+    }
+    else if ( r < 15 ) {
+      op.type = PUSH_MANY;
+      op.arg = rand() % (2*size());
+    }
+    else if ( r < 19 ) {
+      op.type = ROTATE;
+      op.arg = rand() % (size()+2);
+    }
+    else {
+      op.type = CLEAR;
+      op.arg = 0;
+    }
+    return op;
+  }
+
+  /** The index is the old or the new one, and with the old index, the
+      elements which were not overwritten are intact. */
+  bool consistent(const Op &op, const State &before,
+                  const State &after, const State &found) {
+    if ( found == after ) return true;
+    if ( found.values[0] != before.values[0] ) return false;
+    int overwritten = ( op.type == CLEAR || op.arg >= size() ) ? size() : op.arg;
+    for (int i=1; i<=size()-overwritten; i++) {
+      if ( found.values[i] != before.values[i] ) return false;
+    }
+    return true;
+  }
+
+  /** The state is the index then the elements from the newest. */
+  virtual int size() = 0;
+};
+
+class RingBufferSubject : public RingSubject
+{
+public:
+  RingBufferSubject(SafeEeprom &ee) : m_ring(ee, 24, 10, sizeof(int16_t), 3) {}
+
+  int size() {
+    return 10;
+  }
+
+  void run(const Op &op) {
+    int16_t batch[20];
+    int16_t value = op.value;
+    switch ( op.type ) {
+    case PUSH:
+      m_ring.push((void *)&value);
+      break;
+    case PUSH_MANY:
+      for (int i=0; i<op.arg; i++) batch[i] = op.value + i;
+      m_ring.pushMany((void *)batch, op.arg);
+      break;
+    case ROTATE:
+      m_ring.rotate(op.arg);
+      break;
+    default:
+      m_ring.clear();
+    }
+  }
+
+  void capture(State &state) {
+    state.count = 1 + size();
+    state.values[0] = m_ring.currentIndex();
+    for (int i=0; i<size(); i++) {
+      int16_t value;
+      m_ring.get(i, (void *)&value);
+      state.values[1+i] = value;
+    }
+  }
+
+  EepromRingBuffer m_ring;
+};
+
+Subject *ringBuffer(SafeEeprom &ee)
+{
+  return new RingBufferSubject(ee);
+}
+
+class RingSubjectT : public RingSubject
+{
+public:
+  RingSubjectT(SafeEeprom &ee) : m_ring(ee, 40) {}
+
+  int size() {
+    return 8;
+  }
+
+  void run(const Op &op) {
+    int16_t batch[16];
+    switch ( op.type ) {
+    case PUSH:
+      m_ring.push(op.value);
+      break;
+    case PUSH_MANY:
+      for (int i=0; i<op.arg; i++) batch[i] = op.value + i;
+      m_ring.pushMany(batch, op.arg);
+      break;
+    case ROTATE:
+      m_ring.rotate(op.arg);
+      break;
+    default:
+      m_ring.clear();
+    }
+  }
+
+  void capture(State &state) {
+    state.count = 1 + size();
+    state.values[0] = m_ring.currentIndex();
+    for (int i=0; i<size(); i++) {
+      int16_t value;
+      m_ring.get(i, value);
+      state.values[1+i] = value;
+    }
+  }
+
+  EepromRing<int16_t, 8, 4> m_ring;
+};
+
+Subject *typedRing(SafeEeprom &ee)
+{
+  return new RingSubjectT(ee);
+}
+
+#define PERIOD 10
+
+class JournaledSubject : public Subject
+{
+public:
+  JournaledSubject(SafeEeprom &ee) :
+    m_journal(ee, 0, 76),
+    m_timed(m_journal, 100, 8, sizeof(int16_t), PERIOD, 4),
+    m_time(1000) {}
+
+  Op generate(int i) {
+    // mostly on time, some gaps, late or early inserts, and restarts
+    static const int steps[] = { 1, 1, 1, 1, 2, 3, 0, 20, -3 };
+    Op op;
+    op.type = 0;
+    op.arg = i;
+    m_time += steps[rand() % 9] * PERIOD + ( rand() % 6 == 0 ? PERIOD/2 : 0 );
+    op.value = m_time;
+    return op;
+  }
+
+  void run(const Op &op) {
+    ShortSample sample;
+    sample.m_value = op.arg;
+    m_journal.begin();
+    m_timed.insert(sample, op.value);
+    m_journal.commit();
+  }
+
+  void capture(State &state) {
+    ShortSample sample;
+    state.count = 2 + 8;
+    state.values[0] = m_timed.lastTimeStamp();
+    state.values[1] = m_timed.currentIndex();
+    for (int i=0; i<8; i++) {
+      m_timed.read(i, sample);
+      state.values[2+i] = sample.m_value;
+    }
+  }
+
+  EepromJournal m_journal;
+  TimePermRingBuffer m_timed;
+  long m_time;
+};
+
+Subject *journaledTimed(SafeEeprom &ee)
+{
+  return new JournaledSubject(ee);
+}
+
+class CompressedSubject : public Subject
+{
+public:
+  CompressedSubject(SafeEeprom &ee) :
+    m_ring(ee, 0, 8*32, sizeof(int16_t), PERIOD, 32),
+    m_time(1000),
+    m_value(0) {}
+
+  Op generate(int /* i */) {
+    // slowly varying values, some gaps and early inserts
+    static const int steps[] = { 1, 1, 1, 1, 1, 2, 3, 0, 20 };
+    Op op;
+    op.type = 0;
+    m_value += ( rand() % 8 == 0 ) ? rand() % 2000 - 1000 : rand() % 5 - 2;
+    op.arg = m_value;
+    m_time += steps[rand() % 9] * PERIOD + ( rand() % 6 == 0 ? PERIOD/2 : 0 );
+    op.value = m_time;
+    return op;
+  }
+
+  void run(const Op &op) {
+    ShortSample sample;
+    sample.m_value = op.arg;
+    m_ring.insert(sample, op.value);
+  }
+
+  void capture(State &state) {
+    // the newest samples only: starting a frame drops the oldest one
+    ShortSample sample;
+    state.count = 1 + 2*4;
+    state.values[0] = m_ring.lastTimeStamp();
+    for (int i=0; i<4; i++) {
+      state.values[1+2*i] = m_ring.read(i, sample);
+      state.values[2+2*i] = sample.m_value;
+    }
+  }
+
+  CompressedRingBuffer m_ring;
+  long m_time;
+  int16_t m_value;
+};
+
+Subject *compressedRing(SafeEeprom &ee)
+{
+  return new CompressedSubject(ee);
+}
+
+/** Recovery statistics of one structure. */
+struct Report {
+  int cuts;
+  int olds;
+  int news;
+  int others;                   /** accepted, but neither old nor new */
+  int failures;
+  uint32_t maxReads;
+  uint32_t maxBytes;
+  double maxUs;
+  double totalUs;
+};
+
+/** Run the workload of a structure with all the possible power cuts. */
+static void crash(const char *name, Factory factory, unsigned seed,
+                  bool pageWrite, bool tear, Report &report)
+{
+  // reference run
+  Op ops[OPS];
+  State states[OPS+1];
+  uint32_t written;
+  {
+    SimEeprom ee(EE_SIZE, EE_PAGE, pageWrite);
+    Subject *subject = factory(ee);
+    srand(seed);
+    for (int i=0; i<OPS; i++) ops[i] = subject->generate(i);
+    subject->capture(states[0]);
+    ee.resetStats();
+    for (int i=0; i<OPS; i++) {
+      subject->run(ops[i]);
+      subject->capture(states[i+1]);
+    }
+    written = ee.bytesWritten();
+    delete subject;
+  }
+
+  for (uint32_t cut=0; cut<written; cut++) {
+    SimEeprom ee(EE_SIZE, EE_PAGE, pageWrite);
+    Subject *subject = factory(ee);
+    ee.setPowerCut(cut, tear);
+    int op = 0;
+    while ( op < OPS ) {
+      subject->run(ops[op]);
+      if ( ee.powerLost() ) break;
+      op++;
+    }
+    delete subject;
+    ee.restorePower();
+    if ( op == OPS ) break;       // all the writes were done
+    report.cuts++;
+
+    // restart
+    ee.resetStats();
+    double start = now();
+    subject = factory(ee);
+    double us = (now() - start)/1000;
+    report.totalUs += us;
+    if ( us > report.maxUs ) report.maxUs = us;
+    if ( ee.readOps() > report.maxReads ) report.maxReads = ee.readOps();
+    if ( ee.bytesRead() > report.maxBytes ) report.maxBytes = ee.bytesRead();
+
+    State found;
+    subject->capture(found);
+    if ( found == states[op] ) report.olds++;
+    else if ( found == states[op+1] ) report.news++;
+    else if ( subject->consistent(ops[op], states[op], states[op+1], found) ) report.others++;
+    else {
+      if ( report.failures == 0 ) {
+        printf("%s: seed %u, cut after %u bytes in operation %d: inconsistent state\n",
+               name, seed, cut, op);
+      }
+      report.failures++;
+    }
+
+    // the recovered structure keeps working
+    for (int i=op+1; i<OPS && i<op+4; i++) subject->run(ops[i]);
+    State live, reloaded;
+    subject->capture(live);
+    delete subject;
+    subject = factory(ee);
+    subject->capture(reloaded);
+    delete subject;
+    if ( ! (live == reloaded) ) {
+      if ( report.failures == 0 ) {
+        printf("%s: seed %u, cut after %u bytes: state lost after recovery\n",
+               name, seed, cut);
+      }
+      report.failures++;
+    }
+  }
+}
+
+static void crashAll(const char *name, Factory factory)
+{
+  for (int pageWrite=0; pageWrite<2; pageWrite++) {
+    for (int tear=0; tear<2; tear++) {
+      Report report;
+      memset(&report, 0, sizeof(report));
+      for (unsigned seed=1; seed<=4; seed++) {
+        crash(name, factory, seed, pageWrite, tear, report);
+      }
+      printf("%-16s %-4s %-5s %5d cuts: %5d old %5d new %4d partial %3d failed;"
+             " recovery max %3u reads %4u bytes %6.1f us (avg %5.1f us)\n",
+             name, pageWrite ? "page" : "byte", tear ? "torn" : "clean",
+             report.cuts, report.olds, report.news, report.others, report.failures,
+             report.maxReads, report.maxBytes, report.maxUs,
+             report.cuts ? report.totalUs/report.cuts : 0.0);
+      CHECK_EQUAL(0, report.failures);
+      CHECK(report.cuts > 0);
+    }
+  }
+}
+
+int main(void)
+{
+  crashAll("Endurance/linear", linearEndurance);
+  crashAll("Endurance/binary", binaryEndurance);
+  crashAll("Endurance/plan", alignedEndurance);
+  crashAll("EepromRingBuffer", ringBuffer);
+  crashAll("EepromRing", typedRing);
+  crashAll("TimePerm/journal", journaledTimed);
+  crashAll("CompressedRing", compressedRing);
+  return hostTestReport("crashTest");
+}
@@ -0,0 +1,49 @@
+/**
+   Check that the three CRC16 implementations compute the same CRC, and
+   report their speed in bytes per microsecond on the host computer.
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+
+#include "Crc16.h"
+
+#define DATA_SIZE 4096
+#define LOOPS 500
+
+template <class Impl>
+uint16_t check(const char *name, const uint8_t *data)
+{
+  // check value of the CRC-16/MODBUS (same polynomial and start value)
+  CHECK_EQUAL(0x4B37, Impl::block(0xFFFF, "123456789", 9));
+
+  // byte per byte and block computations agree
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i=0; i<1001; i++) crc = Impl::update(crc, data[i]);
+  CHECK_EQUAL(crc, Impl::block(0xFFFF, data, 1001));
+
+  volatile uint16_t sink = 0;
+  double start = now();
+  for (int n=0; n<LOOPS; n++) {
+    sink = sink + Impl::block(0xFFFF, data, DATA_SIZE);
+  }
+  double elapsed = now() - start;
+  printf("%-13s %8.1f bytes/us\n", name, (double)DATA_SIZE*LOOPS*1000/elapsed);
+  return Impl::block(0xFFFF, data, DATA_SIZE);
+}
+
+int main(void)
+{
+  static uint8_t data[DATA_SIZE];
+  srand(14);
+  for (uint16_t i=0; i<DATA_SIZE; i++) data[i] = rand();
+
+  uint16_t bitwise = check<Crc16Bitwise>("Crc16Bitwise", data);
+  uint16_t nibble = check<Crc16Nibble>("Crc16Nibble", data);
+  uint16_t table = check<Crc16Table>("Crc16Table", data);
+  CHECK_EQUAL(bitwise, nibble);
+  CHECK_EQUAL(bitwise, table);
+  CHECK_EQUAL(bitwise, Crc16::block(0xFFFF, data, DATA_SIZE));
+  return hostTestReport("crc16Bench");
+}
@@ -0,0 +1,145 @@
+/**
+   Compare the read path of the structures through the virtual SafeEeprom
+   interface (EnduranceEeprom, EepromRingBuffer) and through the
+   compile-time backend (EnduranceEepromT, EepromRing).
+
+   RamEeprom defines all its accessors in the class, as AvrEeprom does
+   over the avr/eeprom.h functions: only the static path lets the
+   compiler inline them. On the host, the time measured is the cost of
+   the dispatch itself (virtual call against inlined accessor), not of
+   the EEPROM accesses. Both paths must read the same values
+   from the same EEPROM layout; the time per operation is reported.
+*/
+
+#include "hostTest.h"
+
+#include <string.h>
+
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+#include "EepromRing.h"
+
+#define RAM_SIZE 2048
+#define LOOPS 200000
+
+class RamEeprom : public SafeEeprom
+{
+public:
+  RamEeprom() { memset(m_data, 0xFF, sizeof(m_data)); }
+  void write_byte(uint16_t addr, uint8_t data) { if ( addr < RAM_SIZE ) m_data[addr] = data; }
+  uint8_t read_byte(uint16_t addr) { return m_data[addr]; }
+  void write_word(uint16_t addr, uint16_t data) { write_block(addr, &data, sizeof(data)); }
+  uint16_t read_word(uint16_t addr) { uint16_t d; read_block(addr, &d, sizeof(d)); return d; }
+  void write_long(uint16_t addr, uint32_t data) { write_block(addr, &data, sizeof(data)); }
+  uint32_t read_long(uint16_t addr) { uint32_t d; read_block(addr, &d, sizeof(d)); return d; }
+  void write_block(uint16_t addr, void* data, size_t len) {
+    if ( addr+len <= RAM_SIZE ) memcpy(m_data+addr, data, len);
+  }
+  void read_block(uint16_t addr, void* data, size_t len) { memcpy(data, m_data+addr, len); }
+  void update_byte(uint16_t addr, uint8_t data) { write_byte(addr, data); }
+  void update_word(uint16_t addr, uint16_t data) { write_word(addr, data); }
+  void update_long(uint16_t addr, uint32_t data) { write_long(addr, data); }
+  void update_block(uint16_t addr, void* data, size_t len) { write_block(addr, data, len); }
+  void fill(uint16_t addr, uint8_t value, size_t len) {
+    if ( addr+len <= RAM_SIZE ) memset(m_data+addr, value, len);
+  }
+  uint16_t memSize() { return RAM_SIZE; }
+  uint16_t pageSize() { return 4; }
+  void show(uint16_t start=0, int len=-1) { (void)start; (void)len; }
+
+  uint8_t m_data[RAM_SIZE];
+};
+
+struct Sample {
+  int16_t a;
+  int16_t b;
+};
+
+void benchEndurance()
+{
+  RamEeprom ram;
+  uint32_t value = 0x12345678;
+  uint32_t sumVirtual = 0;
+  uint32_t sumStatic = 0;
+  double tVirtual, tStatic;
+  {
+    EnduranceEeprom endurance(ram, 0, 8, sizeof(value));
+    for (uint8_t i=0; i<11; i++) endurance.writeData((void *)&value);
+    double start = now();
+    for (uint32_t i=0; i<LOOPS; i++) {
+      uint32_t v;
+      endurance.readData((void *)&v);
+      sumVirtual += v;
+    }
+    tVirtual = (now() - start) / LOOPS;
+  }
+  {
+    EnduranceEepromT<RamEeprom> endurance(ram, 0, 8, sizeof(value));
+    double start = now();
+    for (uint32_t i=0; i<LOOPS; i++) {
+      uint32_t v;
+      endurance.readData((void *)&v);
+      sumStatic += v;
+    }
+    tStatic = (now() - start) / LOOPS;
+  }
+  CHECK_EQUAL(sumVirtual, sumStatic);
+  CHECK_EQUAL((uint32_t)(value*LOOPS), sumStatic);
+  printf("EnduranceEeprom::readData  virtual %6.1f ns/op, static %6.1f ns/op\n",
+         tVirtual, tStatic);
+}
+
+void benchRingBuffer()
+{
+  RamEeprom ram;
+  int32_t sumVirtual = 0;
+  int32_t sumStatic = 0;
+  double tVirtual, tStatic;
+  {
+    EepromRingBuffer ring(ram, 256, 64, sizeof(Sample), 4);
+    for (int16_t i=0; i<100; i++) {
+      Sample s = { i, (int16_t)-i };
+      ring.push((void *)&s);
+    }
+    double start = now();
+    for (uint32_t i=0; i<LOOPS; i++) {
+      Sample s;
+      ring.get(i % 64, (void *)&s);
+      sumVirtual += s.a - s.b;
+    }
+    tVirtual = (now() - start) / LOOPS;
+  }
+  {
+    // same layout: reads the samples pushed through EepromRingBuffer
+    RingBufferT<RamEeprom, Sample, 64, 4> ring(ram, 256);
+    CHECK_EQUAL(100 % 64, ring.currentIndex());
+    double start = now();
+    for (uint32_t i=0; i<LOOPS; i++) {
+      Sample s;
+      ring.get(i % 64, s);
+      sumStatic += s.a - s.b;
+    }
+    tStatic = (now() - start) / LOOPS;
+
+    Sample s;
+    ring.get(0, s);
+    CHECK_EQUAL(99, s.a);
+    ring.get(-1, s);
+    CHECK_EQUAL(36, s.a);
+    ring.rotate(3);
+    ring.get(0, s);
+    CHECK_EQUAL(-1, s.a);
+    ring.get(3, s);
+    CHECK_EQUAL(99, s.a);
+  }
+  CHECK_EQUAL(sumVirtual, sumStatic);
+  printf("EepromRingBuffer::get      virtual %6.1f ns/op, static %6.1f ns/op\n",
+         tVirtual, tStatic);
+}
+
+int main(void)
+{
+  benchEndurance();
+  benchRingBuffer();
+  return hostTestReport("dispatchBench");
+}
@@ -0,0 +1,162 @@
+/**
+   Benchmark of the EEPROM operations on the simulated EEPROM.
+
+   For the SafeEeprom accessors, EnduranceEeprom, EepromRingBuffer and
+   TimePermRingBuffer, report per logical operation: the wall time on the
+   host computer, the programming time of the simulated device, the page
+   programs, and the bytes written and read. Two devices are simulated:
+   the AVR internal EEPROM (bytes programmed one by one) and an EEPROM
+   programming 32 bytes pages.
+
+   The results are printed as a table, and also written as CSV to the
+   file given as argument, to track the regressions:
+
+     eepromBench results.csv
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+#include "TimePermRingBuffer.h"
+
+#define LOOPS 2000
+
+/** Where the CSV results go, or NULL. */
+static FILE *csv = NULL;
+
+/** Keeps the values read, so the reads are not optimized away. */
+static volatile uint32_t sink = 0;
+
+/** Run loops times the operation op(i) on ee, and report per operation. */
+template <class Op>
+void bench(const char *device, const char *name, SimEeprom &ee, int loops, Op op)
+{
+  ee.resetStats();
+  double start = now();
+  for (int i=0; i<loops; i++) op(i);
+  double wall = (now() - start) / loops;
+  double deviceUs = (double)ee.deviceTime() / loops;
+  double programs = (double)ee.pagePrograms() / loops;
+  double written = (double)ee.bytesWritten() / loops;
+  double read = (double)ee.bytesRead() / loops;
+  printf("%-5s %-32s %9.1f %10.1f %9.2f %9.2f %9.2f\n", device, name,
+         wall, deviceUs, programs, written, read);
+  if ( csv ) {
+    fprintf(csv, "%s,%s,%d,%.1f,%.1f,%.3f,%.3f,%.3f\n", device, name, loops,
+            wall, deviceUs, programs, written, read);
+  }
+}
+
+/** Same as bench(), but only op(i) is measured: setup(i) prepares the
+    state it runs on. */
+template <class Setup, class Op>
+void bench(const char *device, const char *name, SimEeprom &ee, int loops,
+           Setup setup, Op op)
+{
+  double wall = 0, deviceUs = 0, programs = 0, written = 0, read = 0;
+  for (int i=0; i<loops; i++) {
+    setup(i);
+    ee.resetStats();
+    double start = now();
+    op(i);
+    wall += now() - start;
+    deviceUs += ee.deviceTime();
+    programs += ee.pagePrograms();
+    written += ee.bytesWritten();
+    read += ee.bytesRead();
+  }
+  wall /= loops;
+  deviceUs /= loops;
+  programs /= loops;
+  written /= loops;
+  read /= loops;
+  printf("%-5s %-32s %9.1f %10.1f %9.2f %9.2f %9.2f\n", device, name,
+         wall, deviceUs, programs, written, read);
+  if ( csv ) {
+    fprintf(csv, "%s,%s,%d,%.1f,%.1f,%.3f,%.3f,%.3f\n", device, name, loops,
+            wall, deviceUs, programs, written, read);
+  }
+}
+
+void benchDevice(const char *device, uint16_t pageSize, bool pageWrite)
+{
+  SimEeprom ee(4096, pageSize, pageWrite);
+  SafeEeprom &safe = ee;
+  uint8_t block[16];
+  for (int i=0; i<16; i++) block[i] = i;
+
+  // the SafeEeprom accessors, on changing addresses and values
+  bench(device, "write_byte", ee, LOOPS, [&](int i) {
+      safe.write_byte(i % 1024, i); });
+  bench(device, "read_byte", ee, LOOPS, [&](int i) {
+      sink = sink + safe.read_byte(i % 1024); });
+  bench(device, "write_word", ee, LOOPS, [&](int i) {
+      safe.write_word(2*(i % 512), i); });
+  bench(device, "read_word", ee, LOOPS, [&](int i) {
+      sink = sink + safe.read_word(2*(i % 512)); });
+  bench(device, "write_long", ee, LOOPS, [&](int i) {
+      safe.write_long(4*(i % 256), i); });
+  bench(device, "read_long", ee, LOOPS, [&](int i) {
+      sink = sink + safe.read_long(4*(i % 256)); });
+  bench(device, "write_block(16)", ee, LOOPS, [&](int i) {
+      block[0] = i; safe.write_block(16*(i % 64), block, 16); });
+  bench(device, "read_block(16)", ee, LOOPS, [&](int i) {
+      safe.read_block(16*(i % 64), block, 16); sink = sink + block[0]; });
+  bench(device, "update_block(16) unchanged", ee, LOOPS, [&](int) {
+      safe.read_block(1024, block, 16); safe.update_block(1024, block, 16); });
+  bench(device, "fill(64)", ee, LOOPS, [&](int i) {
+      safe.fill(64*(i % 16), i, 64); });
+
+  // endurance buffer of 8 slots of 4 bytes
+  EnduranceEeprom endurance(ee, 2048, 8, sizeof(uint32_t));
+  bench(device, "EnduranceEeprom::writeData", ee, LOOPS, [&](int i) {
+      uint32_t value = i; endurance.writeData((void *)&value); });
+  bench(device, "EnduranceEeprom::readData", ee, LOOPS, [&](int) {
+      uint32_t value; endurance.readData((void *)&value); sink = sink + value; });
+
+  // ring of 32 longs with an index endurance of 4
+  EepromRingBuffer ring(ee, 2200, 32, sizeof(int32_t), 4);
+  bench(device, "EepromRingBuffer::push", ee, LOOPS, [&](int i) {
+      int32_t value = i; ring.push((void *)&value); });
+  bench(device, "EepromRingBuffer::get", ee, LOOPS, [&](int i) {
+      int32_t value; ring.get(i % 32, (void *)&value); sink = sink + value; });
+  // rotate() over 3 elements holding data, clear() of a full ring
+  int32_t values[32];
+  for (int i=0; i<32; i++) values[i] = i;
+  bench(device, "EepromRingBuffer::rotate(3)", ee, LOOPS/4,
+        [&](int) { ring.pushMany((void *)values, 32); },
+        [&](int) { ring.rotate(3); });
+  bench(device, "EepromRingBuffer::clear", ee, LOOPS/20,
+        [&](int) { ring.pushMany((void *)values, 32); },
+        [&](int) { ring.clear(); });
+
+  // timed ring of 32 longs: one insert per period
+  TimePermRingBuffer timed(ee, 2600, 32, sizeof(int32_t), 10);
+  LongSample sample;
+  bench(device, "TimePermRingBuffer::insert", ee, LOOPS, [&](int i) {
+      sample.m_value = i; timed.insert(sample, 1000 + 10*i); });
+  bench(device, "TimePermRingBuffer::read", ee, LOOPS, [&](int i) {
+      sink = sink + timed.read(i % 32, sample); });
+  CHECK_EQUAL(1000 + 10*(LOOPS-1), timed.lastTimeStamp());
+}
+
+int main(int argc, char **argv)
+{
+  if ( argc > 1 ) {
+    csv = fopen(argv[1], "w");
+    CHECK(csv != NULL);
+    if ( csv ) {
+      fprintf(csv, "device,operation,loops,wall_ns,device_us,page_programs,bytes_written,bytes_read\n");
+    }
+  }
+
+  printf("%-5s %-32s %9s %10s %9s %9s %9s\n", "dev", "operation per call",
+         "wall ns", "device us", "programs", "written", "read");
+  benchDevice("avr", 4, false);
+  benchDevice("page", 32, true);
+
+  if ( csv ) fclose(csv);
+  return hostTestReport("eepromBench");
+}
@@ -0,0 +1,99 @@
+/**
+   Host test of EepromRing: random sequences of push, rotate and get must
+   give the same results as EepromRingBuffer, for a power of two capacity
+   (mask wrapping) and another capacity, and both classes must read the
+   buffers written by the other one.
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+
+#include "SimEeprom.h"
+#include "EepromRingBuffer.h"
+#include "EepromRing.h"
+
+struct Sample {
+  int16_t a;
+  int16_t b;
+};
+
+// the layout is known at compile time
+static_assert(EepromRing<Sample, 16, 4>::STORAGE_SIZE == 16*4 + 4*(4+4),
+              "EepromRing layout");
+static_assert(EepromRing<Sample, 10>::STORAGE_SIZE == 10*4 + 4,
+              "EepromRing layout");
+
+template <uint16_t N, uint16_t ENDURANCE>
+void compare(unsigned seed)
+{
+  SimEeprom eeRing(1024);
+  SimEeprom eeBuffer(1024);
+  EepromRing<Sample, N, ENDURANCE, SimEeprom> ring(eeRing, 32);
+  EepromRingBuffer buffer(eeBuffer, 32, N, sizeof(Sample), ENDURANCE);
+  CHECK_EQUAL(buffer.storageSize(), ring.storageSize());
+  CHECK_EQUAL(buffer.bufferSize(), ring.bufferSize());
+
+  srand(seed);
+  for (int op=0; op<3000; op++) {
+    int r = rand() % 10;
+    if ( r < 6 ) {
+      Sample s = { (int16_t)op, (int16_t)rand() };
+      ring.push(s);
+      buffer.push((void *)&s);
+    }
+    else if ( r < 7 ) {
+      Sample batch[2*N];
+      uint16_t count = rand() % (2*N);
+      for (uint16_t i=0; i<count; i++) {
+        batch[i].a = op;
+        batch[i].b = i;
+      }
+      ring.pushMany(batch, count);
+      buffer.pushMany((void *)batch, count);
+    }
+    else if ( r < 8 ) {
+      uint16_t steps = rand() % (N+2);
+      ring.rotate(steps);
+      buffer.rotate(steps);
+    }
+    else {
+      int index = rand() % (4*N) - 2*N;
+      Sample a, b;
+      ring.get(index, a);
+      buffer.get(index, (void *)&b);
+      CHECK_EQUAL(b.a, a.a);
+      CHECK_EQUAL(b.b, a.b);
+      if ( a.a != b.a ) break;
+    }
+    CHECK_EQUAL(buffer.currentIndex(), ring.currentIndex());
+  }
+
+  // same bytes on the EEPROM
+  for (uint16_t i=32; i<32+ring.storageSize(); i++) {
+    if ( eeRing.read_byte(i) != eeBuffer.read_byte(i) ) {
+      CHECK_EQUAL(eeBuffer.read_byte(i), eeRing.read_byte(i));
+      break;
+    }
+  }
+
+  // each class recovers the buffer of the other one
+  EepromRing<Sample, N, ENDURANCE, SimEeprom> ring2(eeBuffer, 32);
+  EepromRingBuffer buffer2(eeRing, 32, N, sizeof(Sample), ENDURANCE);
+  CHECK_EQUAL(buffer.currentIndex(), ring2.currentIndex());
+  CHECK_EQUAL(ring.currentIndex(), buffer2.currentIndex());
+  Sample a, b;
+  ring2.get(0, a);
+  buffer2.get(0, (void *)&b);
+  CHECK_EQUAL(b.a, a.a);
+}
+
+int main(void)
+{
+  compare<16, 1>(1);
+  compare<16, 4>(2);
+  compare<10, 1>(3);
+  compare<10, 8>(4);
+  compare<2, 1>(5);
+  return hostTestReport("eepromRingTest");
+}
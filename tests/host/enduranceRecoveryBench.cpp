@@ -0,0 +1,82 @@
+/**
+   Compare the EEPROM reads required at boot time by the two
+   EnduranceEeprom recovery strategies (linear scan and binary search).
+
+   For every number of writes, the linear scan and the binary search must
+   recover the same element. The read operations and bytes read by each
+   strategy are then reported for several endurance factors.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "EnduranceEeprom.h"
+
+#define START_ADDR 64
+
+struct Recovered {
+  uint32_t value;
+  bool valid;
+  uint32_t readOps;
+  uint32_t bytesRead;
+};
+
+Recovered recover(SimEeprom &ee, uint16_t endurFactor, EnduranceEeprom::Recovery mode)
+{
+  Recovered r;
+  ee.resetStats();
+  EnduranceEeprom endurance(ee, START_ADDR, endurFactor, sizeof(uint32_t), mode);
+  r.readOps = ee.readOps();
+  r.bytesRead = ee.bytesRead();
+  r.valid = endurance.readData((void *)&r.value);
+  return r;
+}
+
+void checkAgreement(uint16_t endurFactor)
+{
+  SimEeprom ee(8192, 64, true);
+  EnduranceEeprom endurance(ee, START_ADDR, endurFactor, sizeof(uint32_t));
+  for (uint32_t w=1; w<=3u*endurFactor+1; w++) {
+    endurance.writeData((void *)&w);
+    Recovered linear = recover(ee, endurFactor, EnduranceEeprom::LINEAR_SCAN);
+    Recovered binary = recover(ee, endurFactor, EnduranceEeprom::BINARY_SEARCH);
+    CHECK(linear.valid);
+    CHECK(binary.valid);
+    CHECK_EQUAL(w, linear.value);
+    CHECK_EQUAL(w, binary.value);
+  }
+}
+
+void report(uint16_t endurFactor, uint32_t writes)
+{
+  SimEeprom ee(8192, 64, true);
+  EnduranceEeprom endurance(ee, START_ADDR, endurFactor, sizeof(uint32_t));
+  for (uint32_t w=1; w<=writes; w++) {
+    endurance.writeData((void *)&w);
+  }
+  Recovered linear = recover(ee, endurFactor, EnduranceEeprom::LINEAR_SCAN);
+  Recovered binary = recover(ee, endurFactor, EnduranceEeprom::BINARY_SEARCH);
+  CHECK_EQUAL(writes, linear.value);
+  CHECK_EQUAL(writes, binary.value);
+  printf("%12u %8u %12u %12u %12u %12u\n", endurFactor, writes,
+         linear.readOps, linear.bytesRead, binary.readOps, binary.bytesRead);
+}
+
+int main(void)
+{
+  checkAgreement(2);
+  checkAgreement(5);
+  checkAgreement(16);
+  checkAgreement(37);
+
+  printf("%12s %8s %12s %12s %12s %12s\n", "endurFactor", "writes",
+         "scan ops", "scan bytes", "bisect ops", "bisect bytes");
+  uint16_t factors[] = { 8, 64, 256, 500 };
+  for (unsigned int i=0; i<sizeof(factors)/sizeof(factors[0]); i++) {
+    // wrap point at the middle of the ring, then just before the end
+    report(factors[i], 2*factors[i] + factors[i]/2);
+    report(factors[i], 3*factors[i] - 1);
+  }
+
+  return hostTestReport("enduranceRecoveryBench");
+}
@@ -0,0 +1,169 @@
+/**
+   Host test of the gap marker mode of EepromRingBuffer: random sequences
+   of push, pushMany, rotate and clear must read the same elements
+   (0xFF for the skipped ones) as a ring buffer erasing the skipped
+   elements, also after the buffer is opened again from the EEPROM.
+
+   It also compares the page programs of a TimePermRingBuffer catching
+   up after a long downtime in both modes.
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimEeprom.h"
+#include "EepromRingBuffer.h"
+#include "TimePermRingBuffer.h"
+
+#define START 16
+
+struct Sample {
+  int16_t a;
+  int16_t b;
+};
+
+static_assert(EepromRingBuffer::layoutSize(10, 4, 1, true) == 10*4 + 6,
+              "gap marker layout");
+
+/** Return true if both buffers read the same elements. */
+static bool same(EepromRingBuffer &gap, EepromRingBuffer &erased, uint16_t n)
+{
+  bool ok = true;
+  for (int i=-(int)n; i<(int)n; i++) {
+    Sample a, b;
+    gap.get(i, (void *)&a);
+    erased.get(i, (void *)&b);
+    if ( memcmp(&a, &b, sizeof(Sample)) != 0 ) {
+      printf("element %d differs: %d %d != %d %d\n", i, a.a, a.b, b.a, b.b);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+void compare(uint16_t n, uint16_t endurance, unsigned seed)
+{
+  SimEeprom eeGap(1024);
+  SimEeprom eeErased(1024);
+  EepromRingBuffer gap(eeGap, START, n, sizeof(Sample), endurance, true);
+  EepromRingBuffer erased(eeErased, START, n, sizeof(Sample), endurance);
+  // garbage in the buffer: the gap marker clear() does not erase it
+  for (uint16_t i=START+gap.storageSize()-n*sizeof(Sample);
+       i<START+gap.storageSize(); i++) {
+    eeGap.write_byte(i, i);
+  }
+  CHECK_EQUAL(EepromRingBuffer::layoutSize(n, sizeof(Sample), endurance, true),
+              gap.storageSize());
+  CHECK(same(gap, erased, n));
+
+  srand(seed);
+  for (int op=0; op<3000; op++) {
+    int r = rand() % 20;
+    if ( r < 10 ) {
+      Sample s = { (int16_t)op, (int16_t)rand() };
+      gap.push((void *)&s);
+      erased.push((void *)&s);
+    }
+    else if ( r < 12 ) {
+      Sample batch[64];
+      uint16_t count = rand() % (2*n);
+      for (uint16_t i=0; i<count; i++) {
+        batch[i].a = op;
+        batch[i].b = i;
+      }
+      gap.pushMany((void *)batch, count);
+      erased.pushMany((void *)batch, count);
+    }
+    else if ( r < 17 ) {
+      uint16_t steps = rand() % (n+2);
+      gap.rotate(steps);
+      erased.rotate(steps);
+    }
+    else if ( r < 18 ) {
+      gap.clear();
+      erased.clear();
+    }
+    else {
+      // all the ways to read the buffer
+      if ( ! same(gap, erased, n) ) {
+        CHECK(false);
+        break;
+      }
+      Sample a[32], b[32];
+      int from = rand() % (2*n) - n;
+      uint16_t count = 1 + rand() % n;
+      gap.getRange(from, count, (void *)a);
+      erased.getRange(from, count, (void *)b);
+      CHECK(memcmp(a, b, count*sizeof(Sample)) == 0);
+      EepromRingBuffer::Iterator itGap(gap, r & 1);
+      EepromRingBuffer::Iterator itErased(erased, r & 1);
+      while ( itErased.next((void *)b) ) {
+        CHECK(itGap.next((void *)a));
+        CHECK(memcmp(a, b, sizeof(Sample)) == 0);
+      }
+      // the skipped range is recovered from the EEPROM
+      EepromRingBuffer reopened(eeGap, START, n, sizeof(Sample), endurance, true);
+      CHECK_EQUAL(erased.currentIndex(), reopened.currentIndex());
+      CHECK(same(reopened, erased, n));
+    }
+    CHECK_EQUAL(erased.currentIndex(), gap.currentIndex());
+  }
+}
+
+/** Insert a sample every period, then after a downtime of skip periods. */
+static uint32_t catchUp(SimEeprom &ee, bool gapMarker, long skip, int16_t *values)
+{
+  TimePermRingBuffer timed(ee, START, 64, sizeof(int16_t), 10, 8, gapMarker);
+  ShortSample sample;
+  long t = 1000;
+  for (int16_t i=0; i<100; i++) {
+    sample.m_value = i;
+    timed.insert(sample, t);
+    t += 10;
+  }
+  ee.resetStats();
+  sample.m_value = -1;
+  CHECK(timed.insert(sample, t + skip*10));
+  uint32_t programs = ee.pagePrograms();
+
+  TimePermRingBuffer::Iterator it(timed, true);
+  int i = 0;
+  while ( it.next(sample) ) values[i++] = sample.m_value;
+  CHECK_EQUAL(64, i);
+  return programs;
+}
+
+void testCatchUp()
+{
+  // downtimes shorter and longer than the time span of the buffer
+  const long skips[] = { 0, 1, 5, 40, 63, 64, 500 };
+  uint32_t regular = 0;
+  for (unsigned k=0; k<sizeof(skips)/sizeof(skips[0]); k++) {
+    SimEeprom eeGap(1024);
+    SimEeprom eeErased(1024);
+    int16_t gapValues[64], erasedValues[64];
+    uint32_t gapPrograms = catchUp(eeGap, true, skips[k], gapValues);
+    uint32_t erasedPrograms = catchUp(eeErased, false, skips[k], erasedValues);
+    CHECK(memcmp(gapValues, erasedValues, sizeof(gapValues)) == 0);
+    CHECK_EQUAL(-1, gapValues[0]);
+    if ( skips[k] > 0 ) CHECK_EQUAL((int16_t)0xFFFF, gapValues[1]);
+    // a few index, time stamp and sample writes whatever the downtime
+    if ( k == 0 ) regular = gapPrograms;
+    CHECK(gapPrograms <= 2*regular);
+    printf("downtime %3ld periods: %4u page programs with gap marker, %4u without\n",
+           skips[k], gapPrograms, erasedPrograms);
+  }
+}
+
+int main(void)
+{
+  compare(16, 1, 1);
+  compare(16, 4, 2);
+  compare(10, 8, 3);
+  compare(2, 1, 4);
+  compare(31, 2, 5);
+  testCatchUp();
+  return hostTestReport("gapMarkerTest");
+}
@@ -0,0 +1,72 @@
+/**
+   Minimal checking facilities shared by the host test programs.
+
+   Each test program is a plain executable: it prints the failed checks
+   and returns a non zero status if any, so it can be run by ctest.
+*/
+#ifndef hostTest_h
+#define hostTest_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "DataSample.h"
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond) do {                                              \
+    if ( ! (cond) ) {                                                 \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      hostTestFailures++;                                             \
+    }                                                                 \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual) do {                            \
+    long long e_ = (long long)(expected);                             \
+    long long a_ = (long long)(actual);                               \
+    if ( e_ != a_ ) {                                                 \
+      printf("%s:%d: %s == %s failed: %lld != %lld\n",                \
+             __FILE__, __LINE__, #expected, #actual, e_, a_);         \
+      hostTestFailures++;                                             \
+    }                                                                 \
+  } while (0)
+
+/** Return a monotonic time in nanoseconds, for the benchmarks. */
+static inline double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+/** Sample of a single int16_t value, for the timed ring buffers. */
+class ShortSample : public DataSample
+{
+public:
+  ShortSample() : DataSample(sizeof(int16_t)), m_value(0) {}
+  void *data() { return (void *)&m_value; }
+  int16_t m_value;
+};
+
+/** Sample of a single int32_t value, for the timed ring buffers. */
+class LongSample : public DataSample
+{
+public:
+  LongSample() : DataSample(sizeof(int32_t)), m_value(0) {}
+  void *data() { return (void *)&m_value; }
+  int32_t m_value;
+};
+
+/** Print the summary and return the exit status of the test program. */
+static inline int hostTestReport(const char *name)
+{
+  if ( hostTestFailures ) {
+    printf("%s: %d check(s) failed\n", name, hostTestFailures);
+    return 1;
+  }
+  printf("%s: all checks passed\n", name);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,161 @@
+/**
+   Host test of I2cEeprom, running against the simulated 24LC256 of
+   SimI2cBus.
+*/
+
+#include "hostTest.h"
+
+#include "SimI2cBus.h"
+#include "I2cEeprom.h"
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+
+#include <string.h>
+
+void testPageWrap()
+{
+  // a raw page write crossing the page boundary wraps within the page
+  SimI2cBus bus;
+  bus.beginTransmission(0x50);
+  bus.write(0);
+  bus.write(60);
+  for (uint8_t i=0; i<10; i++) {
+    bus.write(i);
+  }
+  CHECK_EQUAL(0, bus.endTransmission());
+  CHECK_EQUAL(0, bus.peek(60));
+  CHECK_EQUAL(3, bus.peek(63));
+  CHECK_EQUAL(4, bus.peek(0));
+  CHECK_EQUAL(9, bus.peek(5));
+  CHECK_EQUAL(0xFF, bus.peek(64));
+  CHECK_EQUAL(1, bus.pagePrograms());
+
+  // the device is busy during its write cycle
+  bus.beginTransmission(0x50);
+  CHECK_EQUAL(2, bus.endTransmission());
+  CHECK_EQUAL(0, bus.requestFrom(0x50, 4));
+}
+
+void testBlocks()
+{
+  SimI2cBus bus;
+  I2cEeprom ee(bus);
+  CHECK_EQUAL(32768, ee.memSize());
+  CHECK_EQUAL(64, ee.pageSize());
+
+  // the example of 24LC256_Eeprom.c: 78 bytes at 55 overlap 3 pages
+  uint8_t data[78];
+  for (uint8_t i=0; i<sizeof(data); i++) data[i] = i+1;
+  ee.write_block(55, (void *)data, sizeof(data));
+  // 55-63 | 64-93 94-123 124-127 | 128-132
+  CHECK_EQUAL(5, bus.pagePrograms());
+  CHECK_EQUAL(0, ee.timeouts());
+  for (uint8_t i=0; i<sizeof(data); i++) {
+    CHECK_EQUAL(i+1, bus.peek(55+i));
+  }
+  CHECK_EQUAL(0xFF, bus.peek(54));
+  CHECK_EQUAL(0xFF, bus.peek(133));
+
+  uint8_t back[100];
+  ee.read_block(40, (void *)back, sizeof(back));
+  CHECK(memcmp(back+15, data, sizeof(data)) == 0);
+  CHECK_EQUAL(0xFF, back[14]);
+
+  ee.write_long(1000, 0x12345678ul);
+  ee.write_word(2000, 0xABCD);
+  ee.write_byte(3000, 0x42);
+  CHECK_EQUAL(0x12345678ul, ee.read_long(1000));
+  CHECK_EQUAL(0xABCD, ee.read_word(2000));
+  CHECK_EQUAL(0x42, ee.read_byte(3000));
+
+  // updates and fills skip the unchanged chunks
+  uint32_t programs = bus.pagePrograms();
+  ee.update_block(55, (void *)data, sizeof(data));
+  ee.update_long(1000, 0x12345678ul);
+  CHECK_EQUAL(programs, bus.pagePrograms());
+  ee.fill(4096, 0xFF, 256);
+  CHECK_EQUAL(programs, bus.pagePrograms());
+  ee.fill(4096, 0, 256);
+  // 4 pages of 64 bytes, each written in 30 + 30 + 4 bytes
+  CHECK_EQUAL(programs+12, bus.pagePrograms());
+  CHECK_EQUAL(0, ee.read_long(4096+252));
+}
+
+void testAckPolling()
+{
+  SimI2cBus bus;
+  I2cEeprom ee(bus);
+  bus.setWriteCycle(2000);
+  unsigned long start = bus.micros();
+  for (uint16_t i=0; i<100; i++) {
+    ee.write_byte(i*64, i);
+  }
+  unsigned long elapsed = bus.micros() - start;
+  printf("100 page writes with ACK polling: %lu us (fixed delay(6): 600000 us)\n", elapsed);
+  CHECK(elapsed < 100ul*3000);
+  CHECK(bus.nacks() > 0);
+  CHECK_EQUAL(0, ee.timeouts());
+
+  // a device which never completes is reported
+  bus.setWriteCycle(50000);
+  ee.write_byte(0, 0);
+  CHECK_EQUAL(1, ee.timeouts());
+  CHECK_EQUAL(0, ee.writeErrors());
+
+  // a write while the device is still busy (write cycle longer than
+  // the timeout) waits for it
+  SimI2cBus slowBus;
+  I2cEeprom slow(slowBus);
+  slowBus.setWriteCycle(15000);
+  slow.write_byte(64, 1);
+  CHECK_EQUAL(1, slow.timeouts());
+  slow.write_byte(128, 2);
+  CHECK_EQUAL(1, slowBus.peek(64));
+  CHECK_EQUAL(2, slowBus.peek(128));
+  CHECK_EQUAL(0, slow.writeErrors());
+
+  // a missing device drops the writes, and reports them
+  I2cEeprom missing(bus, 0x51);
+  uint8_t data[40];
+  memset(data, 0x33, sizeof(data));
+  missing.write_block(300, (void *)data, sizeof(data));
+  CHECK_EQUAL(1, missing.writeErrors());
+  CHECK_EQUAL(0xFF, bus.peek(300));
+}
+
+void testStructures()
+{
+  SimI2cBus bus;
+  I2cEeprom ee(bus);
+  {
+    EnduranceEeprom endurance(ee, 0, 300, sizeof(uint32_t),
+                              EnduranceEeprom::BINARY_SEARCH);
+    for (uint32_t i=0; i<1000; i++) {
+      endurance.writeData((void *)&i);
+    }
+    EepromRingBuffer ring(ee, 4096, 2000, sizeof(uint32_t), 8);
+    for (uint32_t i=0; i<2500; i++) {
+      ring.push((void *)&i);
+    }
+  }
+  EnduranceEeprom endurance(ee, 0, 300, sizeof(uint32_t),
+                            EnduranceEeprom::BINARY_SEARCH);
+  uint32_t value;
+  CHECK(endurance.readData((void *)&value));
+  CHECK_EQUAL(999, value);
+
+  EepromRingBuffer ring(ee, 4096, 2000, sizeof(uint32_t), 8);
+  ring.get(0, (void *)&value);
+  CHECK_EQUAL(2499, value);
+  ring.get(1999, (void *)&value);
+  CHECK_EQUAL(500, value);
+}
+
+int main(void)
+{
+  testPageWrap();
+  testBlocks();
+  testAckPolling();
+  testStructures();
+  return hostTestReport("i2cEepromTest");
+}
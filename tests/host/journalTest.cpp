@@ -0,0 +1,205 @@
+/**
+   Power loss test of EepromJournal. A TimePermRingBuffer insert (a
+   simple one, one after a gap and one clearing the buffer) is run in a
+   transaction, and the power of the SimEeprom is cut after every
+   possible number of bytes programmed, then again at every byte of the
+   recovery. After the restart, the buffer must be in the state before the
+   insert or in the state after it, and keep working.
+
+   The same inserts without the journal are shown to leave the buffer in
+   other states.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "EepromJournal.h"
+#include "TimePermRingBuffer.h"
+
+#define JOURNAL_SIZE 76
+#define BUFFER_ADDR 80
+#define SIZE 8
+#define PERIOD 10
+#define START 1000
+#define SAMPLES 11
+
+/** What is visible of the buffer. */
+struct State {
+  long time;
+  int16_t samples[SIZE];
+  uint16_t index;
+
+  bool operator==(const State &o) const {
+    if ( time != o.time || index != o.index ) return false;
+    for (int i=0; i<SIZE; i++) {
+      if ( samples[i] != o.samples[i] ) return false;
+    }
+    return true;
+  }
+};
+
+static State capture(TimePermRingBuffer &timed)
+{
+  State state;
+  ShortSample sample;
+  for (int i=0; i<SIZE; i++) {
+    timed.read(i, sample);
+    state.samples[i] = sample.m_value;
+  }
+  state.time = timed.lastTimeStamp();
+  state.index = timed.currentIndex();
+  return state;
+}
+
+/** Insert a sample, in a transaction when a journal is given. */
+static void insert(EepromJournal *journal, TimePermRingBuffer &timed,
+                   int16_t value, long time)
+{
+  ShortSample sample;
+  sample.m_value = value;
+  if ( journal ) journal->begin();
+  timed.insert(sample, time);
+  if ( journal ) CHECK(journal->commit());
+}
+
+/** Start from the same history for every power cut. */
+static void prepare(SimEeprom &ee)
+{
+  EepromJournal journal(ee, 0, JOURNAL_SIZE);
+  TimePermRingBuffer timed(journal, BUFFER_ADDR, SIZE, sizeof(int16_t), PERIOD, 2);
+  for (int16_t i=0; i<SAMPLES; i++) insert(&journal, timed, i, START + i*PERIOD);
+}
+
+/** Restart on the EEPROM content and check the state of the buffer.
+    @return 0 for the old state, 1 for the new one, -1 otherwise */
+static int restart(SimEeprom &ee, bool journaled, const State &before,
+                   const State &after, bool *replayed=NULL)
+{
+  EepromJournal journal(ee, 0, JOURNAL_SIZE);
+  SafeEeprom &device = journaled ? (SafeEeprom &)journal : (SafeEeprom &)ee;
+  TimePermRingBuffer timed(device, BUFFER_ADDR, SIZE, sizeof(int16_t), PERIOD, 2);
+  if ( replayed ) *replayed = journal.replayed();
+  State state = capture(timed);
+  if ( state == before ) return 0;
+  if ( state == after ) return 1;
+  return -1;
+}
+
+/** Cut the power at every byte of an insert.
+    @return           number of power cuts giving another state */
+static int powerCuts(const char *name, bool journaled, long time, bool pageWrite)
+{
+  // reference states
+  State before, after;
+  {
+    SimEeprom ee(1024, 16, pageWrite);
+    prepare(ee);
+    EepromJournal journal(ee, 0, JOURNAL_SIZE);
+    TimePermRingBuffer timed(journal, BUFFER_ADDR, SIZE, sizeof(int16_t), PERIOD, 2);
+    before = capture(timed);
+    insert(journaled ? &journal : NULL, timed, 100, time);
+    after = capture(timed);
+    CHECK(!(before == after));
+  }
+
+  int torn = 0, olds = 0, news = 0, replays = 0;
+  for (uint32_t cut=0; ; cut++) {
+    SimEeprom ee(1024, 16, pageWrite);
+    prepare(ee);
+    ee.setPowerCut(cut);
+    {
+      EepromJournal journal(ee, 0, JOURNAL_SIZE);
+      TimePermRingBuffer timed(journal, BUFFER_ADDR, SIZE, sizeof(int16_t), PERIOD, 2);
+      insert(journaled ? &journal : NULL, timed, 100, time);
+    }
+    bool complete = !ee.powerLost();
+    ee.restorePower();
+
+    // also lose the power during the recovery, until it completes
+    for (uint32_t recoveryCut=0; journaled; recoveryCut++) {
+      SimEeprom copy(1024, 16, pageWrite);
+      uint8_t image[1024];
+      ee.read_block(0, image, sizeof(image));
+      copy.write_block(0, image, sizeof(image));
+      copy.setPowerCut(recoveryCut);
+      bool replayed;
+      restart(copy, true, before, after, &replayed);
+      bool recovered = !copy.powerLost();
+      copy.restorePower();
+      int result = restart(copy, true, before, after);
+      CHECK(result >= 0);
+      if ( recovered ) break;
+    }
+
+    bool replayed = false;
+    int result = restart(ee, journaled, before, after, &replayed);
+    if ( result < 0 ) torn++;
+    else if ( result == 0 ) olds++;
+    else news++;
+    if ( replayed ) replays++;
+    if ( complete ) {
+      CHECK_EQUAL(1, result);
+      break;
+    }
+  }
+
+  printf("%-8s %-5s %-7s %4d cuts: %3d old, %3d new (%3d replayed), %3d inconsistent\n",
+         journaled ? "journal" : "direct", pageWrite ? "page" : "byte", name,
+         olds+news+torn, olds, news, replays, torn);
+  return torn;
+}
+
+/** After the recovery, the buffer keeps working with the journal. */
+void testContinue()
+{
+  SimEeprom ee(1024, 16);
+  prepare(ee);
+  ee.setPowerCut(20);
+  {
+    EepromJournal journal(ee, 0, JOURNAL_SIZE);
+    TimePermRingBuffer timed(journal, BUFFER_ADDR, SIZE, sizeof(int16_t), PERIOD, 2);
+    insert(&journal, timed, 100, START + SAMPLES*PERIOD);
+  }
+  CHECK(ee.powerLost());
+  ee.restorePower();
+
+  EepromJournal journal(ee, 0, JOURNAL_SIZE);
+  TimePermRingBuffer timed(journal, BUFFER_ADDR, SIZE, sizeof(int16_t), PERIOD, 2);
+  insert(&journal, timed, 101, START + (SAMPLES+1)*PERIOD);
+  ShortSample sample;
+  CHECK_EQUAL(START + (SAMPLES+1)*PERIOD, timed.read(0, sample));
+  CHECK_EQUAL(101, sample.m_value);
+
+  // reads in a transaction see the journaled writes, an aborted
+  // transaction leaves the EEPROM untouched
+  journal.begin();
+  journal.write_word(900, 0x1234);
+  journal.fill(902, 0x55, 3);
+  CHECK_EQUAL(0x1234, journal.read_word(900));
+  CHECK_EQUAL(0x55, journal.read_byte(904));
+  CHECK_EQUAL(0xFF, ee.read_byte(904));
+  journal.abort();
+  CHECK_EQUAL(0xFFFF, journal.read_word(900));
+
+  // a transaction too large is discarded
+  uint8_t big[JOURNAL_SIZE];
+  journal.begin();
+  journal.write_block(900, big, sizeof(big));
+  CHECK(!journal.commit());
+  CHECK_EQUAL(0xFFFF, ee.read_word(900));
+}
+
+int main(void)
+{
+  for (int pageWrite=0; pageWrite<2; pageWrite++) {
+    long last = START + (SAMPLES-1)*PERIOD;
+    CHECK_EQUAL(0, powerCuts("insert", true, last + PERIOD, pageWrite));
+    CHECK_EQUAL(0, powerCuts("gap", true, last + 3*PERIOD, pageWrite));
+    CHECK_EQUAL(0, powerCuts("clear", true, last + 2*SIZE*PERIOD, pageWrite));
+    // without the journal, the power cuts break the buffer
+    CHECK(powerCuts("insert", false, last + PERIOD, pageWrite) > 0);
+    CHECK(powerCuts("gap", false, last + 3*PERIOD, pageWrite) > 0);
+  }
+  testContinue();
+  return hostTestReport("journalTest");
+}
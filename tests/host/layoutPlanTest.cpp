@@ -0,0 +1,105 @@
+/**
+   Layouts of the EnduranceEeprom slots chosen by planLayout().
+
+   On devices programming a page at once, the planned layout must not
+   program more pages per writeData than the packed layout (and the
+   prediction of pagesPerWrite() must hold), it must be recovered at boot
+   with both strategies, and fit in the space given. The page programs
+   and the wear of the most used page are reported for both layouts.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "EnduranceEeprom.h"
+
+#define START_ADDR 10
+#define ENDURANCE 8
+#define WRITES 1000
+
+struct Measure {
+  float programs;               /** Page programs per writeData */
+  float wear;                   /** Cycles of the most used page per writeData */
+  uint16_t size;
+};
+
+Measure measure(uint16_t pageSize, size_t dataSize, const EnduranceEeprom::Layout &layout)
+{
+  SimEeprom ee(8192, pageSize, true);
+  uint8_t data[64];
+  uint32_t w;
+  {
+    EnduranceEeprom endurance(ee, START_ADDR, ENDURANCE, dataSize, layout);
+    ee.resetStats();
+    for (w=1; w<=WRITES; w++) {
+      // all the bytes change, so every page of the slots is programmed
+      for (size_t i=0; i<dataSize; i++) data[i] = w + i;
+      endurance.writeData((void *)data);
+    }
+  }
+  Measure m;
+  m.programs = (float)ee.pagePrograms() / WRITES;
+  m.wear = (float)ee.maxPageCycles() / WRITES;
+
+  // recovered with the same layout
+  EnduranceEeprom linear(ee, START_ADDR, ENDURANCE, dataSize, layout);
+  EnduranceEeprom binary(ee, START_ADDR, ENDURANCE, dataSize, layout,
+                         EnduranceEeprom::BINARY_SEARCH);
+  uint8_t a[64], b[64];
+  CHECK(linear.readData((void *)a));
+  CHECK(binary.readData((void *)b));
+  CHECK_EQUAL((uint8_t)WRITES, a[0]);
+  CHECK_EQUAL((uint8_t)(WRITES + dataSize-1), a[dataSize-1]);
+  CHECK_EQUAL(a[0], b[0]);
+  m.size = linear.storageSize();
+  CHECK_EQUAL(EnduranceEeprom::layoutSize(layout, ENDURANCE), m.size);
+  return m;
+}
+
+void compare(uint16_t pageSize, size_t dataSize)
+{
+  EnduranceEeprom::Layout packed = EnduranceEeprom::packedLayout(ENDURANCE, dataSize);
+  EnduranceEeprom::Layout planned =
+    EnduranceEeprom::planLayout(START_ADDR, ENDURANCE, dataSize, pageSize);
+  Measure p = measure(pageSize, dataSize, packed);
+  Measure q = measure(pageSize, dataSize, planned);
+
+  // the planned layout is never worse, and the prediction holds
+  CHECK(q.programs <= p.programs);
+  float predicted = EnduranceEeprom::pagesPerWrite(planned, START_ADDR, ENDURANCE,
+                                                   dataSize, pageSize);
+  CHECK(q.programs <= predicted + 0.01f);
+  CHECK(q.wear <= EnduranceEeprom::wearPerWrite(planned, START_ADDR, ENDURANCE,
+                                                dataSize, pageSize) + 0.01f);
+
+  printf("%5u %5u | %6u %8.2f %6.3f | %6u %8.2f %6.3f | %3u %3u %4u %3u\n",
+         pageSize, (unsigned)dataSize, p.size, p.programs, p.wear,
+         q.size, q.programs, q.wear, planned.statusOffset, planned.statusStride,
+         planned.dataOffset, planned.dataStride);
+
+  // with less space, a layout which fits is chosen
+  uint16_t limit = EnduranceEeprom::layoutSize(packed, ENDURANCE);
+  EnduranceEeprom::Layout small =
+    EnduranceEeprom::planLayout(START_ADDR, ENDURANCE, dataSize, pageSize, limit);
+  CHECK(EnduranceEeprom::layoutSize(small, ENDURANCE) <= limit);
+}
+
+int main(void)
+{
+  // the packed layout is the historic one
+  EnduranceEeprom::Layout packed = EnduranceEeprom::packedLayout(ENDURANCE, 6);
+  CHECK_EQUAL(EnduranceEeprom::layoutSize(ENDURANCE, 6),
+              EnduranceEeprom::layoutSize(packed, ENDURANCE));
+
+  printf("%5s %5s | %6s %8s %6s | %6s %8s %6s | %s\n", "page", "data",
+         "packed", "programs", "wear", "plan", "programs", "wear",
+         "status off/stride, data off/stride");
+  uint16_t pages[] = { 4, 16, 32, 64 };
+  size_t sizes[] = { 4, 6, 16, 40 };
+  for (unsigned i=0; i<sizeof(pages)/sizeof(pages[0]); i++) {
+    for (unsigned j=0; j<sizeof(sizes)/sizeof(sizes[0]); j++) {
+      compare(pages[i], sizes[j]);
+    }
+  }
+  return hostTestReport("layoutPlanTest");
+}
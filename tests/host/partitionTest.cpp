@@ -0,0 +1,167 @@
+/**
+   Host test of EepromPartition: the regions are page aligned, do not
+   overlap and match the addresses computed at compile time. At the next
+   boot, the same layout keeps all the data, while a changed layout
+   erases only the regions which changed.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "EepromPartition.h"
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+#include "TimePermRingBuffer.h"
+
+#define PAGE 16
+
+// the layout of the firmware, computed at compile time
+static constexpr uint16_t COUNTER_SIZE = EnduranceEepromBase::layoutSize(4, sizeof(uint32_t));
+static constexpr uint16_t RING_SIZE = EepromRingBuffer::layoutSize(10, sizeof(int16_t), 2);
+static constexpr uint16_t TIMED_SIZE = TimePermRingBuffer::layoutSize(8, sizeof(int16_t));
+static constexpr uint16_t COUNTER = EepromPartition::firstRegion(0, PAGE);
+static constexpr uint16_t RING = EepromPartition::nextRegion(COUNTER, COUNTER_SIZE, PAGE);
+static constexpr uint16_t TIMED = EepromPartition::nextRegion(RING, RING_SIZE, PAGE);
+static constexpr uint16_t END = EepromPartition::nextRegion(TIMED, TIMED_SIZE, PAGE);
+static_assert(COUNTER % PAGE == 0 && RING % PAGE == 0 && TIMED % PAGE == 0,
+              "regions are page aligned");
+static_assert(END <= 1024, "the layout fits in the EEPROM");
+
+/** One boot of the firmware, with a ring of ringSize elements. */
+struct Firmware {
+  Firmware(SimEeprom &ee, uint16_t ringSize=10, uint16_t ringTag=0) :
+    partition(ee),
+    counterAddr(partition.allocate(COUNTER_SIZE)),
+    ringAddr(partition.allocate(EepromRingBuffer::layoutSize(ringSize, sizeof(int16_t), 2),
+                                ringTag)),
+    timedAddr(partition.allocate(TIMED_SIZE)),
+    erased(partition.mount()),
+    counter(ee, counterAddr, 4, sizeof(uint32_t)),
+    ring(ee, ringAddr, ringSize, sizeof(int16_t), 2),
+    timed(ee, timedAddr, 8, sizeof(int16_t), 10) {}
+
+  EepromPartition partition;
+  uint16_t counterAddr;
+  uint16_t ringAddr;
+  uint16_t timedAddr;
+  uint8_t erased;
+  EnduranceEeprom counter;
+  EepromRingBuffer ring;
+  TimePermRingBuffer timed;
+};
+
+void testLayout()
+{
+  SimEeprom ee(1024, PAGE, true);
+  // garbage left by another firmware
+  for (uint16_t i=0; i<1024; i++) ee.write_byte(i, i*7);
+
+  {
+    Firmware fw(ee);
+    CHECK(fw.partition.ok());
+    CHECK_EQUAL(3, fw.erased);
+    CHECK_EQUAL(COUNTER, fw.counterAddr);
+    CHECK_EQUAL(RING, fw.ringAddr);
+    CHECK_EQUAL(TIMED, fw.timedAddr);
+    CHECK_EQUAL(END, EepromPartition::alignUp(fw.partition.end(), PAGE));
+    CHECK_EQUAL(COUNTER_SIZE, fw.counter.storageSize());
+    CHECK_EQUAL(RING_SIZE, fw.ring.storageSize());
+    CHECK_EQUAL(TIMED_SIZE, fw.timed.storageSize());
+    CHECK(fw.counterAddr + fw.counter.storageSize() <= fw.ringAddr);
+    CHECK(fw.ringAddr + fw.ring.storageSize() <= fw.timedAddr);
+
+    // the structures start from scratch
+    CHECK_EQUAL(0, fw.ring.currentIndex());
+    uint32_t count = 42;
+    fw.counter.writeData((void *)&count);
+    int16_t value = 7;
+    fw.ring.push((void *)&value);
+    ShortSample sample;
+    sample.m_value = 3;
+    fw.timed.insert(sample, 1000);
+  }
+
+  // same layout: nothing erased, the table is read once
+  ee.resetStats();
+  {
+    EepromPartition partition(ee);
+    partition.allocate(COUNTER_SIZE);
+    partition.allocate(RING_SIZE);
+    partition.allocate(TIMED_SIZE);
+    CHECK_EQUAL(0, partition.mount());
+    CHECK_EQUAL(1, ee.readOps());
+    CHECK_EQUAL(0, ee.bytesWritten());
+  }
+  {
+    Firmware fw(ee);
+    CHECK_EQUAL(0, fw.erased);
+    uint32_t count;
+    fw.counter.readData((void *)&count);
+    CHECK_EQUAL(42, count);
+    int16_t value;
+    fw.ring.get(0, (void *)&value);
+    CHECK_EQUAL(7, value);
+    CHECK_EQUAL(1000, fw.timed.lastTimeStamp());
+  }
+
+  // a larger ring moves the timed buffer: only those two are erased
+  {
+    Firmware fw(ee, 20);
+    CHECK_EQUAL(2, fw.erased);
+    CHECK(!fw.partition.changed(0));
+    CHECK(fw.partition.changed(1));
+    CHECK(fw.partition.changed(2));
+    uint32_t count;
+    fw.counter.readData((void *)&count);
+    CHECK_EQUAL(42, count);
+    CHECK_EQUAL(0, fw.ring.currentIndex());
+    CHECK(fw.timed.lastTimeStamp() != 1000);
+    int16_t value = 9;
+    fw.ring.push((void *)&value);
+  }
+
+  // a new tag erases the region, even at the same place
+  {
+    Firmware fw(ee, 20, 1);
+    CHECK_EQUAL(1, fw.erased);
+    CHECK(fw.partition.changed(1));
+    uint32_t count;
+    fw.counter.readData((void *)&count);
+    CHECK_EQUAL(42, count);
+  }
+
+  // a corrupted table erases everything
+  ee.write_byte(5, ee.read_byte(5) ^ 0x10);
+  {
+    Firmware fw(ee, 20, 1);
+    CHECK_EQUAL(3, fw.erased);
+  }
+}
+
+void testNoSpace()
+{
+  SimEeprom ee(256, PAGE, true);
+  EepromPartition partition(ee, 0, 200);
+  uint16_t a = partition.allocate(100);
+  CHECK(a != EEPROM_PARTITION_NONE);
+  CHECK(partition.ok());
+  CHECK_EQUAL(EEPROM_PARTITION_NONE, partition.allocate(100));
+  CHECK(!partition.ok());
+  // nothing is written with an incomplete layout
+  ee.resetStats();
+  CHECK_EQUAL(0, partition.mount());
+  CHECK_EQUAL(0, ee.bytesWritten());
+
+  // unaligned regions are packed
+  EepromPartition packed(ee);
+  uint16_t b = packed.allocate(5, 0, false);
+  uint16_t c = packed.allocate(5, 0, false);
+  CHECK_EQUAL(b+5, c);
+}
+
+int main(void)
+{
+  testLayout();
+  testNoSpace();
+  return hostTestReport("partitionTest");
+}
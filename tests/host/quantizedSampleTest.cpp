@@ -0,0 +1,183 @@
+/**
+   Host test of QuantizedSample: packing of the codes, quantization error
+   and clamping for 8, 12 and 16 bits, and use in a TimePermRingBuffer
+   (skipped samples read as null values). Reports the history held by
+   the same EEPROM area with float samples and with each code size.
+*/
+
+#include "hostTest.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimEeprom.h"
+#include "TimePermRingBuffer.h"
+#include "QuantizedSample.h"
+
+#define CHANNELS 3
+#define BUDGET 900
+#define PERIOD 60
+
+static_assert(Quantized8<CHANNELS>::SIZE == 3, "8 bits packing");
+static_assert(Quantized12<CHANNELS>::SIZE == 5, "12 bits packing");
+static_assert(Quantized12<2>::SIZE == 3, "12 bits packing");
+static_assert(Quantized16<CHANNELS>::SIZE == 6, "16 bits packing");
+
+/** Float samples, as in tests/timeRingBufferTest.h */
+class FloatSample : public DataSample
+{
+public:
+  FloatSample() : DataSample(CHANNELS*sizeof(float)) {}
+  void *data() { return (void *)m_values; }
+  float m_values[CHANNELS];
+};
+
+static const QuantizedCodec codecs[CHANNELS] = {
+  { 0.05f, -40.0f },            // temperature, C
+  { 0.5f, 0.0f },               // relative humidity, %
+  { 0.1f, 900.0f },             // pressure, hPa
+};
+
+/** Coarser steps for the range of 8 bits codes */
+static const QuantizedCodec codecs8[CHANNELS] = {
+  { 0.5f, -40.0f },
+  { 0.5f, 0.0f },
+  { 0.5f, 950.0f },
+};
+
+template <uint8_t BITS>
+void testCodes()
+{
+  typedef QuantizedSample<BITS, 5> Sample;
+  Sample sample(codecs[0]);
+  for (uint8_t c=0; c<5; c++) {
+    CHECK(! sample.valid(c));
+    CHECK(isnan(sample.get(c)));
+  }
+
+  // the channels are independent
+  srand(BITS);
+  uint16_t codes[5];
+  for (uint8_t c=0; c<5; c++) codes[c] = Sample::NULL_CODE;
+  for (int n=0; n<1000; n++) {
+    uint8_t c = rand() % 5;
+    codes[c] = rand() & Sample::NULL_CODE;
+    sample.setCode(c, codes[c]);
+    for (uint8_t i=0; i<5; i++) CHECK_EQUAL(codes[i], sample.getCode(i));
+  }
+
+  // quantization error is half a step in the range, clamped outside
+  const QuantizedCodec &codec = codecs[0];
+  float top = codec.offset + (Sample::NULL_CODE-1)*codec.scale;
+  float maxError = 0;
+  for (int n=0; n<1000; n++) {
+    float value = codec.offset + (top-codec.offset)*(rand() / (float)RAND_MAX);
+    sample.set(2, value);
+    float error = fabsf(sample.get(2) - value);
+    if ( error > maxError ) maxError = error;
+  }
+  CHECK(maxError <= codec.scale/2 * 1.001f);
+  sample.set(1, codec.offset - 10);
+  CHECK_EQUAL(0, sample.getCode(1));
+  sample.set(1, top + 10);
+  CHECK_EQUAL(Sample::NULL_CODE-1, sample.getCode(1));
+  CHECK(sample.valid(1));
+  sample.set(1, NAN);
+  CHECK(! sample.valid(1));
+  printf("%2u bits: %u bytes for 5 channels, max error %.4f for a step of %.2f\n",
+         BITS, Sample::SIZE, maxError, codec.scale);
+}
+
+/** Fill a timed ring buffer of BUDGET bytes, return the samples held. */
+template <class Sample>
+uint16_t history(const char *name, Sample &sample, void (*setter)(Sample &, int))
+{
+  uint16_t size = BUDGET/sample.size();
+  while ( TimePermRingBuffer::layoutSize(size, sample.size()) > BUDGET ) size--;
+  SimEeprom ee(1024);
+  TimePermRingBuffer timed(ee, 16, size, sample.size(), PERIOD);
+  timed.setTimeStamp(1000 - PERIOD);
+  ee.resetStats();
+  for (int n=0; n<1000; n++) {
+    setter(sample, n);
+    timed.insert(sample, 1000 + n*PERIOD);
+  }
+  printf("%-12s %2u bytes per sample: %4u samples (%5.1f h), %5.2f bytes written per insert\n",
+         name, sample.size(), size, size*PERIOD/3600.0, ee.bytesWritten()/1000.0);
+  return size;
+}
+
+static float value(int channel, int n)
+{
+  static const float base[CHANNELS] = { 21.0f, 45.0f, 1013.0f };
+  return base[channel] + sinf(n*0.01f*(channel+1));
+}
+
+static void setFloat(FloatSample &sample, int n)
+{
+  for (int c=0; c<CHANNELS; c++) sample.m_values[c] = value(c, n);
+}
+
+template <class Sample>
+static void setQuantized(Sample &sample, int n)
+{
+  for (int c=0; c<CHANNELS; c++) sample.set(c, value(c, n));
+}
+
+void testTemporaryCodec()
+{
+  // the shared codec is copied: a braced temporary is fine
+  Quantized12<CHANNELS> sample({ 0.05f, -40.0f });
+  sample.set(0, 21.5f);
+  sample.set(2, -40.0f);
+  CHECK_EQUAL(1230, sample.getCode(0));
+  CHECK(fabsf(sample.get(0) - 21.5f) < 0.001f);
+  CHECK_EQUAL(0, sample.getCode(2));
+}
+
+void testRing()
+{
+  // the samples read back from a ring buffer, and the skipped ones
+  SimEeprom ee(1024);
+  TimePermRingBuffer timed(ee, 16, 20, Quantized12<CHANNELS>::SIZE, PERIOD);
+  Quantized12<CHANNELS> sample(codecs);
+  timed.setTimeStamp(1000 - PERIOD);
+  setQuantized(sample, 0);
+  CHECK(timed.insert(sample, 1000));
+  setQuantized(sample, 1);
+  CHECK(timed.insert(sample, 1000 + 3*PERIOD));
+  Quantized12<CHANNELS> read(codecs);
+  CHECK_EQUAL(1000 + 3*PERIOD, timed.read(0, read));
+  for (int c=0; c<CHANNELS; c++) {
+    CHECK(fabsf(read.get(c) - value(c, 1)) <= codecs[c].scale/2 * 1.001f);
+  }
+  timed.read(1, read);
+  for (int c=0; c<CHANNELS; c++) CHECK(! read.valid(c));
+  timed.read(3, read);
+  CHECK(fabsf(read.get(2) - value(2, 0)) <= codecs[2].scale/2 * 1.001f);
+
+  // history held by the same EEPROM area
+  FloatSample floats;
+  Quantized8<CHANNELS> q8(codecs8);
+  Quantized12<CHANNELS> q12(codecs);
+  Quantized16<CHANNELS> q16(codecs);
+  uint16_t f = history("float", floats, setFloat);
+  uint16_t h8 = history("8 bits", q8, setQuantized<Quantized8<CHANNELS> >);
+  uint16_t h12 = history("12 bits", q12, setQuantized<Quantized12<CHANNELS> >);
+  uint16_t h16 = history("16 bits", q16, setQuantized<Quantized16<CHANNELS> >);
+  CHECK(h16 >= 2*f);
+  CHECK(h12 > h16);
+  CHECK(h8 > h12);
+}
+
+int main(void)
+{
+  testCodes<8>();
+  testCodes<12>();
+  testCodes<16>();
+  testCodes<5>();
+  testTemporaryCodec();
+  testRing();
+  return hostTestReport("quantizedSampleTest");
+}
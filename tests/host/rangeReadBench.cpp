@@ -0,0 +1,110 @@
+/**
+   Compare the ways to dump the history of a TimePermRingBuffer: a loop
+   of read() calls, one getRange() and an Iterator. All must return the
+   same samples and time stamps; the EEPROM read operations, bytes read
+   and wall time of each are reported.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "TimePermRingBuffer.h"
+
+#define SIZE 64
+#define PERIOD 10
+#define LOOPS 2000
+
+static void report(const char *name, SimEeprom &ee, double start)
+{
+  printf("%-10s %6u read ops, %6u bytes read, %7.0f ns per dump\n", name,
+         ee.readOps()/LOOPS, ee.bytesRead()/LOOPS, (now()-start)/LOOPS);
+}
+
+void testRange()
+{
+  SimEeprom ee;
+  EepromRingBuffer ring(ee, 0, 10, sizeof(int16_t));
+  for (int16_t i=1; i<=13; i++) ring.push((void *)&i);
+
+  int16_t out[10];
+  ring.getRange(0, 10, (void *)out);
+  for (int i=0; i<10; i++) CHECK_EQUAL(4+i, out[i]);
+  // across the end of the buffer: two reads only
+  ee.resetStats();
+  ring.getRange(2, 5, (void *)out);
+  CHECK(ee.readOps() <= 2);
+  for (int i=0; i<5; i++) CHECK_EQUAL(7+i, out[i]);
+  ring.getRange(-3, 2, (void *)out);
+  int16_t a, b;
+  ring.get(-2, (void *)&a);
+  ring.get(-3, (void *)&b);
+  CHECK_EQUAL(a, out[0]);
+  CHECK_EQUAL(b, out[1]);
+
+  EepromRingBuffer::Iterator forward(ring);
+  int16_t expected = 4;
+  while ( forward.next((void *)&a) ) {
+    CHECK_EQUAL(expected, a);
+    CHECK_EQUAL(13-expected, forward.index());
+    expected++;
+  }
+  CHECK_EQUAL(14, expected);
+}
+
+void benchDump()
+{
+  SimEeprom ee(2048);
+  TimePermRingBuffer timed(ee, 0, SIZE, sizeof(int16_t), PERIOD);
+  ShortSample sample;
+  long t = 1000;
+  for (int16_t i=0; i<100; i++) {
+    sample.m_value = i;
+    t += ( i % 7 == 0 ) ? 2*PERIOD : PERIOD;
+    timed.insert(sample, t);
+  }
+
+  int16_t loop[SIZE];
+  long loopTime[SIZE];
+  ee.resetStats();
+  double start = now();
+  for (int n=0; n<LOOPS; n++) {
+    for (int i=0; i<SIZE; i++) {
+      loopTime[i] = timed.read(i, sample);
+      loop[i] = sample.m_value;
+    }
+  }
+  report("read()", ee, start);
+
+  int16_t range[SIZE];
+  ee.resetStats();
+  start = now();
+  for (int n=0; n<LOOPS; n++) {
+    timed.getRange(0, SIZE, (void *)range);
+  }
+  report("getRange()", ee, start);
+  for (int i=0; i<SIZE; i++) CHECK_EQUAL(loop[i], range[SIZE-1-i]);
+
+  ee.resetStats();
+  start = now();
+  for (int n=0; n<LOOPS; n++) {
+    TimePermRingBuffer::Iterator it(timed, true);
+    int i = 0;
+    while ( it.next(sample) ) {
+      if ( n == 0 ) {
+        CHECK_EQUAL(loop[i], sample.m_value);
+        CHECK_EQUAL(loopTime[i], it.time());
+        CHECK_EQUAL(i, it.index());
+      }
+      i++;
+    }
+    if ( n == 0 ) CHECK_EQUAL(SIZE, i);
+  }
+  report("Iterator", ee, start);
+}
+
+int main(void)
+{
+  testRange();
+  benchDump();
+  return hostTestReport("rangeReadBench");
+}
@@ -0,0 +1,377 @@
+/**
+   Host test of SimEeprom, and of the classes built on SafeEeprom running
+   on top of the simulated EEPROM.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+#include "TimePermRingBuffer.h"
+
+#include <string.h>
+
+struct Sample {
+  int16_t a;
+  int16_t b;
+};
+
+void testAccess()
+{
+  SimEeprom ee(256, 4);
+
+  CHECK_EQUAL(256, ee.memSize());
+  CHECK_EQUAL(4, ee.pageSize());
+  CHECK_EQUAL(0xFF, ee.read_byte(17));
+
+  ee.write_byte(3, 0x12);
+  ee.write_word(8, 0xBEEF);
+  ee.write_long(12, 0xDEADBEEFul);
+  uint8_t block[6] = { 1, 2, 3, 4, 5, 6 };
+  ee.write_block(30, block, sizeof(block));
+
+  CHECK_EQUAL(0x12, ee.read_byte(3));
+  CHECK_EQUAL(0xBEEF, ee.read_word(8));
+  CHECK_EQUAL(0xDEADBEEFul, ee.read_long(12));
+  uint8_t back[6];
+  ee.read_block(30, back, sizeof(back));
+  CHECK(memcmp(block, back, sizeof(block)) == 0);
+
+  // out of bound writes are dropped
+  ee.write_long(254, 0);
+  CHECK_EQUAL(0xFF, ee.read_byte(254));
+  CHECK_EQUAL(0xFF, ee.read_byte(255));
+}
+
+void testWear()
+{
+  SimEeprom avr(64, 4);
+  uint8_t block[8] = { 0 };
+
+  // AVR like: one program per byte
+  avr.write_block(2, block, sizeof(block));
+  CHECK_EQUAL(8, avr.pagePrograms());
+  CHECK_EQUAL(8, avr.bytesWritten());
+  CHECK_EQUAL(2, avr.pageCycles(0));
+  CHECK_EQUAL(4, avr.pageCycles(1));
+  CHECK_EQUAL(2, avr.pageCycles(2));
+  CHECK_EQUAL(4, avr.maxPageCycles());
+  CHECK_EQUAL(8*SIM_EEPROM_PROGRAM_US, avr.deviceTime());
+
+  // page buffer: one program per page covered
+  SimEeprom ext(64, 4, true);
+  ext.write_block(2, block, sizeof(block));
+  CHECK_EQUAL(3, ext.pagePrograms());
+  CHECK_EQUAL(1, ext.pageCycles(0));
+  CHECK_EQUAL(1, ext.pageCycles(1));
+  CHECK_EQUAL(1, ext.pageCycles(2));
+  CHECK_EQUAL(0, ext.pageCycles(3));
+
+  ext.setProgramTime(5000);
+  ext.resetStats();
+  ext.write_word(4, 0);
+  CHECK_EQUAL(1, ext.pagePrograms());
+  CHECK_EQUAL(5000, ext.deviceTime());
+  CHECK_EQUAL(2, ext.pageCycles(1));
+
+  ext.read_block(0, block, sizeof(block));
+  ext.read_byte(0);
+  CHECK_EQUAL(9, ext.bytesRead());
+  CHECK_EQUAL(2, ext.readOps());
+}
+
+void testUpdate()
+{
+  SimEeprom avr(64, 4);
+  uint8_t block[8] = { 0xFF, 0xFF, 1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+  // AVR like: only the byte which differs is programmed
+  avr.update_block(0, block, sizeof(block));
+  CHECK_EQUAL(1, avr.pagePrograms());
+  CHECK_EQUAL(7, avr.avoidedPrograms());
+  avr.update_long(0, 0xFF01FFFFul);
+  CHECK_EQUAL(1, avr.pagePrograms());
+  CHECK_EQUAL(11, avr.avoidedPrograms());
+  avr.update_byte(2, 2);
+  avr.update_word(4, 0x0102);
+  CHECK_EQUAL(2, avr.read_byte(2));
+  CHECK_EQUAL(0x0102, avr.read_word(4));
+  CHECK_EQUAL(4, avr.pagePrograms());
+
+  // page buffer: one program per page with a modified byte
+  SimEeprom ext(64, 4, true);
+  ext.update_block(0, block, sizeof(block));
+  CHECK_EQUAL(1, ext.pagePrograms());
+  CHECK_EQUAL(1, ext.avoidedPrograms());
+  CHECK_EQUAL(1, ext.pageCycles(0));
+  CHECK_EQUAL(0, ext.pageCycles(1));
+}
+
+void testFill()
+{
+  SimEeprom avr(64, 4);
+  avr.write_byte(1, 0);
+  avr.resetStats();
+  avr.erase(0, 8);
+  // only the byte which was not erased is programmed, with erase only
+  CHECK_EQUAL(1, avr.pagePrograms());
+  CHECK_EQUAL(7, avr.avoidedPrograms());
+  CHECK_EQUAL(SIM_EEPROM_SPLIT_US, avr.deviceTime());
+  avr.fill(0, 0x55, 2);
+  CHECK_EQUAL(0x5555, avr.read_word(0));
+  CHECK_EQUAL(SIM_EEPROM_SPLIT_US*3, avr.deviceTime());
+  avr.fill(1, 0xAA, 1);
+  CHECK_EQUAL(SIM_EEPROM_SPLIT_US*3+SIM_EEPROM_PROGRAM_US, avr.deviceTime());
+
+  SimEeprom ext(64, 4, true);
+  ext.fill(2, 0, 12);
+  CHECK_EQUAL(4, ext.pagePrograms());
+  CHECK_EQUAL(0, ext.read_long(4));
+  CHECK_EQUAL(0xFFFF, ext.read_word(0));
+  CHECK_EQUAL(0xFFFF, ext.read_word(14));
+}
+
+void testAvoidedPrograms()
+{
+  SimEeprom ee;
+  EepromRingBuffer ring(ee, 256, 32, 4, 4);
+  EnduranceEeprom endurance(ee, 0, 8, sizeof(Sample));
+  Sample s = { 12, 34 };
+  ee.resetStats();
+  ring.clear();
+  for (int i=0; i<16; i++) {
+    endurance.writeData((void *)&s);
+  }
+  printf("clear of a cleared ring + 16 identical endurance writes: "
+         "%u page programs, %u avoided\n", ee.pagePrograms(), ee.avoidedPrograms());
+  CHECK(ee.avoidedPrograms() >= 32*4);
+}
+
+void testImage()
+{
+  const char *path = "simEepromTest.img";
+  SimEeprom ee(128);
+  ee.write_long(40, 0x01020304ul);
+  CHECK(ee.save(path));
+
+  SimEeprom copy(128);
+  CHECK(copy.load(path));
+  CHECK_EQUAL(0x01020304ul, copy.read_long(40));
+  CHECK_EQUAL(0, copy.pagePrograms());
+
+  // a shorter image leaves the rest erased
+  SimEeprom small(32);
+  small.write_byte(5, 0x42);
+  CHECK(small.save(path));
+  CHECK(copy.load(path));
+  CHECK_EQUAL(0x42, copy.read_byte(5));
+  CHECK_EQUAL(0xFF, copy.read_byte(43));
+  remove(path);
+  CHECK(! copy.load(path));
+}
+
+void testEndurance()
+{
+  SimEeprom ee;
+  Sample s = { 0, 0 };
+  {
+    EnduranceEeprom endurance(ee, 128, 4, sizeof(Sample));
+    for (int i=0; i<10; i++) {
+      s.a = i;
+      s.b = 10*i;
+      endurance.writeData((void *)&s);
+    }
+  }
+  // a new instance on the same memory recovers the last sample
+  EnduranceEeprom recovered(ee, 128, 4, sizeof(Sample));
+  Sample r;
+  CHECK(recovered.readData((void *)&r));
+  CHECK_EQUAL(9, r.a);
+  CHECK_EQUAL(90, r.b);
+
+  // the CRC comes from RAM: the data is only read back to be verified
+  s.a = 11;
+  ee.resetStats();
+  recovered.writeData((void *)&s);
+  uint32_t plainReads = ee.bytesRead();
+  recovered.setVerify(true);
+  s.a = 12;
+  ee.resetStats();
+  CHECK(recovered.writeData((void *)&s));
+  CHECK_EQUAL(plainReads+sizeof(Sample), ee.bytesRead());
+}
+
+/** SimEeprom losing the next block update, to check the verification. */
+class LossyEeprom : public SimEeprom
+{
+public:
+  LossyEeprom() : m_lose(false) {}
+  void update_block(uint16_t addr, void* data, size_t len) {
+    if ( m_lose ) {
+      m_lose = false;
+      return;
+    }
+    SimEeprom::update_block(addr, data, len);
+  }
+  bool m_lose;
+};
+
+void testVerify()
+{
+  LossyEeprom ee;
+  EnduranceEeprom endurance(ee, 0, 4, sizeof(Sample));
+  endurance.setVerify(true);
+  Sample s = { 1, 10 };
+  CHECK(endurance.writeData((void *)&s));
+
+  // the lost write is detected, and the previous sample is kept
+  ee.m_lose = true;
+  s.a = 2;
+  CHECK(! endurance.writeData((void *)&s));
+  Sample r;
+  CHECK(endurance.readData((void *)&r));
+  CHECK_EQUAL(1, r.a);
+  EnduranceEeprom recovered(ee, 0, 4, sizeof(Sample));
+  CHECK(recovered.readData((void *)&r));
+  CHECK_EQUAL(1, r.a);
+
+  // without verification, the lost write shows up as a CRC error
+  recovered.setVerify(false);
+  ee.m_lose = true;
+  CHECK(recovered.writeData((void *)&s));
+  CHECK(! recovered.readData((void *)&r));
+}
+
+void testPushMany()
+{
+  SimEeprom one;
+  SimEeprom many;
+  EepromRingBuffer ringOne(one, 0, 6, sizeof(int16_t), 4);
+  EepromRingBuffer ringMany(many, 0, 6, sizeof(int16_t), 4);
+  int16_t samples[14];
+  for (int16_t i=0; i<14; i++) samples[i] = 100+i;
+
+  // 4 samples, then 3 across the end of the buffer, then more than it holds
+  one.resetStats();
+  many.resetStats();
+  uint16_t batches[3] = { 4, 3, 7 };
+  uint16_t next = 0;
+  for (uint8_t b=0; b<3; b++) {
+    for (uint16_t i=0; i<batches[b]; i++) {
+      ringOne.push((void *)&samples[next+i]);
+    }
+    ringMany.pushMany((void *)&samples[next], batches[b]);
+    next += batches[b];
+    CHECK_EQUAL(ringOne.currentIndex(), ringMany.currentIndex());
+  }
+  for (int i=0; i<6; i++) {
+    int16_t a, b;
+    ringOne.get(i, (void *)&a);
+    ringMany.get(i, (void *)&b);
+    CHECK_EQUAL(113-i, b);
+    CHECK_EQUAL(a, b);
+  }
+  // the index is committed once per batch
+  CHECK(many.pagePrograms() < one.pagePrograms());
+  printf("14 samples: %u programs with push, %u with pushMany\n",
+         one.pagePrograms(), many.pagePrograms());
+
+  ringMany.pushMany((void *)samples, 0);
+  CHECK_EQUAL(ringOne.currentIndex(), ringMany.currentIndex());
+}
+
+void testRingBuffers()
+{
+  SimEeprom ee;
+  {
+    EepromRingBuffer ring(ee, 256, 6, sizeof(int16_t), 2);
+    for (int16_t i=1; i<=8; i++) {
+      ring.push((void *)&i);
+    }
+  }
+  EepromRingBuffer ring(ee, 256, 6, sizeof(int16_t), 2);
+  int16_t value;
+  ring.get(0, (void *)&value);
+  CHECK_EQUAL(8, value);
+  ring.get(5, (void *)&value);
+  CHECK_EQUAL(3, value);
+  ring.get(-1, (void *)&value);
+  CHECK_EQUAL(3, value);
+
+  // rotate across the end of the buffer: 9, 10, null, null, 12
+  for (int16_t i=9; i<=10; i++) {
+    ring.push((void *)&i);
+  }
+  ring.rotate(2);
+  int16_t twelve = 12;
+  ring.push((void *)&twelve);
+  ring.get(0, (void *)&value);
+  CHECK_EQUAL(12, value);
+  ring.get(1, (void *)&value);
+  CHECK_EQUAL(-1, value);
+  ring.get(2, (void *)&value);
+  CHECK_EQUAL(-1, value);
+  ring.get(3, (void *)&value);
+  CHECK_EQUAL(10, value);
+  ring.get(4, (void *)&value);
+  CHECK_EQUAL(9, value);
+
+  testPushMany();
+
+  TimePermRingBuffer timed(ee, 512, 8, sizeof(int16_t), 2);
+  ShortSample sample;
+  sample.m_value = 7;
+  CHECK(timed.insert(sample, 100));
+  CHECK(! timed.insert(sample, 101));
+  sample.m_value = 8;
+  CHECK(timed.insert(sample, 106));
+  CHECK_EQUAL(106, timed.lastTimeStamp());
+  CHECK_EQUAL(106, timed.read(0, sample));
+  CHECK_EQUAL(8, sample.m_value);
+  // two samples were missed and filled with 0xFF
+  CHECK_EQUAL(104, timed.read(1, sample));
+  CHECK_EQUAL(-1, sample.m_value);
+  CHECK_EQUAL(100, timed.read(3, sample));
+  CHECK_EQUAL(7, sample.m_value);
+
+  // the time stamp is kept in RAM: a rejected insert does not access
+  // the EEPROM, and a read only reads the sample
+  ee.resetStats();
+  CHECK(! timed.insert(sample, 107));
+  CHECK_EQUAL(106, timed.lastTimeStamp());
+  CHECK_EQUAL(0, ee.readOps());
+  CHECK_EQUAL(106, timed.read(0, sample));
+  CHECK_EQUAL(1, ee.readOps());
+  TimePermRingBuffer reloaded(ee, 512, 8, sizeof(int16_t), 2);
+  CHECK_EQUAL(106, reloaded.lastTimeStamp());
+
+  // a corrupted time stamp restarts the buffer with the next insert
+  uint16_t stamp = 512 + reloaded.storageSize()
+    - EnduranceEepromBase::layoutSize(8, sizeof(long));
+  for (uint16_t a=stamp; a<512+reloaded.storageSize(); a++) ee.write_byte(a, 0x5A);
+  TimePermRingBuffer corrupted(ee, 512, 8, sizeof(int16_t), 2);
+  CHECK_EQUAL(TIMEPERM_NO_TIME, corrupted.lastTimeStamp());
+  corrupted.read(3, sample);
+  CHECK_EQUAL(-1, sample.m_value);
+  sample.m_value = 9;
+  CHECK(corrupted.insert(sample, 201));
+  TimePermRingBuffer restarted(ee, 512, 8, sizeof(int16_t), 2);
+  CHECK_EQUAL(201, restarted.lastTimeStamp());
+  CHECK_EQUAL(201, restarted.read(0, sample));
+  CHECK_EQUAL(9, sample.m_value);
+}
+
+int main(void)
+{
+  testAccess();
+  testWear();
+  testUpdate();
+  testFill();
+  testAvoidedPrograms();
+  testImage();
+  testEndurance();
+  testVerify();
+  testRingBuffers();
+  return hostTestReport("simEepromTest");
+}
@@ -0,0 +1,244 @@
+/**
+   Host test of TimeArchive: days of samples with missed samples, late
+   inserts, a long downtime and a restart are inserted in a primary
+   buffer of one minute samples and two consolidated levels (10 minutes
+   min/max/avg, hourly average). Every record of the levels is checked
+   against the samples inserted. Reports the EEPROM budget of each level
+   and the write amplification of the consolidation.
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimEeprom.h"
+#include "TimePermRingBuffer.h"
+#include "TimeArchive.h"
+
+#define CHANNELS 2
+#define PERIOD 60
+#define PRIMARY_SIZE 60         // 1 hour
+#define L1_STEPS 10
+#define L1_SIZE 48              // 8 hours
+#define L1_FUNCTIONS (ARCHIVE_MIN|ARCHIVE_MAX|ARCHIVE_AVG)
+#define L2_STEPS 60
+#define L2_SIZE 168             // 1 week
+#define L2_FUNCTIONS ARCHIVE_AVG
+#define SAMPLES 20000
+
+static_assert(ConsolidatedSample::recordSize(CHANNELS, L1_FUNCTIONS) == 12,
+              "record of min, max and avg");
+static_assert(ConsolidatedSample::recordSize(CHANNELS, L2_FUNCTIONS) == 4,
+              "record of avg");
+
+class Sample : public DataSample
+{
+public:
+  Sample() : DataSample(CHANNELS*sizeof(int16_t)) {}
+  void *data() { return (void *)m_values; }
+  int16_t m_values[CHANNELS];
+};
+
+/** Samples inserted, and the run (restart count) inserting them. */
+struct History {
+  long time[SAMPLES];
+  int16_t values[SAMPLES][CHANNELS];
+  int run[SAMPLES];
+  int n;
+};
+
+/** The rings of the archive, opened from the EEPROM. */
+struct Rings {
+  Rings(SafeEeprom &ee) :
+    primary(ee, 0, PRIMARY_SIZE, CHANNELS*sizeof(int16_t), PERIOD),
+    level1(ee, primary.storageSize(), L1_SIZE,
+           ConsolidatedSample::recordSize(CHANNELS, L1_FUNCTIONS), L1_STEPS*PERIOD),
+    level2(ee, primary.storageSize() + level1.storageSize(), L2_SIZE,
+           ConsolidatedSample::recordSize(CHANNELS, L2_FUNCTIONS), L2_STEPS*PERIOD),
+    archive(primary, CHANNELS) {
+    CHECK(archive.addLevel(level1, L1_STEPS, L1_FUNCTIONS));
+    CHECK(archive.addLevel(level2, L2_STEPS, L2_FUNCTIONS));
+  }
+  TimePermRingBuffer primary;
+  TimePermRingBuffer level1;
+  TimePermRingBuffer level2;
+  TimeArchive archive;
+};
+
+/** Check the records of a level against the samples of the history. */
+static void checkLevel(TimePermRingBuffer &ring, uint16_t steps, uint8_t functions,
+                       History &h)
+{
+  long period = (long)steps*PERIOD;
+  ConsolidatedSample record(CHANNELS, functions);
+  TimePermRingBuffer::Iterator it(ring);
+  int records = 0, nulls = 0, errors = 0;
+  while ( it.next(record) && errors < 5 ) {
+    long start = it.time();
+    // samples of the period, from the last run inserting in the period
+    int first = -1, last = -1;
+    for (int i=0; i<h.n; i++) {
+      if ( h.time[i] >= start && h.time[i] < start + period ) {
+        if ( first < 0 || h.run[i] != h.run[first] ) first = i;
+        last = i;
+      }
+    }
+    // the period is recorded when it is complete, or when a later
+    // sample is inserted by the same run
+    bool recorded = last >= 0
+      && ( h.time[last] + PERIOD >= start + period
+           || ( last+1 < h.n && h.run[last+1] == h.run[last] ) );
+    records++;
+    if ( ! recorded ) {
+      nulls++;
+      if ( record.valid() ) errors++;
+      for (uint8_t c=0; c<CHANNELS; c++) {
+        if ( record.avg(c) != CONSOLIDATED_NULL ) errors++;
+      }
+      continue;
+    }
+    if ( ! record.valid() ) errors++;
+    for (uint8_t c=0; c<CHANNELS; c++) {
+      int16_t lo = h.values[first][c], hi = lo;
+      long sum = 0;
+      int count = 0;
+      for (int i=first; i<=last; i++) {
+        if ( h.values[i][c] < lo ) lo = h.values[i][c];
+        if ( h.values[i][c] > hi ) hi = h.values[i][c];
+        sum += h.values[i][c];
+        count++;
+      }
+      int16_t avg = (sum + count/2) / count;
+      if ( (functions & ARCHIVE_MIN) && record.min(c) != lo ) errors++;
+      if ( (functions & ARCHIVE_MAX) && record.max(c) != hi ) errors++;
+      if ( (functions & ARCHIVE_AVG) && record.avg(c) != avg ) {
+        printf("record at %ld, channel %u: avg %d for %d\n", start, c, record.avg(c), avg);
+        errors++;
+      }
+    }
+  }
+  CHECK_EQUAL(0, errors);
+  CHECK(records > nulls);
+}
+
+void testRecord()
+{
+  ConsolidatedSample record(3, ARCHIVE_MIN|ARCHIVE_AVG);
+  CHECK_EQUAL(12, record.size());
+  CHECK(! record.valid());
+  CHECK_EQUAL(CONSOLIDATED_NULL, record.min(0));
+
+  // -1 is a value as any other, the null value is clamped
+  record.set(ARCHIVE_MIN, 0, -1);
+  record.set(ARCHIVE_MIN, 2, INT16_MIN);
+  record.set(ARCHIVE_AVG, 1, CONSOLIDATED_NULL);
+  record.set(ARCHIVE_MAX, 1, 5);
+  CHECK(record.valid());
+  CHECK_EQUAL(-1, record.min(0));
+  CHECK_EQUAL(INT16_MIN, record.min(2));
+  CHECK_EQUAL(CONSOLIDATED_NULL-1, record.avg(1));
+  CHECK_EQUAL(CONSOLIDATED_NULL, record.max(1));
+  CHECK_EQUAL(CONSOLIDATED_NULL, record.avg(3));
+
+  // the erased EEPROM reads as a missing record
+  memset(record.data(), 0xFF, record.size());
+  CHECK(! record.valid());
+  CHECK_EQUAL(CONSOLIDATED_NULL, record.min(0));
+}
+
+void testHistory()
+{
+  static History h;
+  SimEeprom ee(2048);
+  Sample sample;
+  h.n = 0;
+  srand(25);
+  long t = 7*24*3600L*1000;     // aligned on the hour
+  int run = 0;
+  Rings *rings = new Rings(ee);
+  rings->primary.setTimeStamp(t - PERIOD);
+  for (int n=0; n<SAMPLES; n++) {
+    int r = rand() % 1000;
+    // missed samples, and a downtime longer than the first level
+    t += ( r < 20 ) ? (1 + rand() % 30)*PERIOD : ( r == 20 ) ? 700L*PERIOD : PERIOD;
+    for (uint8_t c=0; c<CHANNELS; c++) {
+      sample.m_values[c] = ( c == 0 ) ? 2000 + rand() % 500 : rand() % 30000;
+    }
+    if ( r > 990 ) {
+      // the archive is opened again: the current periods restart
+      delete rings;
+      rings = new Rings(ee);
+      run++;
+    }
+    if ( r == 30 ) CHECK(! rings->archive.insert(sample, t - PERIOD/2));
+    CHECK(rings->archive.insert(sample, t));
+    // the same period again is not consolidated twice
+    if ( r == 31 ) CHECK(rings->archive.insert(sample, t));
+    h.time[h.n] = t;
+    memcpy(h.values[h.n], sample.m_values, sizeof(sample.m_values));
+    h.run[h.n] = run;
+    h.n++;
+    if ( n % 2000 == 1999 ) {
+      checkLevel(rings->level1, L1_STEPS, L1_FUNCTIONS, h);
+      checkLevel(rings->level2, L2_STEPS, L2_FUNCTIONS, h);
+    }
+  }
+  CHECK(run > 5);
+  CHECK_EQUAL(t, rings->primary.lastTimeStamp());
+  delete rings;
+}
+
+/** Insert the same samples in a primary buffer alone, and in an archive. */
+void testBudget()
+{
+  SimEeprom eeAlone(2048);
+  SimEeprom ee(2048);
+  TimePermRingBuffer alone(eeAlone, 0, PRIMARY_SIZE, CHANNELS*sizeof(int16_t), PERIOD);
+  Rings rings(ee);
+  Sample sample;
+  long t = 3600;
+  alone.setTimeStamp(t - PERIOD);
+  rings.primary.setTimeStamp(t - PERIOD);
+  eeAlone.resetStats();
+  ee.resetStats();
+  for (int n=0; n<SAMPLES; n++) {
+    sample.m_values[0] = n;
+    sample.m_values[1] = -n;
+    t += PERIOD;
+    alone.insert(sample, t);
+    rings.archive.insert(sample, t);
+  }
+  // the consolidation does not read back the history
+  CHECK_EQUAL(eeAlone.readOps(), ee.readOps());
+
+  TimeArchive &archive = rings.archive;
+  CHECK_EQUAL(rings.primary.storageSize() + rings.level1.storageSize()
+              + rings.level2.storageSize(), archive.storageSize());
+  CHECK(archive.storageSize() <= ee.memSize());
+  for (uint8_t l=0; l<=archive.levels(); l++) {
+    TimePermRingBuffer &ring = archive.ring(l);
+    printf("level %u: %2u bytes per record, every %5d s, %4u bytes for %6.1f h\n",
+           l, ring.dataSize(), ring.period(), ring.storageSize(),
+           ring.timeSpan()/3600.0);
+  }
+  double aloneBytes = (double)eeAlone.bytesWritten()/SAMPLES;
+  double archiveBytes = (double)ee.bytesWritten()/SAMPLES;
+  float inserts = archive.insertsPerSample();
+  CHECK(inserts > 1.11f && inserts < 1.12f);
+  CHECK(archive.bytesPerSample() > 5.26f && archive.bytesPerSample() < 5.27f);
+  // each level adds 1/steps of the writes of an insert, and a larger record
+  CHECK(archiveBytes <= aloneBytes*inserts + 2);
+  printf("total %u bytes of EEPROM, %.2f inserts and %.2f bytes of records per sample\n",
+         archive.storageSize(), inserts, archive.bytesPerSample());
+  printf("%.2f bytes written per sample (primary alone %.2f): write amplification x%.3f\n",
+         archiveBytes, aloneBytes, archiveBytes/aloneBytes);
+}
+
+int main(void)
+{
+  testRecord();
+  testHistory();
+  testBudget();
+  return hostTestReport("timeArchiveTest");
+}
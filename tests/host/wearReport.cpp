@@ -0,0 +1,108 @@
+/**
+   Wear analytics of the EEPROM structures.
+
+   WearCounter must count the same page cycles as SimEeprom, on a byte
+   and on a page programming device. The lifetime of EnduranceEeprom,
+   EepromRingBuffer and TimePermRingBuffer instances with several
+   endurance factors is then projected, for one write per minute.
+*/
+
+#include "hostTest.h"
+
+#include "SimEeprom.h"
+#include "WearCounter.h"
+#include "EnduranceEeprom.h"
+#include "EepromRingBuffer.h"
+#include "TimePermRingBuffer.h"
+
+#define WRITES 5000
+#define PER_DAY (24*60.0f)
+
+/** WearCounter and SimEeprom agree on every page. */
+void testAgreement(uint16_t pageSize, bool pageWrite)
+{
+  SimEeprom ee(1024, pageSize, pageWrite);
+  static uint32_t counters[256];
+  // watch from the second page to the end
+  WearCounter counter(ee, counters, 1024/pageSize - 1, pageSize, pageWrite);
+
+  EnduranceEeprom endurance(counter, 0, 4, 6);
+  EepromRingBuffer ring(counter, 100, 10, 3, 2);
+  TimePermRingBuffer timed(counter, 300, 16, sizeof(int32_t), 10);
+  LongSample sample;
+  for (int i=0; i<500; i++) {
+    uint8_t data[6] = { (uint8_t)i, 1, 2, 3, 4, (uint8_t)(i/7) };
+    endurance.writeData((void *)data);
+    ring.push((void *)data);
+    if ( i % 50 == 0 ) ring.rotate(i % 13);
+    sample.m_value = i;
+    timed.insert(sample, 1000 + 10*i + ( i % 37 == 0 ? 40 : 0 ));
+    counter.write_long(600 + 4*(i % 8), i);
+    counter.update_word(700, i / 3);
+    counter.fill(800, i / 10, 40);
+  }
+
+  bool same = true;
+  for (uint16_t page=1; page<1024/pageSize; page++) {
+    if ( counter.pageCycles(page) != ee.pageCycles(page) ) {
+      CHECK_EQUAL(ee.pageCycles(page), counter.pageCycles(page));
+      same = false;
+      break;
+    }
+  }
+  CHECK(same);
+  // the first page is not watched
+  CHECK_EQUAL(0, counter.pageCycles(0));
+  CHECK(ee.pageCycles(0) > 0);
+
+  WearProjection p = projectWear(ee, ring, 500, PER_DAY);
+  WearProjection q = projectWear(counter, ring, 500, PER_DAY);
+  CHECK_EQUAL(p.cycles, q.cycles);
+  CHECK_EQUAL(p.page, q.page);
+  CHECK(p.days > 0);
+}
+
+template <class Structure>
+void report(const char *name, int factor, SimEeprom &ee, Structure &s)
+{
+  WearProjection p = projectWear(ee, s, WRITES, PER_DAY);
+  printf("%-20s %6d %6u %6u %12.2f %10.0f %8.1f\n", name, factor, s.storageSize(),
+         p.page, p.cyclesPerWrite, p.days, p.days/365);
+}
+
+void lifetimes()
+{
+  printf("%-20s %6s %6s %6s %12s %10s %8s\n", "structure", "endur", "bytes",
+         "page", "cycles/write", "days", "years");
+  uint16_t factors[] = { 1, 4, 16, 64 };
+  for (unsigned i=0; i<sizeof(factors)/sizeof(factors[0]); i++) {
+    SimEeprom ee(2048);
+    EnduranceEeprom endurance(ee, 0, factors[i], sizeof(uint32_t));
+    for (uint32_t w=0; w<WRITES; w++) endurance.writeData((void *)&w);
+    report("EnduranceEeprom", factors[i], ee, endurance);
+  }
+  for (unsigned i=0; i<sizeof(factors)/sizeof(factors[0]); i++) {
+    SimEeprom ee(2048);
+    EepromRingBuffer ring(ee, 0, 32, sizeof(uint32_t), factors[i]);
+    for (uint32_t w=0; w<WRITES; w++) ring.push((void *)&w);
+    report("EepromRingBuffer", factors[i], ee, ring);
+  }
+  for (unsigned i=0; i<sizeof(factors)/sizeof(factors[0]); i++) {
+    SimEeprom ee(2048);
+    TimePermRingBuffer timed(ee, 0, 32, sizeof(int32_t), 60, factors[i]);
+    LongSample sample;
+    for (uint32_t w=0; w<WRITES; w++) {
+      sample.m_value = w;
+      timed.insert(sample, 60*(w+1000));
+    }
+    report("TimePermRingBuffer", factors[i], ee, timed);
+  }
+}
+
+int main(void)
+{
+  testAgreement(4, false);
+  testAgreement(32, true);
+  lifetimes();
+  return hostTestReport("wearReport");
+}
@@ -0,0 +1,243 @@
+/**
+   Host test of EepromWriteQueue and EepromAsyncWriter, the queue behind
+   the non blocking writes of AvrEeprom.
+
+   SimReadyPort simulates the EEPROM registers of the AVR on top of a
+   SimEeprom: the ready interrupt (EepromAsyncWriter::onReady(), as
+   called by the EE_READY vector) fires whenever the simulated clock
+   passes the end of the current byte program, and the interrupt is
+   enabled. Each access of the main program to the port costs
+   MAIN_OP_US, and lets the interrupt fire.
+*/
+
+#include "hostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SimEeprom.h"
+#include "EepromWriteQueue.h"
+
+#define MAIN_OP_US 20           // cpu time of one main program operation
+
+class SimReadyPort;
+typedef EepromAsyncWriter<SimReadyPort> SimWriter;
+
+class SimReadyPort
+{
+public:
+  SimReadyPort(SimEeprom &ee) :
+    m_ee(ee), m_writer(0), m_clock(0), m_readyAt(0), m_enabled(false),
+    m_inIsr(false), m_waited(0) {
+  }
+
+  uint8_t read(uint16_t addr) {
+    // the device must be ready: a read during a program is lost
+    CHECK(m_clock >= m_readyAt);
+    mainOp();
+    return m_ee.read_byte(addr);
+  }
+
+  void readBlock(uint16_t addr, uint8_t *dst, size_t len) {
+    CHECK(m_clock >= m_readyAt);
+    mainOp();
+    m_ee.read_block(addr, dst, len);
+  }
+
+  void program(uint16_t addr, uint8_t current, uint8_t data) {
+    CHECK_EQUAL(current, m_ee.read_byte(addr));
+    uint64_t start = m_ee.deviceTime();
+    m_ee.write_byte(addr, data);
+    m_readyAt = m_clock + (m_ee.deviceTime() - start);
+  }
+
+  void waitReady() {
+    if ( m_clock < m_readyAt ) {
+      m_waited += m_readyAt - m_clock;
+      m_clock = m_readyAt;
+    }
+    mainOp();
+  }
+
+  bool readyEnabled() {
+    return m_enabled;
+  }
+
+  void enableReady() {
+    m_enabled = true;
+    mainOp();
+  }
+
+  void disableReady() {
+    m_enabled = false;
+  }
+
+  void waitQueue() {
+    advance(MAIN_OP_US);
+    m_waited += MAIN_OP_US;
+  }
+
+  /** Let time pass, firing the interrupt each time the EEPROM is ready. */
+  void advance(uint32_t us) {
+    m_clock += us;
+    while ( m_enabled && m_clock >= m_readyAt ) {
+      m_inIsr = true;
+      m_writer->onReady();
+      m_inIsr = false;
+    }
+  }
+
+  SimEeprom &m_ee;
+  SimWriter *m_writer;
+  uint64_t m_clock;
+  uint64_t m_readyAt;
+  bool m_enabled;
+  bool m_inIsr;
+  uint32_t m_waited;            /** Time the main program waited (queue
+                                    full, or device busy) */
+
+protected:
+  /** The main program runs, and can be interrupted. */
+  void mainOp() {
+    if ( ! m_inIsr ) advance(MAIN_OP_US);
+  }
+};
+
+/** A writer driven by the simulated interrupt. */
+struct SimDevice {
+  SimDevice(SimEeprom &ee) : port(ee), writer(port) {
+    port.m_writer = &writer;
+  }
+  SimReadyPort port;
+  SimWriter writer;
+};
+
+void testQueue()
+{
+  EepromWriteQueue q;
+  uint16_t addr;
+  uint8_t data;
+
+  CHECK_EQUAL(0, q.pending());
+  CHECK(! q.pop(addr, data));
+  CHECK(! q.lookup(0, data));
+
+  for (uint8_t i=0; i<EEPROM_QUEUE_SIZE; i++) {
+    CHECK(q.push(i % 4, i));
+  }
+  CHECK(q.full());
+  CHECK(! q.push(100, 1));
+  CHECK_EQUAL(EEPROM_QUEUE_SIZE, q.pending());
+
+  // the newest value queued for an address wins
+  CHECK(q.lookup(3, data));
+  CHECK_EQUAL(EEPROM_QUEUE_SIZE-1, data);
+  CHECK(! q.lookup(4, data));
+
+  // first in, first out, across the wrap of the indexes
+  for (uint16_t n=0; n<300; n++) {
+    CHECK(q.pop(addr, data));
+    CHECK_EQUAL(n % 4, addr);
+    CHECK_EQUAL(n & 0xFF, data);
+    CHECK(q.push((n+EEPROM_QUEUE_SIZE) % 4, n+EEPROM_QUEUE_SIZE));
+  }
+  CHECK_EQUAL(EEPROM_QUEUE_SIZE, q.pending());
+}
+
+void testReadYourWrites()
+{
+  SimEeprom ee(1024);
+  SimDevice dev(ee);
+  uint8_t model[1024];
+  memset(model, 0xFF, sizeof(model));
+
+  srand(8);
+  for (int n=0; n<20000; n++) {
+    uint16_t addr = rand() % 64;        // small range: many queued hits
+    int r = rand() % 4;
+    if ( r < 2 ) {
+      uint8_t data = rand() % 4;        // often the current value
+      dev.writer.queue(addr, &data, 1, r == 1);
+      model[addr] = data;
+    }
+    else if ( r == 2 ) {
+      uint8_t data = dev.writer.fetch(addr);
+      CHECK_EQUAL(model[addr], data);
+      if ( model[addr] != data ) break;
+    }
+    else {
+      uint8_t data[4];
+      dev.writer.fetchBlock(addr, data, sizeof(data));
+      CHECK(memcmp(model+addr, data, sizeof(data)) == 0);
+    }
+  }
+  dev.writer.flush();
+  CHECK_EQUAL(0, dev.writer.pending());
+  CHECK(! dev.port.m_enabled);
+  for (uint16_t i=0; i<sizeof(model); i++) {
+    if ( ee.read_byte(i) != model[i] ) {
+      CHECK_EQUAL(model[i], ee.read_byte(i));
+      break;
+    }
+  }
+  CHECK(dev.writer.skipped() > 0);
+  printf("random workload: %u programs, %u queued bytes skipped\n",
+         ee.pagePrograms(), dev.writer.skipped());
+}
+
+void testLatency()
+{
+  SimEeprom ee(1024);
+  SimDevice dev(ee);
+  uint8_t sample[8];
+  for (uint8_t i=0; i<sizeof(sample); i++) sample[i] = i;
+
+  // a sample fits in the queue: the main program does not wait
+  dev.writer.queue(0, sample, sizeof(sample), false);
+  CHECK_EQUAL(0, dev.port.m_waited);
+  CHECK(dev.writer.pending() > 0);
+  dev.writer.flush();
+  CHECK_EQUAL(sizeof(sample), ee.pagePrograms());
+
+  // an update does not wait for the device either: the bytes already
+  // holding their value are skipped by the interrupt
+  uint8_t update[16];
+  for (uint8_t i=0; i<sizeof(update); i++) update[i] = ( i < 8 ) ? i : 0x80+i;
+  dev.port.m_waited = 0;
+  ee.resetStats();
+  dev.writer.queue(0, update, sizeof(update), true);
+  CHECK_EQUAL(0, dev.port.m_waited);
+  dev.writer.flush();
+  CHECK_EQUAL(8, ee.pagePrograms());
+  CHECK_EQUAL(8, dev.writer.skipped());
+  // a byte queued twice with the same value is queued once (the
+  // interrupt is busy with the byte at 300)
+  dev.writer.queue(300, update+9, 1, false);
+  dev.writer.queue(200, update+10, 1, true);
+  dev.writer.queue(200, update+10, 1, true);
+  CHECK_EQUAL(1, dev.writer.pending());
+  CHECK_EQUAL(9, dev.writer.skipped());
+  dev.writer.flush();
+  CHECK_EQUAL(update[10], ee.read_byte(200));
+
+  // a burst larger than the queue waits for the interrupt
+  uint8_t burst[EEPROM_QUEUE_SIZE*2];
+  memset(burst, 0x5A, sizeof(burst));
+  dev.port.m_waited = 0;
+  dev.writer.queue(100, burst, sizeof(burst), false);
+  uint32_t waited = dev.port.m_waited;
+  CHECK(waited > 0);
+  dev.writer.flush();
+  for (uint16_t i=0; i<sizeof(burst); i++) CHECK_EQUAL(0x5A, ee.read_byte(100+i));
+
+  printf("8 bytes sample: 0 us blocked (%u us blocking), %u bytes burst: %u us blocked\n",
+         (unsigned)(sizeof(sample)*SIM_EEPROM_PROGRAM_US), (unsigned)sizeof(burst), waited);
+}
+
+int main(void)
+{
+  testQueue();
+  testReadYourWrites();
+  testLatency();
+  return hostTestReport("writeQueueTest");
+}
@@ -1,5 +1,5 @@
 #include "timeRingBufferTest.h"
-#include "SafeEeprom.h"
+#include "AvrEeprom.h"
 
 #include <Arduino.h>
 
@@ -9,7 +9,7 @@ int main(void)
   init();
 
   for (uint16_t i=START_ADDR; i<START_ADDR+160; i++) {
-    SafeEeprom::write_byte(i, 0xFF);
+    AvrEeprom::instance().write_byte(i, 0xFF);
   }
 
   return 0;
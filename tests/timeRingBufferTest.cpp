@@ -2,7 +2,7 @@
 
 #include "Arduino.h"
 
-TimePermRingBuffer samples(START_ADDR, BUFFER_SZ, sizeof(FloatData), PERIOD);
+TimePermRingBuffer samples(AvrEeprom::instance(), START_ADDR, BUFFER_SZ, sizeof(FloatData), PERIOD);
 
 long times[] = { 0, 1, 2, 3, 4, 6, 8, 10, 11, 12, 14, 16, 19, 20, 22, 24, 29, 30, 32, 33, 34, 36, 38, 56, 58, 60 };
 //long times[] = { 20, 22, 24, 29, 30, 32, 33, 34, 36, 38, 56, 58, 60 };
@@ -1,5 +1,6 @@
 #include "TimePermRingBuffer.h"
 #include "DataSample.h"
+#include "AvrEeprom.h"
 
 #define START_ADDR 512
 #define BUFFER_SZ 8